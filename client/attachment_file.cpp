@@ -0,0 +1,181 @@
+#include "attachment_file.hpp"
+#include "log.hpp"
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+#ifdef _WIN32
+    const AttachmentFile::Handle kNoFile = INVALID_HANDLE_VALUE;
+#else
+    const AttachmentFile::Handle kNoFile = -1;
+#endif
+}
+
+AttachmentFile::AttachmentFile() : handleValue(kNoFile), sizeValue(0) {}
+
+AttachmentFile::~AttachmentFile() {
+    Close();
+}
+
+bool AttachmentFile::OpenForReading(const std::string& path) {
+    Close();
+#ifdef _WIN32
+    handleValue = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER fileSize;
+    if (handleValue == kNoFile || !GetFileSizeEx(handleValue, &fileSize)) {
+        LOG_ERROR(Transfer) << "Can't open " << path << ", Err #" << GetLastError();
+        Close();
+        return false;
+    }
+    sizeValue = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+    handleValue = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (handleValue < 0 || fstat(handleValue, &info) != 0 || !S_ISREG(info.st_mode)) {
+        LOG_ERROR(Transfer) << "Can't open " << path << ", Err #" << errno;
+        Close();
+        return false;
+    }
+    sizeValue = static_cast<uint64_t>(info.st_size);
+#endif
+    return true;
+}
+
+bool AttachmentFile::OpenForWriting(const std::string& path) {
+    Close();
+#ifdef _WIN32
+    handleValue = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER fileSize;
+    if (handleValue == kNoFile || !GetFileSizeEx(handleValue, &fileSize)) {
+        LOG_ERROR(Transfer) << "Can't write " << path << ", Err #" << GetLastError();
+        Close();
+        return false;
+    }
+    sizeValue = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+    handleValue = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    struct stat info;
+    if (handleValue < 0 || fstat(handleValue, &info) != 0) {
+        LOG_ERROR(Transfer) << "Can't write " << path << ", Err #" << errno;
+        Close();
+        return false;
+    }
+    sizeValue = static_cast<uint64_t>(info.st_size);
+#endif
+    return true;
+}
+
+void AttachmentFile::Close() {
+    if (handleValue != kNoFile) {
+#ifdef _WIN32
+        CloseHandle(handleValue);
+#else
+        close(handleValue);
+#endif
+    }
+    handleValue = kNoFile;
+    sizeValue = 0;
+}
+
+bool AttachmentFile::isOpen() const {
+    return handleValue != kNoFile;
+}
+
+bool AttachmentFile::WriteAt(uint64_t offset, const char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        OVERLAPPED position{};
+        position.Offset = static_cast<DWORD>(offset);
+        position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD written = 0;
+        DWORD length = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        if (!WriteFile(handleValue, data, length, &written, &position)) {
+            LOG_ERROR(Transfer) << "Attachment write failed, Err #" << GetLastError();
+            return false;
+        }
+#else
+        ssize_t written = pwrite(handleValue, data, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR(Transfer) << "Attachment write failed, Err #" << errno;
+            return false;
+        }
+#endif
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+        sizeValue = std::max(sizeValue, offset);
+    }
+    return true;
+}
+
+MappedRegion::MappedRegion() : base(nullptr), mappedSize(0), skip(0) {
+#ifdef _WIN32
+    mapping = nullptr;
+#endif
+}
+
+MappedRegion::~MappedRegion() {
+    Unmap();
+}
+
+bool MappedRegion::Map(const AttachmentFile& file, uint64_t offset, size_t length) {
+    Unmap();
+    if (length == 0) {
+        return true;
+    }
+
+#ifdef _WIN32
+    SYSTEM_INFO system;
+    GetSystemInfo(&system);
+    skip = static_cast<size_t>(offset % system.dwAllocationGranularity);
+    uint64_t start = offset - skip;
+    mapping = CreateFileMappingA(file.handle(), nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) {
+        base = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(start >> 32), static_cast<DWORD>(start), skip + length);
+    }
+    if (!base) {
+        LOG_ERROR(Transfer) << "Can't map attachment, Err #" << GetLastError();
+        Unmap();
+        return false;
+    }
+#else
+    static const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    skip = static_cast<size_t>(offset % pageSize);
+    void* mapped = mmap(nullptr, skip + length, PROT_READ, MAP_SHARED, file.handle(), static_cast<off_t>(offset - skip));
+    if (mapped == MAP_FAILED) {
+        LOG_ERROR(Transfer) << "Can't map attachment, Err #" << errno;
+        skip = 0;
+        return false;
+    }
+    base = mapped;
+    madvise(base, skip + length, MADV_SEQUENTIAL);
+#endif
+    mappedSize = skip + length;
+    return true;
+}
+
+void MappedRegion::Unmap() {
+#ifdef _WIN32
+    if (base) {
+        UnmapViewOfFile(base);
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+    mapping = nullptr;
+#else
+    if (base) {
+        munmap(base, mappedSize);
+    }
+#endif
+    base = nullptr;
+    mappedSize = 0;
+    skip = 0;
+}
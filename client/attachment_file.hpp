@@ -0,0 +1,68 @@
+#ifndef ATTACHMENT_FILE_HPP
+#define ATTACHMENT_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "net_socket.hpp"
+
+// A file sent or received as an attachment. It is read and written at
+// explicit offsets, so chunks go between the file and the socket without
+// passing through a buffer of the client's own.
+class AttachmentFile {
+public:
+#ifdef _WIN32
+    typedef HANDLE Handle;
+#else
+    typedef int Handle;
+#endif
+
+private:
+    Handle handleValue;
+    uint64_t sizeValue;
+
+public:
+    AttachmentFile();
+    ~AttachmentFile();
+
+    AttachmentFile(const AttachmentFile&) = delete;
+    AttachmentFile& operator=(const AttachmentFile&) = delete;
+
+    bool OpenForReading(const std::string& path);
+    // Creates the file if needed and keeps what it already holds.
+    bool OpenForWriting(const std::string& path);
+    void Close();
+
+    bool isOpen() const;
+    uint64_t size() const { return sizeValue; }
+    Handle handle() const { return handleValue; }
+
+    bool WriteAt(uint64_t offset, const char* data, size_t size);
+};
+
+// A read-only memory mapping of part of a file, for transports that can't
+// send straight from a file descriptor.
+class MappedRegion {
+private:
+    void* base;
+    size_t mappedSize;
+    size_t skip; // Mappings start on a page boundary before the offset
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+
+public:
+    MappedRegion();
+    ~MappedRegion();
+
+    MappedRegion(const MappedRegion&) = delete;
+    MappedRegion& operator=(const MappedRegion&) = delete;
+
+    bool Map(const AttachmentFile& file, uint64_t offset, size_t length);
+    void Unmap();
+
+    const char* data() const { return static_cast<const char*>(base) + skip; }
+    size_t size() const { return mappedSize - skip; }
+};
+
+#endif // ATTACHMENT_FILE_HPP
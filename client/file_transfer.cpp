@@ -0,0 +1,332 @@
+#include "file_transfer.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <random>
+
+namespace {
+    // Reads a number field ending at '|' or the end of the line
+    bool ReadField(std::string_view& line, uint64_t& value) {
+        const char* end = line.data() + line.size();
+        auto result = std::from_chars(line.data(), end, value);
+        if (result.ec != std::errc() || (result.ptr != end && *result.ptr != '|')) {
+            return false;
+        }
+        line.remove_prefix(result.ptr - line.data() + (result.ptr != end ? 1 : 0));
+        return true;
+    }
+
+    // The sender's name for the file, without any directories in it
+    std::string SafeFileName(std::string_view name) {
+        size_t slash = name.find_last_of("/\\");
+        if (slash != std::string_view::npos) {
+            name.remove_prefix(slash + 1);
+        }
+        std::string safe;
+        for (char c : name) {
+            safe += (static_cast<unsigned char>(c) < 32 || c == ':') ? '_' : c;
+        }
+        if (safe.empty() || safe == "." || safe == "..") {
+            safe = "attachment";
+        }
+        return safe;
+    }
+}
+
+FileTransfers::FileTransfers(const std::string& downloadDirectory)
+    : downloadDirectory(downloadDirectory), chunkTarget(nullptr), chunkOffset(0), chunkRemaining(0) {
+    // Like outbox IDs: a random high half per session and a counter below it
+    std::random_device seed;
+    nextId = (static_cast<uint64_t>(seed()) << 32) | 1;
+}
+
+std::string FileTransfers::OfferLine(const Transfer& transfer) {
+    return "FILE_OFFER|" + std::to_string(transfer.transferId) + "|" + std::to_string(transfer.size) + "|" + transfer.name + "\n";
+}
+
+std::string FileTransfers::AddUpload(const std::string& path) {
+    auto upload = std::make_shared<Transfer>();
+    if (!upload->file.OpenForReading(path)) {
+        return std::string();
+    }
+    upload->path = path;
+    upload->name = SafeFileName(path);
+    upload->size = upload->file.size();
+
+    std::lock_guard<std::mutex> lock(uploadsMutex);
+    upload->transferId = nextId++;
+    uploads[upload->transferId] = upload;
+    return OfferLine(*upload);
+}
+
+std::string FileTransfers::PendingOffers() const {
+    std::lock_guard<std::mutex> lock(uploadsMutex);
+    std::string offers;
+    for (const auto& entry : uploads) {
+        offers += OfferLine(*entry.second);
+    }
+    return offers;
+}
+
+std::shared_ptr<FileTransfers::Transfer> FileTransfers::FindUpload(uint64_t transferId) const {
+    std::lock_guard<std::mutex> lock(uploadsMutex);
+    auto it = uploads.find(transferId);
+    return it != uploads.end() ? it->second : nullptr;
+}
+
+size_t FileTransfers::uploadCount() const {
+    std::lock_guard<std::mutex> lock(uploadsMutex);
+    return uploads.size();
+}
+
+bool FileTransfers::UploadChunk(uint64_t transferId, uint64_t& offset, const ChunkSender& send) {
+    std::shared_ptr<Transfer> upload = FindUpload(transferId);
+    if (!upload) {
+        LOG_WARNING(Transfer) << "Resume for unknown upload " << transferId;
+        return false;
+    }
+
+    upload->done = std::min(offset, upload->size);
+    if (upload->done == upload->size) {
+        return false;
+    }
+
+    size_t length = static_cast<size_t>(std::min<uint64_t>(kChunkSize, upload->size - upload->done));
+    std::string header = "FILE_CHUNK|" + std::to_string(transferId) + "|" + std::to_string(upload->done) + "|" + std::to_string(length) + "\n";
+    if (!send(header, upload->file, upload->done, length)) {
+        return false; // Offered again after the reconnect
+    }
+    upload->done += length;
+    offset = upload->done;
+    Report(*upload, true, false);
+    return upload->done < upload->size;
+}
+
+bool FileTransfers::ConfirmUpload(std::string_view line) {
+    line.remove_prefix(line.find('|') + 1);
+    uint64_t transferId = 0;
+    if (!ReadField(line, transferId) || !line.empty()) {
+        return false;
+    }
+
+    std::shared_ptr<Transfer> upload;
+    {
+        std::lock_guard<std::mutex> lock(uploadsMutex);
+        auto it = uploads.find(transferId);
+        if (it == uploads.end()) {
+            return true;
+        }
+        upload = it->second;
+        uploads.erase(it);
+    }
+    upload->done = upload->size;
+    Report(*upload, true, true);
+    return true;
+}
+
+bool FileTransfers::AcceptOffer(std::string_view line) {
+    line.remove_prefix(line.find('|') + 1);
+    uint64_t transferId = 0;
+    uint64_t size = 0;
+    if (!ReadField(line, transferId) || !ReadField(line, size) || line.empty()) {
+        return false;
+    }
+
+    if (size > kMaxOfferSize) {
+        LOG_WARNING(Transfer) << "Refused a " << size << " byte file, over the " << kMaxOfferSize << " byte limit";
+        return true;
+    }
+
+    TransferProgress offer;
+    {
+        std::lock_guard<std::mutex> lock(downloadsMutex);
+        // A repeated offer after a reconnect continues the part already on
+        // disk; one still waiting for an answer, or declined, is left alone
+        auto it = downloads.find(transferId);
+        if (it != downloads.end()) {
+            ResumeDownload(*it->second);
+            return true;
+        }
+        if (offers.count(transferId) > 0 || declinedOffers.count(transferId) > 0) {
+            return true;
+        }
+
+        offer.transferId = transferId;
+        offer.name = SafeFileName(line);
+        offer.totalBytes = size;
+        offers[transferId] = offer;
+    }
+
+    LOG_INFO(Transfer) << "Offered " << offer.name << " (" << size << " bytes), waiting to be accepted";
+    if (offerCallback) {
+        offerCallback(offer);
+    }
+    return true;
+}
+
+bool FileTransfers::AcceptDownload(uint64_t transferId) {
+    std::lock_guard<std::mutex> lock(downloadsMutex);
+    auto offer = offers.find(transferId);
+    if (offer == offers.end()) {
+        return false;
+    }
+
+    auto download = std::make_unique<Transfer>();
+    download->transferId = transferId;
+    download->name = offer->second.name;
+    download->size = offer->second.totalBytes;
+
+    std::error_code error;
+    std::filesystem::create_directories(downloadDirectory, error);
+    download->path = downloadDirectory + "/" + std::to_string(transferId) + "-" + download->name + ".part";
+
+    // Only what isn't on disk yet needs room. The offer stays open, so it
+    // can be accepted again once space has been freed.
+    uint64_t onDisk = std::filesystem::file_size(download->path, error);
+    if (error) {
+        onDisk = 0;
+    }
+    std::filesystem::space_info space = std::filesystem::space(downloadDirectory, error);
+    if (!error && space.available < download->size - std::min(onDisk, download->size)) {
+        LOG_WARNING(Transfer) << "Not enough free space in " << downloadDirectory << " for " << download->name;
+        return false;
+    }
+    if (!download->file.OpenForWriting(download->path)) {
+        return false;
+    }
+
+    offers.erase(offer);
+    Transfer& accepted = *download;
+    downloads[transferId] = std::move(download);
+    ResumeDownload(accepted);
+    return true;
+}
+
+void FileTransfers::DeclineDownload(uint64_t transferId) {
+    std::lock_guard<std::mutex> lock(downloadsMutex);
+    if (offers.erase(transferId) > 0) {
+        declinedOffers.insert(transferId);
+    }
+}
+
+void FileTransfers::ResumeDownload(Transfer& download) {
+    download.done = std::min(download.file.size(), download.size);
+    replies += "FILE_RESUME|" + std::to_string(download.transferId) + "|" + std::to_string(download.done) + "\n";
+    if (download.done == download.size) {
+        FinishDownload(download.transferId);
+    }
+}
+
+bool FileTransfers::BeginChunk(std::string_view header) {
+    header.remove_prefix(header.find('|') + 1);
+    uint64_t transferId = 0;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    if (!ReadField(header, transferId) || !ReadField(header, offset) || !ReadField(header, length) || !header.empty()) {
+        return false;
+    }
+
+    // Chunks for a transfer we never accepted are read and dropped
+    std::lock_guard<std::mutex> lock(downloadsMutex);
+    auto it = downloads.find(transferId);
+    chunkTarget = it != downloads.end() ? it->second.get() : nullptr;
+    chunkOffset = offset;
+    chunkRemaining = length;
+    if (chunkRemaining == 0) {
+        chunkTarget = nullptr;
+    }
+    // ... and so are chunks reaching past the offered size, which would
+    // otherwise grow the file beyond what was accepted and finish it early
+    if (chunkTarget && (offset > chunkTarget->size || length > chunkTarget->size - offset)) {
+        LOG_WARNING(Transfer) << "Dropped a chunk at " << offset << "+" << length << " of " << chunkTarget->name
+            << ", past its " << chunkTarget->size << " bytes";
+        chunkTarget = nullptr;
+    }
+    return true;
+}
+
+void FileTransfers::AbortChunk() {
+    chunkTarget = nullptr;
+    chunkRemaining = 0;
+}
+
+size_t FileTransfers::ReceiveChunkBytes(const char* data, size_t size) {
+    size_t length = static_cast<size_t>(std::min<uint64_t>(size, chunkRemaining));
+    Transfer* target = chunkTarget;
+    if (target && target->file.isOpen() && !target->file.WriteAt(chunkOffset, data, length)) {
+        // Keep consuming the chunk so the stream stays in step
+        target->file.Close();
+    }
+
+    chunkOffset += length;
+    chunkRemaining -= length;
+    if (target && target->file.isOpen()) {
+        target->done = std::max(target->done, chunkOffset);
+        if (target->done >= target->size && chunkRemaining == 0) {
+            chunkTarget = nullptr;
+            std::lock_guard<std::mutex> lock(downloadsMutex);
+            FinishDownload(target->transferId);
+        }
+        else {
+            Report(*target, false, false);
+        }
+    }
+    if (chunkRemaining == 0) {
+        chunkTarget = nullptr;
+    }
+    return length;
+}
+
+void FileTransfers::FinishDownload(uint64_t transferId) {
+    auto it = downloads.find(transferId);
+    if (it == downloads.end()) {
+        return;
+    }
+
+    Transfer& download = *it->second;
+    download.file.Close();
+
+    // The finished file loses its ".part"; an older one of the same name is replaced
+    std::string finalPath = download.path.substr(0, download.path.size() - 5);
+    std::error_code error;
+    std::filesystem::remove(finalPath, error);
+    std::filesystem::rename(download.path, finalPath, error);
+    if (error) {
+        LOG_ERROR(Transfer) << "Can't rename " << download.path << ": " << error.message();
+    }
+    else {
+        download.path = finalPath;
+    }
+
+    download.done = download.size;
+    replies += "FILE_DONE|" + std::to_string(transferId) + "\n";
+    Report(download, false, true);
+    downloads.erase(it);
+}
+
+std::string FileTransfers::TakeReplies() {
+    std::lock_guard<std::mutex> lock(downloadsMutex);
+    return std::move(replies);
+}
+
+void FileTransfers::Report(Transfer& transfer, bool upload, bool finished) {
+    if (!progressCallback) {
+        return;
+    }
+
+    int percent = transfer.size > 0 ? static_cast<int>(transfer.done * 100 / transfer.size) : 100;
+    if (percent == transfer.reportedPercent && !finished) {
+        return;
+    }
+    transfer.reportedPercent = percent;
+
+    TransferProgress progress;
+    progress.transferId = transfer.transferId;
+    progress.name = finished && !upload ? transfer.path : transfer.name;
+    progress.upload = upload;
+    progress.bytesDone = transfer.done;
+    progress.totalBytes = transfer.size;
+    progress.finished = finished;
+    progressCallback(progress);
+}
@@ -0,0 +1,127 @@
+#ifndef FILE_TRANSFER_HPP
+#define FILE_TRANSFER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include "attachment_file.hpp"
+
+struct TransferProgress {
+    uint64_t transferId = 0;
+    std::string name;
+    bool upload = false;
+    uint64_t bytesDone = 0;
+    uint64_t totalBytes = 0;
+    bool finished = false;
+};
+
+// File attachments travel as a stream of chunks multiplexed between chat
+// lines on the same connection:
+//   FILE_OFFER|id|size|name      announces a file, in either direction
+//   FILE_RESUME|id|offset        asks the sender to stream from `offset`
+//   FILE_CHUNK|id|offset|length  followed by exactly `length` raw bytes
+//   FILE_DONE|id                 the receiver has written the whole file
+// An incoming offer is only answered once the user accepts it, and never
+// if it is larger than kMaxOfferSize or there is no room for it.
+// Chunks are small enough that chat lines get through in between. After a
+// reconnect offers are repeated and the receiver answers with how much it
+// already has on disk, so a transfer picks up where it stopped. An upload
+// only counts as delivered once FILE_DONE comes back, since bytes accepted
+// by the socket may still be lost with the connection.
+class FileTransfers {
+public:
+    using ProgressCallback = std::function<void(const TransferProgress&)>;
+    // Sends a chunk header followed by that part of the file.
+    using ChunkSender = std::function<bool(const std::string& header, const AttachmentFile& file, uint64_t offset, size_t length)>;
+
+    static const size_t kChunkSize = 64 * 1024;
+    // Larger offers are refused without asking.
+    static const uint64_t kMaxOfferSize = 4ull * 1024 * 1024 * 1024;
+
+private:
+    struct Transfer {
+        uint64_t transferId = 0;
+        std::string name;
+        std::string path;
+        AttachmentFile file;
+        uint64_t size = 0;
+        uint64_t done = 0;
+        int reportedPercent = -1;
+    };
+
+    std::string downloadDirectory;
+    std::map<uint64_t, std::shared_ptr<Transfer>> uploads;
+    std::map<uint64_t, std::unique_ptr<Transfer>> downloads;
+    // Incoming offers waiting for the user to accept or decline them
+    std::map<uint64_t, TransferProgress> offers;
+    std::set<uint64_t> declinedOffers;
+    mutable std::mutex uploadsMutex;
+    // Guards downloads, offers and replies, which the user's answer to an
+    // offer changes from outside the network threads
+    std::mutex downloadsMutex;
+    uint64_t nextId;
+    ProgressCallback progressCallback;
+    ProgressCallback offerCallback;
+    std::string replies;
+
+    // The chunk being received: its bytes arrive over several reads
+    Transfer* chunkTarget;
+    uint64_t chunkOffset;
+    uint64_t chunkRemaining;
+
+    std::shared_ptr<Transfer> FindUpload(uint64_t transferId) const;
+    void Report(Transfer& transfer, bool upload, bool finished);
+    // Both with downloadsMutex held.
+    void ResumeDownload(Transfer& download);
+    void FinishDownload(uint64_t transferId);
+    static std::string OfferLine(const Transfer& transfer);
+
+public:
+    explicit FileTransfers(const std::string& downloadDirectory = "downloads");
+
+    FileTransfers(const FileTransfers&) = delete;
+    FileTransfers& operator=(const FileTransfers&) = delete;
+
+    // Called from the network threads, at most once per percent.
+    void SetProgressCallback(ProgressCallback callback) { progressCallback = std::move(callback); }
+    // Called from the network threads with each new incoming offer, which
+    // waits for AcceptDownload or DeclineDownload.
+    void SetOfferCallback(ProgressCallback callback) { offerCallback = std::move(callback); }
+
+    // Opens the file and returns the offer to send, or an empty string.
+    std::string AddUpload(const std::string& path);
+    // Offers for every unfinished upload, to repeat after logging in again.
+    std::string PendingOffers() const;
+    // Sends the chunk of the upload at `offset` and moves `offset` past it.
+    // Returns true while there is more to send.
+    bool UploadChunk(uint64_t transferId, uint64_t& offset, const ChunkSender& send);
+    // Handles FILE_DONE for an upload. False if the line doesn't parse.
+    bool ConfirmUpload(std::string_view line);
+
+    // Holds an incoming offer for the user to answer; one already accepted
+    // before a reconnect resumes right away. False if the line doesn't parse.
+    bool AcceptOffer(std::string_view line);
+    // Opens the file and queues the FILE_RESUME reply. False if there is no
+    // such offer, no room for the file or it can't be created.
+    bool AcceptDownload(uint64_t transferId);
+    // The offer is ignored from then on, also when it is repeated.
+    void DeclineDownload(uint64_t transferId);
+    // Starts a chunk from its header line; its bytes follow.
+    bool BeginChunk(std::string_view header);
+    bool inChunk() const { return chunkRemaining > 0; }
+    // Writes chunk bytes to the file and returns how many were taken.
+    size_t ReceiveChunkBytes(const char* data, size_t size);
+    // Forgets a chunk cut off by a dropped connection.
+    void AbortChunk();
+    // Control lines the download side wants sent back.
+    std::string TakeReplies();
+
+    size_t uploadCount() const;
+};
+
+#endif // FILE_TRANSFER_HPP
@@ -0,0 +1,132 @@
+#include "fragment.hpp"
+#include <algorithm>
+#include <charconv>
+
+namespace {
+    const char kFragmentPrefix[] = "FRAG|";
+    const size_t kFragmentPrefixLength = sizeof(kFragmentPrefix) - 1;
+
+    // Room for "FRAG|id|index|count|" and the newline with every number at
+    // its longest
+    const size_t kPartBytes = kMaxFrameBytes - 64;
+
+    const uint32_t kMaxFragments = 1024;
+    const size_t kMaxPendingBytes = 4 * 1024 * 1024;
+    const size_t kMaxPartials = 16;
+
+    template <typename T>
+    bool NextNumber(std::string_view& rest, T& value) {
+        size_t bar = rest.find('|');
+        if (bar == std::string_view::npos) {
+            return false;
+        }
+        const char* end = rest.data() + bar;
+        auto result = std::from_chars(rest.data(), end, value);
+        rest.remove_prefix(bar + 1);
+        return bar > 0 && result.ec == std::errc() && result.ptr == end;
+    }
+}
+
+bool IsFragment(std::string_view line) {
+    return line.compare(0, kFragmentPrefixLength, kFragmentPrefix) == 0;
+}
+
+std::vector<std::string> FrameLine(std::string_view line, uint64_t id) {
+    std::vector<std::string> frames;
+
+    // A line that happens to start like a fragment is sent as one, so the
+    // receiver doesn't mistake it for one
+    if (line.size() < kMaxFrameBytes && !IsFragment(line)) {
+        frames.emplace_back(line);
+        frames.back() += '\n';
+        return frames;
+    }
+
+    std::vector<std::string_view> parts;
+    while (!line.empty()) {
+        size_t length = std::min(line.size(), kPartBytes);
+        // Back off to the start of a character; continuation bytes are 10xxxxxx
+        while (length < line.size() && length > 0 && (static_cast<unsigned char>(line[length]) & 0xC0) == 0x80) {
+            length--;
+        }
+        if (length == 0) {
+            length = std::min(line.size(), kPartBytes); // Not UTF-8, cut anywhere
+        }
+        parts.push_back(line.substr(0, length));
+        line.remove_prefix(length);
+    }
+    if (parts.empty()) {
+        parts.emplace_back();
+    }
+
+    std::string header = kFragmentPrefix + std::to_string(id) + "|";
+    std::string count = "|" + std::to_string(parts.size()) + "|";
+    frames.reserve(parts.size());
+    for (size_t i = 0; i < parts.size(); ++i) {
+        std::string frame;
+        frame.reserve(header.size() + count.size() + 10 + parts[i].size() + 1);
+        frame += header;
+        frame += std::to_string(i);
+        frame += count;
+        frame.append(parts[i].data(), parts[i].size());
+        frame += '\n';
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+bool FragmentAssembler::Add(std::string_view fragment, std::string& line) {
+    std::string_view rest = fragment.substr(kFragmentPrefixLength);
+    uint64_t id = 0;
+    uint32_t index = 0;
+    uint32_t count = 0;
+    if (!IsFragment(fragment) || !NextNumber(rest, id) || !NextNumber(rest, index) || !NextNumber(rest, count)
+        || count == 0 || count > kMaxFragments || index >= count) {
+        return false;
+    }
+
+    auto it = partials.find(id);
+    if (index == 0) {
+        if (it != partials.end()) {
+            // Restarted, e.g. resent after a reconnect
+            pendingBytes -= it->second.text.size();
+            partials.erase(it);
+        }
+        if (count == 1) {
+            line.assign(rest);
+            return true;
+        }
+        if (partials.size() >= kMaxPartials) {
+            return false;
+        }
+        it = partials.emplace(id, Partial()).first;
+        it->second.count = count;
+    }
+    else if (it == partials.end()) {
+        return false;
+    }
+
+    Partial& partial = it->second;
+    if (index != partial.next || count != partial.count || pendingBytes + rest.size() > kMaxPendingBytes) {
+        pendingBytes -= partial.text.size();
+        partials.erase(it);
+        return false;
+    }
+
+    partial.text.append(rest.data(), rest.size());
+    pendingBytes += rest.size();
+    partial.next++;
+    if (partial.next < partial.count) {
+        return false;
+    }
+
+    pendingBytes -= partial.text.size();
+    line = std::move(partial.text);
+    partials.erase(it);
+    return true;
+}
+
+void FragmentAssembler::Clear() {
+    partials.clear();
+    pendingBytes = 0;
+}
@@ -0,0 +1,48 @@
+#ifndef FRAGMENT_HPP
+#define FRAGMENT_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Receivers read lines into fixed buffers, so no line on the wire may be
+// longer than this, newline included. Longer lines are sent as fragments:
+//   FRAG|<id>|<index>|<count>|<part of the line>
+// with the id chosen by the sender and the parts sent in order.
+const size_t kMaxFrameBytes = 4096;
+
+// Splits `line` (without its newline) into frames of at most kMaxFrameBytes,
+// each ending in '\n'. A line that fits is its own single frame. Parts are
+// cut on UTF-8 character boundaries.
+std::vector<std::string> FrameLine(std::string_view line, uint64_t id);
+
+bool IsFragment(std::string_view line);
+
+// Puts fragmented lines back together. Bounded, so a peer that never
+// finishes a line can't make it hold on to more than a few megabytes.
+class FragmentAssembler {
+private:
+    struct Partial {
+        uint32_t next = 0;
+        uint32_t count = 0;
+        std::string text;
+    };
+
+    std::unordered_map<uint64_t, Partial> partials;
+    size_t pendingBytes = 0;
+
+public:
+    // Takes one FRAG line. Returns true when it completes a line, which is
+    // then in `line`. Malformed or out of order fragments drop the line
+    // they belong to.
+    bool Add(std::string_view fragment, std::string& line);
+
+    // Drops every unfinished line, e.g. when the connection is lost.
+    void Clear();
+
+    size_t pendingSize() const { return pendingBytes; }
+};
+
+#endif // FRAGMENT_HPP
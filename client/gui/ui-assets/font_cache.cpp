@@ -0,0 +1,67 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "font_cache.hpp"
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+	struct FontSlot
+	{
+		sf::Font font;
+		bool ok = false;
+		std::shared_future<void> ready;
+	};
+
+	std::mutex g_fonts_mutex;
+	std::map<std::string, std::unique_ptr<FontSlot>> g_fonts;
+
+	FontSlot& slot_for(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(g_fonts_mutex);
+		std::unique_ptr<FontSlot>& slot = g_fonts[path];
+		if (!slot)
+		{
+			slot = std::make_unique<FontSlot>();
+			FontSlot* target = slot.get();
+			slot->ready = std::async(std::launch::deferred, [target, path]()
+				{
+					target->ok = target->font.loadFromFile(path);
+					if (!target->ok)
+						std::cout << "Failed to load the font " << path << std::endl;
+				}).share();
+		}
+		return *slot;
+	}
+}
+
+const sf::Font& FontCache::get(const std::string& path)
+{
+	FontSlot& slot = slot_for(path);
+	slot.ready.wait();
+	return slot.font;
+}
+
+bool FontCache::loaded(const std::string& path)
+{
+	FontSlot& slot = slot_for(path);
+	slot.ready.wait();
+	return slot.ok;
+}
@@ -0,0 +1,35 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FONT_CACHE_HPP
+#define FONT_CACHE_HPP
+
+#include <SFML/Graphics.hpp>
+#include <string>
+
+// Fonts shared by every widget. Each file is read once, no matter how many
+// texts use it, and may be requested from any thread.
+class FontCache
+{
+public:
+	// Waits for the font if another thread is still loading it. The reference
+	// stays valid for the rest of the program.
+	static const sf::Font& get(const std::string& path = "font.ttf");
+
+	static bool loaded(const std::string& path = "font.ttf");
+};
+
+#endif // FONT_CACHE_HPP
@@ -0,0 +1,96 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "glyph_snapshot.hpp"
+
+namespace
+{
+	const sf::Uint32 kFirstPrintable = 32;
+	const sf::Uint32 kPrintableCount = 127 - kFirstPrintable;
+}
+
+GlyphSnapshot::GlyphSnapshot(const sf::Font& font, unsigned int char_size)
+	: m_font(&font), m_char_size(char_size), m_line_height(font.getLineSpacing(char_size))
+{
+}
+
+GlyphSnapshot::Metrics GlyphSnapshot::load(sf::Uint32 codepoint) const
+{
+	const sf::Glyph& glyph = m_font->getGlyph(codepoint, m_char_size, false);
+	Metrics metrics;
+	metrics.advance = glyph.advance;
+	metrics.bounds = glyph.bounds;
+	metrics.texture_rect = sf::FloatRect(glyph.textureRect);
+	return metrics;
+}
+
+std::shared_ptr<const GlyphSnapshot> GlyphSnapshot::create(const sf::Font& font, unsigned int char_size)
+{
+	std::shared_ptr<GlyphSnapshot> snapshot(new GlyphSnapshot(font, char_size));
+
+	for (sf::Uint32 c = 0; c < 128; ++c)
+		snapshot->m_ascii[c] = snapshot->load(c);
+	for (sf::Uint32 c = 160; c < 256; ++c)
+		snapshot->m_other.emplace(c, snapshot->load(c));
+
+	bool any_kerning = false;
+	snapshot->m_kerning.resize(kPrintableCount * kPrintableCount);
+	for (sf::Uint32 first = 0; first < kPrintableCount; ++first)
+	{
+		for (sf::Uint32 second = 0; second < kPrintableCount; ++second)
+		{
+			float kerning = font.getKerning(first + kFirstPrintable, second + kFirstPrintable, char_size);
+			snapshot->m_kerning[first * kPrintableCount + second] = kerning;
+			any_kerning = any_kerning || kerning != 0.f;
+		}
+	}
+	if (!any_kerning)
+		snapshot->m_kerning.clear();
+
+	return snapshot;
+}
+
+std::shared_ptr<const GlyphSnapshot> GlyphSnapshot::extend(const std::vector<sf::Uint32>& codepoints) const
+{
+	std::shared_ptr<GlyphSnapshot> snapshot(new GlyphSnapshot(*this));
+	for (sf::Uint32 c : codepoints)
+	{
+		if (!snapshot->find(c))
+			snapshot->m_other.emplace(c, load(c));
+	}
+	return snapshot;
+}
+
+const GlyphSnapshot::Metrics* GlyphSnapshot::find(sf::Uint32 codepoint) const
+{
+	if (codepoint < 128)
+		return &m_ascii[codepoint];
+
+	auto it = m_other.find(codepoint);
+	return it != m_other.end() ? &it->second : nullptr;
+}
+
+float GlyphSnapshot::get_kerning(sf::Uint32 first, sf::Uint32 second) const
+{
+	if (m_kerning.empty() || first < kFirstPrintable || second < kFirstPrintable)
+		return 0.f;
+
+	first -= kFirstPrintable;
+	second -= kFirstPrintable;
+	if (first >= kPrintableCount || second >= kPrintableCount)
+		return 0.f;
+	return m_kerning[first * kPrintableCount + second];
+}
@@ -0,0 +1,73 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GLYPH_SNAPSHOT_HPP
+#define GLYPH_SNAPSHOT_HPP
+
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Glyph metrics for one font and size, copied out of sf::Font by the thread
+// that draws. A snapshot never changes once built, so worker threads can lay
+// out text from it while the font, whose glyph cache and texture are not
+// thread safe, is only touched by the render thread. Glyphs that are missing
+// are added by building a new snapshot with extend().
+class GlyphSnapshot
+{
+public:
+	struct Metrics
+	{
+		float advance = 0.f;
+		sf::FloatRect bounds;
+		sf::FloatRect texture_rect;
+	};
+
+	// ASCII and Latin-1 are loaded up front. Render thread only.
+	static std::shared_ptr<const GlyphSnapshot> create(const sf::Font& font, unsigned int char_size);
+
+	// A copy that also holds `codepoints`. Render thread only.
+	std::shared_ptr<const GlyphSnapshot> extend(const std::vector<sf::Uint32>& codepoints) const;
+
+	// nullptr if the glyph isn't in the snapshot
+	const Metrics* find(sf::Uint32 codepoint) const;
+
+	// Kerning is kept for printable ASCII pairs; other pairs get none.
+	float get_kerning(sf::Uint32 first, sf::Uint32 second) const;
+
+	float get_line_height() const { return m_line_height; }
+	unsigned int get_character_size() const { return m_char_size; }
+
+	// The texture the glyph rects refer to. Render thread only.
+	const sf::Texture& get_texture() const { return m_font->getTexture(m_char_size); }
+
+private:
+	const sf::Font* m_font;
+	unsigned int m_char_size;
+	float m_line_height;
+	std::array<Metrics, 128> m_ascii;
+	std::unordered_map<sf::Uint32, Metrics> m_other;
+	// Empty when the font has no kerning at all
+	std::vector<float> m_kerning;
+
+	GlyphSnapshot(const sf::Font& font, unsigned int char_size);
+
+	Metrics load(sf::Uint32 codepoint) const;
+};
+
+#endif // GLYPH_SNAPSHOT_HPP
@@ -38,5 +38,5 @@ const sf::Text& TextObject::get_text() const
 
 const sf::Font& TextObject::get_font() const
 {
-	return m_font;
+	return *m_text.getFont();
 }
\ No newline at end of file
@@ -15,6 +15,7 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../ui-util/directives.hpp"
+#include "font_cache.hpp"
 
 #ifndef TEXT_OBJECT_HPP
 #define TEXT_OBJECT_HPP
@@ -23,19 +24,12 @@ class TextObject
 {
 private:
     sf::Text m_text;
-    sf::Font m_font;
     sf::Vector2f m_position;
 
 public:
     TextObject(std::string text, float x, float y, unsigned int char_size, unsigned int r, unsigned int g, unsigned int b)
     {
-        if (!m_font.loadFromFile("font.ttf"))
-        {
-            // Failed to load the font
-            std::cout << "Failed to load the font" << std::endl;
-        }
-
-        m_text.setFont(m_font);
+        m_text.setFont(FontCache::get());
         m_text.setCharacterSize(char_size);
         m_text.setStyle(sf::Text::Regular);
         set_position(x, y);
@@ -54,6 +48,11 @@ public:
         m_text.setString(text);
     }
 
+    void set_text(const sf::String& text)
+    {
+        m_text.setString(text);
+    }
+
     void set_position(float x, float y)
     {
         m_position.x = x;
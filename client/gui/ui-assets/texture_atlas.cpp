@@ -0,0 +1,130 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "texture_atlas.hpp"
+#include <iostream>
+
+namespace
+{
+	const unsigned int kPageSize = 1024;
+	// Larger images get a page of their own instead of crowding out the small ones
+	const unsigned int kMaxSharedSize = 256;
+	// Each image is surrounded by a copy of its edge pixels, so smooth
+	// sampling at the border never picks up a neighbour
+	const unsigned int kPadding = 1;
+
+	sf::Image with_border(const sf::Image& image)
+	{
+		sf::Vector2u size = image.getSize();
+		sf::Image bordered;
+		bordered.create(size.x + 2 * kPadding, size.y + 2 * kPadding);
+		bordered.copy(image, kPadding, kPadding);
+
+		int w = static_cast<int>(size.x);
+		int h = static_cast<int>(size.y);
+		bordered.copy(image, 0, kPadding, sf::IntRect(0, 0, 1, h));
+		bordered.copy(image, size.x + kPadding, kPadding, sf::IntRect(w - 1, 0, 1, h));
+		bordered.copy(bordered, 0, 0, sf::IntRect(0, kPadding, w + 2 * kPadding, 1));
+		bordered.copy(bordered, 0, size.y + kPadding, sf::IntRect(0, h, w + 2 * kPadding, 1));
+		return bordered;
+	}
+}
+
+TextureAtlas& TextureAtlas::get()
+{
+	static TextureAtlas atlas;
+	return atlas;
+}
+
+TextureAtlas::TextureAtlas()
+{
+	// Page 0 always exists and starts with the white block
+	add_page(kPageSize, kPageSize, true);
+
+	sf::Image white;
+	white.create(4, 4, sf::Color::White);
+	sf::Vector2u position;
+	m_pages[0]->packer.pack(4, 4, position);
+	m_pages[0]->texture.update(white, position.x, position.y);
+	m_white = { 0, sf::IntRect(position.x + 1, position.y + 1, 2, 2) };
+}
+
+size_t TextureAtlas::add_page(unsigned int width, unsigned int height, bool shared)
+{
+	auto page = std::make_unique<Page>(width, height, shared);
+	if (!page->texture.create(width, height))
+		std::cerr << "Error: Failed to create a " << width << "x" << height << " atlas page.\n";
+	page->texture.setSmooth(true);
+	m_pages.push_back(std::move(page));
+	return m_pages.size() - 1;
+}
+
+bool TextureAtlas::place(const sf::Image& image, AtlasImage& placed)
+{
+	sf::Vector2u size = image.getSize();
+	unsigned int width = size.x + 2 * kPadding;
+	unsigned int height = size.y + 2 * kPadding;
+	sf::Vector2u position;
+
+	size_t page = 0;
+	if (size.x > kMaxSharedSize || size.y > kMaxSharedSize)
+	{
+		page = add_page(width, height, false);
+		m_pages[page]->packer.pack(width, height, position);
+	}
+	else
+	{
+		while (page < m_pages.size() && !(m_pages[page]->shared && m_pages[page]->packer.pack(width, height, position)))
+			page++;
+
+		if (page == m_pages.size())
+		{
+			page = add_page(kPageSize, kPageSize, true);
+			if (!m_pages[page]->packer.pack(width, height, position))
+				return false;
+		}
+	}
+
+	m_pages[page]->texture.update(with_border(image), position.x, position.y);
+	placed.page = page;
+	placed.rect = sf::IntRect(position.x + kPadding, position.y + kPadding, size.x, size.y);
+	return true;
+}
+
+const AtlasImage* TextureAtlas::load(const std::string& path)
+{
+	auto found = m_images.find(path);
+	if (found != m_images.end())
+		return found->second.get();
+
+	sf::Image image;
+	if (!image.loadFromFile(path) || image.getSize().x == 0 || image.getSize().y == 0)
+		return nullptr;
+
+	auto placed = std::make_unique<AtlasImage>();
+	if (!place(image, *placed))
+		return nullptr;
+
+	return (m_images[path] = std::move(placed)).get();
+}
+
+size_t TextureAtlas::get_texture_bytes() const
+{
+	size_t bytes = 0;
+	for (const auto& page : m_pages)
+		bytes += static_cast<size_t>(page->texture.getSize().x) * page->texture.getSize().y * 4;
+	return bytes;
+}
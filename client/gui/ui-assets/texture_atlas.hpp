@@ -0,0 +1,75 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TEXTURE_ATLAS_HPP
+#define TEXTURE_ATLAS_HPP
+
+#include <SFML/Graphics.hpp>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../ui-util/shelf_packer.hpp"
+
+// Where an image ended up in the atlas.
+struct AtlasImage
+{
+	size_t page;
+	sf::IntRect rect;
+};
+
+// UI images packed into shared texture pages, so texture memory and state
+// changes grow with the number of distinct images, not with the number of
+// widgets showing them. Each file is loaded once. Images too big to share a
+// page get one of their own. Only used from the thread that draws.
+class TextureAtlas
+{
+public:
+	static TextureAtlas& get();
+
+	// Returns nullptr if the file can't be loaded. The pointer stays valid for
+	// the rest of the program.
+	const AtlasImage* load(const std::string& path);
+
+	// Opaque white pixels on page 0, for solid rectangles that are batched
+	// together with images.
+	const AtlasImage& get_white() const { return m_white; }
+
+	const sf::Texture& get_page(size_t index) const { return m_pages[index]->texture; }
+	size_t get_page_count() const { return m_pages.size(); }
+	size_t get_texture_bytes() const;
+
+private:
+	struct Page
+	{
+		sf::Texture texture;
+		ShelfPacker packer;
+		bool shared;
+
+		Page(unsigned int width, unsigned int height, bool shared) : packer(width, height), shared(shared) {}
+	};
+
+	std::vector<std::unique_ptr<Page>> m_pages;
+	std::map<std::string, std::unique_ptr<AtlasImage>> m_images;
+	AtlasImage m_white;
+
+	TextureAtlas();
+
+	size_t add_page(unsigned int width, unsigned int height, bool shared);
+	bool place(const sf::Image& image, AtlasImage& placed);
+};
+
+#endif // TEXTURE_ATLAS_HPP
@@ -1,5 +1,11 @@
 #include "input_field.hpp"
+#include <algorithm>
 #include "../ui-assets/text_object.hpp"
+#include "../ui-util/render_stats.hpp"
+
+namespace {
+    const float kTextPadding = 5.f;
+}
 
 InputField::InputField(const std::string& placeholder, float width, float height)
     : m_placeholder(placeholder), m_width(width), m_height(height), m_focused(false),
@@ -8,65 +14,62 @@ InputField::InputField(const std::string& placeholder, float width, float height
     m_background_shape.setSize(sf::Vector2f(width, height));
     m_background_shape.setFillColor(m_background_color);
 
-    m_text_object = std::make_unique<TextObject>(placeholder, 5.f, (height - 16.f) / 2.f, 16, 0, 0, 0);
+    m_text_object = std::make_unique<TextObject>(placeholder, kTextPadding, (height - 16.f) / 2.f, 16, 0, 0, 0);
     m_text_object->set_color(m_placeholder_color.r, m_placeholder_color.g, m_placeholder_color.b);
+    m_initial_text_height = m_text_object->get_local_bounds().height;
+    m_line_height = m_text_object->get_font().getLineSpacing(m_text_object->get_character_size());
+    m_single_line_height = height;
 
     m_cursor.setFillColor(sf::Color::Black);
     m_cursor.setSize(sf::Vector2f(2.f, height - 10));
     update_cursor_position();
-
-    m_initial_text_height = m_text_object->get_local_bounds().height;
+    set_measured_size(width, height);
 }
 
 InputField::~InputField() {}
 
-void InputField::draw(sf::RenderWindow& window) {
-    window.draw(m_background_shape);
+void InputField::draw(sf::RenderTarget& target) {
+    RenderStats::draw(target, m_background_shape);
 
-    sf::View original_view = window.getView();
+    sf::View original_view = target.getView();
 
+    // The field has its own view in local coordinates, scrolled horizontally
     sf::View text_view(sf::FloatRect(m_scroll_offset, 0.f, m_width, m_height));
-    text_view.setViewport(sf::FloatRect(m_pos.x / window.getSize().x, m_pos.y / window.getSize().y, m_width / window.getSize().x, m_height / window.getSize().y));
-    window.setView(text_view);
+    text_view.setViewport(sf::FloatRect(m_pos.x / target.getSize().x, m_pos.y / target.getSize().y, m_width / target.getSize().x, m_height / target.getSize().y));
+    target.setView(text_view);
 
-    window.draw(m_text_object->get_text());
+    RenderStats::draw(target, m_text_object->get_text());
+    if (m_multiline && !m_text.empty()) {
+        for (size_t i = 1; i < visible_line_count(); ++i) {
+            RenderStats::draw(target, m_line_objects[i - 1]->get_text());
+        }
+    }
 
     if (m_focused) {
         if (m_cursor_timer.getElapsedTime().asSeconds() < 0.5f) {
-            window.draw(m_cursor);
+            RenderStats::draw(target, m_cursor);
         }
         else if (m_cursor_timer.getElapsedTime().asSeconds() >= 1.f) {
             m_cursor_timer.restart();
         }
     }
 
-    window.setView(original_view);
+    target.setView(original_view);
 }
 
 void InputField::handle_event(const sf::Event& event) {
     if (event.type == sf::Event::MouseButtonPressed) {
         sf::Vector2f mousePos = sf::Vector2f(event.mouseButton.x, event.mouseButton.y);
         if (m_background_shape.getGlobalBounds().contains(mousePos)) {
-            m_focused = true;
-            if (m_text.empty()) {
-                m_text_object->set_text("");
-                m_text_object->set_color(m_text_color.r, m_text_color.g, m_text_color.b);
-            }
-            float mouseX = mousePos.x - (m_pos.x + 5.f - m_scroll_offset);
-            for (size_t i = 0; i <= m_text.size(); ++i) {
-                if (mouseX < m_text_object->get_text().findCharacterPos(i).x) {
-                    m_cursor_position = i;
-                    break;
-                }
-            }
+            set_focused(true);
+            float mouseX = mousePos.x - m_pos.x + m_scroll_offset - kTextPadding;
+            float row = (mousePos.y - m_pos.y - (m_single_line_height - m_line_height) / 2.f) / m_line_height;
+            size_t line = m_first_visible_line + static_cast<size_t>(std::max(0.f, row));
+            m_cursor_position = index_on_line(std::min(line, line_count() - 1), mouseX);
             update_cursor_position();
         }
         else {
-            m_focused = false;
-            if (m_text.empty()) {
-                m_text_object->set_text(m_placeholder);
-                m_text_object->set_color(m_placeholder_color.r, m_placeholder_color.g, m_placeholder_color.b);
-            }
+            set_focused(false);
         }
     }
     else if (event.type == sf::Event::TextEntered && m_focused) {
@@ -80,11 +83,41 @@ void InputField::handle_event(const sf::Event& event) {
             }
         }
         else if (event.key.code == sf::Keyboard::Right) {
-            if (m_cursor_position < m_text.length()) {
+            if (m_cursor_position < m_text.size()) {
                 m_cursor_position++;
                 update_cursor_position();
             }
         }
+        else if (event.key.code == sf::Keyboard::Up) {
+            if (line_of(m_cursor_position) > 0) {
+                move_to_line(line_of(m_cursor_position) - 1);
+            }
+        }
+        else if (event.key.code == sf::Keyboard::Down) {
+            if (line_of(m_cursor_position) + 1 < line_count()) {
+                move_to_line(line_of(m_cursor_position) + 1);
+            }
+        }
+        else if (event.key.code == sf::Keyboard::V && event.key.control) {
+            paste_clipboard();
+        }
+    }
+}
+
+sf::FloatRect InputField::get_hit_bounds() const {
+    return m_background_shape.getGlobalBounds();
+}
+
+void InputField::set_focused(bool focused) {
+    m_focused = focused;
+    if (m_text.empty()) {
+        if (focused) {
+            m_text_object->set_text(sf::String());
+            m_text_object->set_color(m_text_color.r, m_text_color.g, m_text_color.b);
+        }
+        else {
+            show_placeholder();
+        }
     }
 }
 
@@ -92,69 +125,233 @@ void InputField::process_input(const sf::Event::TextEvent& text_event) {
     if (text_event.unicode == '\b') {
         handle_backspace();
     }
-    else if (text_event.unicode < 128 && text_event.unicode != 13) { // ASCII characters
-        if (m_text.empty()) {
-            m_text_object->set_color(m_text_color.r, m_text_color.g, m_text_color.b);
-        }
-        m_text.insert(m_text.begin() + m_cursor_position, static_cast<char>(text_event.unicode));
-        m_cursor_position++;
-        m_text_object->set_text(m_text);
+    else if (m_multiline && (text_event.unicode == '\n' || (text_event.unicode == 13
+        && (sf::Keyboard::isKeyPressed(sf::Keyboard::LShift) || sf::Keyboard::isKeyPressed(sf::Keyboard::RShift))))) {
+        sf::Uint32 newline = '\n';
+        insert_codepoints(&newline, 1);
         update_cursor_position();
     }
     else if (text_event.unicode == 13) { // Enter key
         if (m_enter_callback) {
-            m_enter_callback(m_text);
+            m_enter_callback(m_text.utf8());
+        }
+        if (m_clear_on_enter) {
+            clear();
         }
-        clear();
+    }
+    else if (text_event.unicode >= 32 && text_event.unicode != 127) { // Printable, any script
+        insert_codepoints(&text_event.unicode, 1);
+        update_cursor_position();
     }
 }
 
+void InputField::insert_codepoints(const sf::Uint32* codepoints, size_t count) {
+    if (m_text.empty() && count > 0) {
+        m_text_object->set_color(m_text_color.r, m_text_color.g, m_text_color.b);
+    }
+
+    size_t at = m_cursor_position;
+    std::vector<size_t> new_starts;
+    for (size_t i = 0; i < count; ++i) {
+        sf::Uint32 codepoint = codepoints[i];
+        m_text.insert(m_cursor_position, codepoint, glyph_advance(m_masked ? '*' : codepoint));
+        m_cursor_position++;
+        if (codepoint == '\n') {
+            new_starts.push_back(m_cursor_position);
+        }
+    }
+
+    // Lines after the insertion point move along once for the whole run,
+    // so a long paste costs one pass over them rather than one per character
+    auto after = std::upper_bound(m_line_starts.begin(), m_line_starts.end(), at);
+    for (auto it = after; it != m_line_starts.end(); ++it) {
+        *it += count;
+    }
+    m_line_starts.insert(after, new_starts.begin(), new_starts.end());
+    if (!new_starts.empty()) {
+        update_height();
+    }
+}
+
+void InputField::erase_codepoint(size_t index) {
+    m_text.erase(index);
+
+    auto after = std::upper_bound(m_line_starts.begin(), m_line_starts.end(), index);
+    bool joined = after != m_line_starts.end() && *after == index + 1;
+    if (joined) {
+        after = m_line_starts.erase(after);
+    }
+    for (auto it = after; it != m_line_starts.end(); ++it) {
+        --*it;
+    }
+    if (joined) {
+        update_height();
+    }
+}
+
+void InputField::paste_clipboard() {
+    sf::String clipboard = sf::Clipboard::getString();
+    std::vector<sf::Uint32> codepoints;
+    codepoints.reserve(clipboard.getSize());
+    for (sf::Uint32 codepoint : clipboard) {
+        if (codepoint == '\r') {
+            continue; // Windows line endings
+        }
+        // A single line field folds line breaks into spaces; tabs always are
+        if (codepoint == '\t' || (codepoint == '\n' && !m_multiline)) {
+            codepoint = ' ';
+        }
+        if ((codepoint >= 32 && codepoint != 127) || codepoint == '\n') {
+            codepoints.push_back(codepoint);
+        }
+    }
+    insert_codepoints(codepoints.data(), codepoints.size());
+    update_cursor_position();
+}
+
+float InputField::glyph_advance(sf::Uint32 codepoint) const {
+    if (codepoint == '\n') {
+        return 0.f;
+    }
+    // Kerning is left out so a character's width never depends on its neighbours
+    return m_text_object->get_font().getGlyph(codepoint, m_text_object->get_character_size(), false).advance;
+}
+
 void InputField::handle_backspace() {
-    if (m_cursor_position > 0 && m_cursor_position <= m_text.length()) {
-        m_text.erase(m_cursor_position - 1, 1);
+    if (m_cursor_position > 0 && m_cursor_position <= m_text.size()) {
+        erase_codepoint(m_cursor_position - 1);
         m_cursor_position--;
-        m_text_object->set_text(m_text);
         update_cursor_position();
         if (m_text.empty()) {
-            m_text_object->set_text(m_placeholder);
-            m_text_object->set_color(m_placeholder_color.r, m_placeholder_color.g, m_placeholder_color.b);
+            show_placeholder();
         }
     }
 }
 
-void InputField::update_cursor_position() {
-    float cursor_x;
-    
-    if (m_cursor_position == 0) {
-        cursor_x = m_pos.x;
-    } else if (m_cursor_position > 0 && m_cursor_position <= m_text.length()) {
-        cursor_x = m_text_object->get_text().findCharacterPos(m_cursor_position).x;
-    } else {
-        cursor_x = m_text_object->get_text().findCharacterPos(m_text.length()).x;
+size_t InputField::visible_line_count() const {
+    return std::min(line_count(), m_max_visible_lines);
+}
+
+size_t InputField::line_of(size_t index) const {
+    return static_cast<size_t>(std::upper_bound(m_line_starts.begin(), m_line_starts.end(), index) - m_line_starts.begin());
+}
+
+size_t InputField::line_start(size_t line) const {
+    return line == 0 ? 0 : m_line_starts[line - 1];
+}
+
+size_t InputField::line_end(size_t line) const {
+    // Before the line's '\n'
+    return line + 1 < line_count() ? m_line_starts[line] - 1 : m_text.size();
+}
+
+size_t InputField::index_on_line(size_t line, float x) const {
+    size_t start = line_start(line);
+    size_t index = m_text.index_at(m_text.x_of(start) + x);
+    return std::min(std::max(index, start), line_end(line));
+}
+
+void InputField::move_to_line(size_t line) {
+    size_t current = line_of(m_cursor_position);
+    float x = m_text.x_of(m_cursor_position) - m_text.x_of(line_start(current));
+    m_cursor_position = index_on_line(line, x);
+    update_cursor_position();
+}
+
+void InputField::update_height() {
+    if (!m_multiline) {
+        return;
     }
 
+    float height = m_single_line_height + (visible_line_count() - 1) * m_line_height;
+    if (height != m_height) {
+        m_height = height;
+        m_background_shape.setSize(sf::Vector2f(m_width, m_height));
+        set_measured_size(m_width, m_height);
+    }
+}
+
+TextObject& InputField::line_object(size_t visible_line) {
+    if (visible_line == 0) {
+        return *m_text_object;
+    }
+    while (m_line_objects.size() < visible_line) {
+        m_line_objects.push_back(std::make_unique<TextObject>("", kTextPadding, 0.f, m_text_object->get_character_size(), m_text_color.r, m_text_color.g, m_text_color.b));
+    }
+    return *m_line_objects[visible_line - 1];
+}
+
+void InputField::update_cursor_position() {
+    // Positions are taken from the start of the caret's line; a single line
+    // field only ever has the one
+    size_t line = line_of(m_cursor_position);
+    float line_x = m_text.x_of(line_start(line));
+    float cursor_x = kTextPadding + m_text.x_of(m_cursor_position) - line_x;
+
     float cursorVisibleX = cursor_x - m_scroll_offset;
 
-    if (cursorVisibleX < m_pos.x) {
-        m_scroll_offset -= (m_pos.x - cursorVisibleX);
-    } else if (cursorVisibleX > m_pos.x + m_width - 20.f) {
-        m_scroll_offset += (cursorVisibleX - (m_pos.x + m_width - 20.f));
+    if (cursorVisibleX < kTextPadding) {
+        m_scroll_offset -= (kTextPadding - cursorVisibleX);
+    } else if (cursorVisibleX > m_width - 20.f) {
+        m_scroll_offset += (cursorVisibleX - (m_width - 20.f));
     }
 
-    float text_width = m_text_object->get_text().getGlobalBounds().width;
-    float max_scroll_offset = std::max(0.f, text_width - m_width);
+    float max_scroll_offset = std::max(0.f, kTextPadding + m_text.x_of(line_end(line)) - line_x + 20.f - m_width);
     if (m_scroll_offset < 0) {
         m_scroll_offset = 0;
     } else if (m_scroll_offset > max_scroll_offset) {
         m_scroll_offset = max_scroll_offset;
     }
 
-    m_text_object->set_position(m_pos.x - m_scroll_offset, m_pos.y + (m_height - m_initial_text_height) / 2.f);
+    // Vertically, the caret's line is kept among the visible ones
+    size_t visible = visible_line_count();
+    if (line < m_first_visible_line) {
+        m_first_visible_line = line;
+    }
+    else if (line >= m_first_visible_line + visible) {
+        m_first_visible_line = line + 1 - visible;
+    }
+    m_first_visible_line = std::min(m_first_visible_line, line_count() - visible);
 
-    float cursor_y = m_pos.y + (m_height - m_cursor.getSize().y) / 2.f;
+    update_visible_text();
+
+    float cursor_y = (m_single_line_height - m_cursor.getSize().y) / 2.f + (line - m_first_visible_line) * m_line_height;
     m_cursor.setPosition(cursor_x, cursor_y);
 }
 
+void InputField::update_visible_text() {
+    if (m_text.empty()) {
+        return;
+    }
+
+    // Only the characters inside the field go into each sf::Text, so their
+    // cost does not grow with the length of the whole buffer.
+    for (size_t i = 0; i < visible_line_count(); ++i) {
+        size_t line = m_first_visible_line + i;
+        size_t start = line_start(line);
+        size_t end = line_end(line);
+        float line_x = m_text.x_of(start);
+        size_t first = std::min(std::max(m_text.index_before(line_x + m_scroll_offset - kTextPadding), start), end);
+        size_t last = std::min(end, m_text.index_before(line_x + m_scroll_offset + m_width - kTextPadding) + 1);
+        last = std::max(first, last);
+
+        TextObject& text = line_object(i);
+        if (m_masked) {
+            text.set_text(sf::String(std::basic_string<sf::Uint32>(last - first, '*')));
+        }
+        else {
+            text.set_text(m_text.slice(first, last));
+        }
+        text.set_position(kTextPadding + m_text.x_of(first) - line_x, (m_single_line_height - m_initial_text_height) / 2.f + i * m_line_height);
+    }
+}
+
+void InputField::show_placeholder() {
+    m_text_object->set_text(m_placeholder);
+    m_text_object->set_color(m_placeholder_color.r, m_placeholder_color.g, m_placeholder_color.b);
+    m_text_object->set_position(kTextPadding, (m_single_line_height - m_initial_text_height) / 2.f);
+}
+
 void InputField::set_enter_callback(EnterCallback callback) {
     m_enter_callback = std::move(callback);
 }
@@ -163,10 +360,25 @@ void InputField::set_position(float x, float y) {
     m_pos.x = x;
     m_pos.y = y;
     m_background_shape.setPosition(m_pos);
-    m_text_object->set_position(x + 5.f - m_scroll_offset, y + (m_height - m_text_object->get_local_bounds().height) / 2.f);
     update_cursor_position();
 }
 
+void InputField::set_size(float width, float height) {
+    m_width = width;
+    m_height = height;
+    m_single_line_height = height;
+    m_background_shape.setSize(sf::Vector2f(width, height));
+    m_cursor.setSize(sf::Vector2f(2.f, height - 10));
+    set_measured_size(width, height);
+    update_height();
+    update_cursor_position();
+}
+
+void InputField::set_multiline(bool multiline, size_t max_visible_lines) {
+    m_multiline = multiline;
+    m_max_visible_lines = multiline ? std::max<size_t>(1, max_visible_lines) : 1;
+}
+
 void InputField::set_background_color(const sf::Color& color) {
     m_background_color = color;
     m_background_shape.setFillColor(m_background_color);
@@ -177,26 +389,30 @@ void InputField::set_text_color(const sf::Color& color) {
     if (!m_text.empty()) {
         m_text_object->set_color(m_text_color.r, m_text_color.g, m_text_color.b);
     }
+    for (auto& line : m_line_objects) {
+        line->set_color(m_text_color.r, m_text_color.g, m_text_color.b);
+    }
 }
 
 void InputField::set_placeholder(const std::string& placeholder) {
     m_placeholder = placeholder;
     if (m_text.empty() && !m_focused) {
-        m_text_object->set_text(m_placeholder);
-        m_text_object->set_color(m_placeholder_color.r, m_placeholder_color.g, m_placeholder_color.b);
+        show_placeholder();
     }
 }
 
 std::string InputField::get_text() const {
-    return m_text;
+    return m_text.utf8();
 }
 
 void InputField::clear() {
     m_text.clear();
-    m_text_object->set_text(m_placeholder);
-    m_text_object->set_color(m_placeholder_color.r, m_placeholder_color.g, m_placeholder_color.b);
+    m_line_starts.clear();
+    show_placeholder();
     m_cursor_position = 0;
     m_scroll_offset = 0;
+    m_first_visible_line = 0;
+    update_height();
     update_cursor_position();
 }
 
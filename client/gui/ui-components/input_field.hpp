@@ -21,10 +21,14 @@
 #include <functional>
 #include <string>
 #include <memory>
+#include <vector>
+#include "../ui-util/event_target.hpp"
+#include "../ui-util/layout_node.hpp"
+#include "../ui-util/text_buffer.hpp"
 
 class TextObject;
 
-class InputField
+class InputField : public LayoutNode, public EventTarget
 {
 public:
     using EnterCallback = std::function<void(const std::string&)>;
@@ -32,23 +36,38 @@ public:
     InputField(const std::string& placeholder, float width, float height);
     virtual ~InputField();
 
-    virtual void draw(sf::RenderWindow& window);
+    virtual void draw(sf::RenderTarget& target);
     void handle_event(const sf::Event& event);
+
+    sf::FloatRect get_hit_bounds() const override;
+    void dispatch_event(const sf::Event& event, sf::RenderWindow& window) override { handle_event(event); }
+    bool accepts_focus() const override { return true; }
+    void set_focused(bool focused) override;
     void clear();
 
     void set_position(float x, float y);
+    void place(float x, float y) override { set_position(x, y); }
+    void set_size(float width, float height);
     void set_background_color(const sf::Color& color);
     void set_text_color(const sf::Color& color);
     void set_placeholder(const std::string& placeholder);
     void set_placeholder_color(const sf::Color& color);
     void set_enter_callback(EnterCallback callback);
+    // Fields used as forms keep their text after enter
+    void set_clear_on_enter(bool clear_on_enter) { m_clear_on_enter = clear_on_enter; }
+    // Draws every character as '*', e.g. for passwords. Set before typing.
+    void set_masked(bool masked) { m_masked = masked; }
+    // Shift+Enter starts a new line and pasted line breaks are kept. The
+    // field grows downwards up to `max_visible_lines` and scrolls beyond
+    // that. Set before typing.
+    void set_multiline(bool multiline, size_t max_visible_lines = 6);
     std::string get_text() const;
 
     float m_width;
     float m_height;
 private:
     EnterCallback m_enter_callback;
-    std::string m_text;
+    TextBuffer m_text;
     std::string m_placeholder;
     sf::Color m_text_color;
     sf::Color m_placeholder_color;
@@ -57,15 +76,45 @@ private:
     sf::RectangleShape m_background_shape;
     sf::RectangleShape m_cursor;
     std::unique_ptr<TextObject> m_text_object;
+    // In multi-line mode m_text_object shows the first visible line and
+    // these the ones below it
+    std::vector<std::unique_ptr<TextObject>> m_line_objects;
+    // Index of the first character of every line after the first, i.e. the
+    // one after each '\n'. Line breaks have no advance, so each line spans
+    // its own range of the buffer's x offsets.
+    std::vector<size_t> m_line_starts;
     sf::Vector2f m_pos;
-    float m_cursor_position;
+    size_t m_cursor_position;
     float m_scroll_offset;
     float m_initial_text_height;
+    float m_line_height;
+    float m_single_line_height;
+    size_t m_first_visible_line = 0;
+    size_t m_max_visible_lines = 1;
     float m_cursor_offset = 0.f;
     bool m_focused;
+    bool m_clear_on_enter = true;
+    bool m_masked = false;
+    bool m_multiline = false;
 
     void update_cursor_position();
+    void update_visible_text();
+    void show_placeholder();
     void process_input(const sf::Event::TextEvent& text_event);
+    void insert_codepoints(const sf::Uint32* codepoints, size_t count);
+    void erase_codepoint(size_t index);
+    size_t line_count() const { return m_line_starts.size() + 1; }
+    size_t visible_line_count() const;
+    size_t line_of(size_t index) const;
+    size_t line_start(size_t line) const;
+    size_t line_end(size_t line) const;
+    // Caret index on `line` closest to `x`, measured from the line's start
+    size_t index_on_line(size_t line, float x) const;
+    void move_to_line(size_t line);
+    void update_height();
+    TextObject& line_object(size_t visible_line);
+    void paste_clipboard();
+    float glyph_advance(sf::Uint32 codepoint) const;
     void handle_backspace();
 };
 
@@ -1,6 +1,7 @@
 #include "menu.hpp"
 #include "menu_item.hpp"
 #include "input_field.hpp"
+#include "../ui-util/sprite_batch.hpp"
 
 Menu::Menu(const sf::Vector2f& pos, bool resize_on_item, bool is_active)
     : m_resize_on_item(resize_on_item), m_pos(pos), m_is_active(is_active)
@@ -8,6 +9,7 @@ Menu::Menu(const sf::Vector2f& pos, bool resize_on_item, bool is_active)
     sf::Vector2f size(m_menu_width, m_menu_height);
     m_background_shape.setPosition(m_pos);
     m_background_shape.setSize(size);
+    sync_measured_size();
 }
 
 Menu::~Menu()
@@ -16,7 +18,6 @@ Menu::~Menu()
     {
         delete item;
     }
-    delete m_background_sprite;
     m_items.clear();
 }
 
@@ -30,16 +31,97 @@ void Menu::correct_size(MenuItem* menu_item)
 
     if (height > m_menu_height)
         m_menu_height = height;
+
+    sync_measured_size();
 }
 
 void Menu::set_menu_width(float width)
 {
     m_menu_width = width;
+    sync_measured_size();
 }
 
 void Menu::set_menu_height(float height)
 {
     m_menu_height = height;
+    sync_measured_size();
+}
+
+void Menu::sync_measured_size()
+{
+    set_measured_size(m_menu_width, m_menu_height);
+}
+
+void Menu::adopt_child(LayoutNode* node, bool is_input, float x, float y)
+{
+    update_layout();
+
+    float previous_bottom = m_pos.y;
+    if (!m_layout_children.empty())
+    {
+        const LayoutChild& previous = m_layout_children.back();
+        previous_bottom = previous.y + previous.node->get_measured_size().y;
+    }
+
+    node->attach_to_layout(this, m_layout_children.size());
+    node->place(x, y);
+    m_layout_children.push_back({ node, is_input, x - m_pos.x, y - previous_bottom, y });
+
+    float height = node->get_measured_size().y;
+    if (is_input)
+        m_inputs_height += height;
+    else
+        m_items_height += height;
+}
+
+void Menu::on_child_resized(size_t index, const sf::Vector2f& delta)
+{
+    if (m_layout_children[index].is_input)
+        m_inputs_height += delta.y;
+    else
+        m_items_height += delta.y;
+
+    m_menu_height += delta.y;
+    m_background_shape.setSize(sf::Vector2f(m_menu_width, m_menu_height));
+    sync_measured_size();
+
+    // The resized child stays put; everything after it moves
+    m_layout_dirty_from = std::min(m_layout_dirty_from, index + 1);
+}
+
+void Menu::update_layout()
+{
+    if (m_layout_dirty_from >= m_layout_children.size())
+    {
+        m_layout_dirty_from = static_cast<size_t>(-1);
+        return;
+    }
+
+    float y = m_pos.y;
+    if (m_layout_dirty_from > 0)
+    {
+        const LayoutChild& previous = m_layout_children[m_layout_dirty_from - 1];
+        y = previous.y + previous.node->get_measured_size().y;
+    }
+
+    for (size_t i = m_layout_dirty_from; i < m_layout_children.size(); ++i)
+    {
+        LayoutChild& child = m_layout_children[i];
+        y += child.leading;
+        child.y = y;
+        child.node->place(m_pos.x + child.x_offset, y);
+        y += child.node->get_measured_size().y;
+    }
+
+    m_layout_dirty_from = static_cast<size_t>(-1);
+}
+
+void Menu::place(float x, float y)
+{
+    m_pos = sf::Vector2f(x, y);
+    m_background_shape.setPosition(m_pos);
+    if (!m_layout_children.empty())
+        m_layout_dirty_from = 0;
 }
 
 void Menu::add_item_ptr(MenuItem* menu_item)
@@ -47,17 +129,14 @@ void Menu::add_item_ptr(MenuItem* menu_item)
     if (m_resize_on_item)
         correct_size(menu_item);
 
-    float item_y = m_pos.y;
-    for (const auto& item : m_items)
-    {
-        item_y += item->get_height();
-    }
+    float item_y = m_pos.y + m_items_height;
 
-    menu_item->set_position(m_pos.x, item_y);
+    adopt_child(menu_item, false, m_pos.x, item_y);
 
     m_items.push_back(menu_item);
 
     m_menu_height += m_items.back()->get_height();
+    sync_measured_size();
 
     if (m_active_item == -1)
         m_active_item = static_cast<int>(m_items.size()) - 1;
@@ -79,61 +158,71 @@ void Menu::add_string(const std::string& text)
     float total_items_height = m_items.size() * (item_height + margin_y);
     float vertical_margin = (m_menu_height - total_items_height) / 2;
 
-    float item_y = m_pos.y + vertical_margin;
-
-    for (const auto& menuItem : m_items)
-    {
-        item_y += menuItem->get_height() + margin_y;
-    }
+    float item_y = m_pos.y + vertical_margin + m_items_height + m_items.size() * margin_y;
 
     float center_x = m_pos.x + (m_menu_width - item->get_width()) / 2;
 
-    item->set_position(center_x, item_y);
+    adopt_child(item, false, center_x, item_y);
     m_items.push_back(item);
 
     m_menu_height += item_height + margin_y;
     m_background_shape.setSize(sf::Vector2f(m_menu_width, m_menu_height));
+    sync_measured_size();
 }
 
 void Menu::add_input_field(const std::string& placeholder, float width, float height)
 {
     auto input_field = std::make_unique<InputField>(placeholder, width, height);
 
-    float item_y = m_pos.y;
-    for (const auto& item : m_items)
-    {
-        item_y += item->get_height();
-    }
-    for (const auto& input : m_input_fields)
-    {
-        item_y += input->m_height;
-    }
+    float item_y = m_pos.y + m_items_height + m_inputs_height;
 
-    input_field->set_position(m_pos.x, item_y);
+    adopt_child(input_field.get(), true, m_pos.x, item_y);
     m_input_fields.push_back(std::move(input_field));
 
     m_menu_height += m_input_fields.back()->m_height;
     m_background_shape.setSize(sf::Vector2f(m_menu_width, m_menu_height));
+    sync_measured_size();
 }
 
-void Menu::draw(sf::RenderWindow& window)
+void Menu::draw(sf::RenderTarget& target)
 {
-    if (m_background_shape.getGlobalBounds().width > 0 && m_background_shape.getGlobalBounds().height > 0) {
-        window.draw(m_background_shape);
+    SpriteBatch batch;
+    batch_background(batch);
+    batch.draw(target);
+    draw_content(target);
+}
+
+void Menu::batch_background(SpriteBatch& batch)
+{
+    update_layout();
+
+    sf::FloatRect bounds = m_background_shape.getGlobalBounds();
+    if (bounds.width > 0 && bounds.height > 0) {
+        batch.add_rect(bounds, m_background_shape.getFillColor());
     }
 
-    if (m_background_sprite && m_background_sprite->getGlobalBounds().width > 0 && m_background_sprite->getGlobalBounds().height > 0) {
-        window.draw(*m_background_sprite);
+    if (m_background_image && m_menu_width > 0 && m_menu_height > 0) {
+        batch.add_image(*m_background_image, sf::FloatRect(m_pos, sf::Vector2f(m_menu_width, m_menu_height)));
     }
 
     for (auto& item : m_items)
     {
-        item->draw(window);
+        item->batch_background(batch);
+    }
+}
+
+void Menu::draw_content(sf::RenderTarget& target)
+{
+    update_layout();
+
+    for (auto& item : m_items)
+    {
+        item->draw_content(target);
     }
 
     for (auto& input : m_input_fields)
     {
-        input->draw(window);
+        input->draw(target);
     }
 }
 
@@ -150,9 +239,9 @@ void Menu::set_background_color(const sf::Color& color)
     m_background_color = color;
 }
 
-void Menu::set_background_sprite(sf::Sprite* sprite)
+void Menu::set_background_image(const AtlasImage* image)
 {
-    m_background_sprite = sprite;
+    m_background_image = image;
 }
 
 void Menu::set_background_rect(const sf::RectangleShape& rect)
@@ -187,9 +276,9 @@ sf::RectangleShape Menu::get_background_rect()
     return m_background_shape;
 }
 
-sf::Sprite* Menu::get_background_sprite()
+const AtlasImage* Menu::get_background_image()
 {
-    return m_background_sprite;
+    return m_background_image;
 }
 
 sf::Vector2f Menu::get_position()
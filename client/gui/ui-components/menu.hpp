@@ -15,6 +15,7 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../ui-util/directives.hpp"
+#include "../ui-util/layout_node.hpp"
 
 #ifndef MENU_HPP
 #define MENU_HPP
@@ -24,8 +25,10 @@
 
 class MenuItem;
 class InputField;
+class SpriteBatch;
+struct AtlasImage;
 
-class Menu
+class Menu : public LayoutNode
 {
 public:
     std::vector<MenuItem*> m_items;
@@ -44,7 +47,15 @@ public:
 
     void correct_size(MenuItem* menu_item);
 
-    virtual void draw(sf::RenderWindow& window);
+    // Draws the menu on its own. MenuUtil instead batches the backgrounds
+    // of every menu in the stack and then draws their content.
+    virtual void draw(sf::RenderTarget& target);
+
+    // Adds the background rect and image of the menu and its items.
+    virtual void batch_background(SpriteBatch& batch);
+
+    // Everything drawn over the backgrounds: item labels and input fields.
+    virtual void draw_content(sf::RenderTarget& target);
 
     void set_menu_width(float width);
 
@@ -62,25 +73,51 @@ public:
 
     void set_background_rect(const sf::RectangleShape& rect);
 
-    void set_background_sprite(sf::Sprite* sprite);
+    // The image is stretched over the whole menu.
+    void set_background_image(const AtlasImage* image);
 
     sf::Color get_background_color();
 
     sf::RectangleShape get_background_rect();
 
-    sf::Sprite* get_background_sprite();
+    const AtlasImage* get_background_image();
     
     sf::Vector2f get_position();
 
     void set_input_field_color(const sf::Color& text_color, const sf::Color& background_color, const sf::Color& placeholder_color);
 
+    void place(float x, float y) override;
+
+    // Repositions the children after the first one whose size changed.
+    void update_layout();
+
 protected:
+    struct LayoutChild
+    {
+        LayoutNode* node;
+        bool is_input;
+        float x_offset;
+        float leading;
+        float y;
+    };
+
+    // Children in the order they were added. Each keeps the gap to the one
+    // before it, so a resize only shifts the children that follow.
+    std::vector<LayoutChild> m_layout_children;
+    size_t m_layout_dirty_from = static_cast<size_t>(-1);
+    float m_items_height = 0.f;
+    float m_inputs_height = 0.f;
+
+    void adopt_child(LayoutNode* node, bool is_input, float x, float y);
+    void on_child_resized(size_t index, const sf::Vector2f& delta) override;
+    void sync_measured_size();
+
     float m_menu_width = 0.f;
     float m_menu_height = 0.f;
 
     sf::Color m_background_color = sf::Color::White;
     sf::RectangleShape m_background_shape;
-    sf::Sprite* m_background_sprite = nullptr;
+    const AtlasImage* m_background_image = nullptr;
 
     sf::Vector2f m_pos = { 0.f, 0.f };
 
@@ -17,30 +17,42 @@
 #include "menu_item.hpp"
 
 #include "../ui-assets/text_object.hpp"
+#include "../ui-util/render_stats.hpp"
+#include "../ui-util/sprite_batch.hpp"
 
 MenuItem::MenuItem(const std::string& label, float width, float height) : m_width(width), m_height(height)
 {
 	m_text_object = std::make_unique<TextObject>(label, 0, 0, 20, 255, 255, 255);
 	m_text_object->set_text(label);
 	m_text_object->set_position(m_pos.x, m_pos.y);
+	set_measured_size(width, height);
 }
 
-MenuItem::~MenuItem()
+MenuItem::~MenuItem() {}
+
+void MenuItem::draw(sf::RenderTarget& target)
 {
-	delete m_background_sprite;
+	SpriteBatch batch;
+	batch_background(batch);
+	batch.draw(target);
+	draw_content(target);
 }
 
-void MenuItem::draw(sf::RenderWindow& window)
+void MenuItem::batch_background(SpriteBatch& batch)
 {
-	if (m_background_shape.getGlobalBounds().width > 0 && m_background_shape.getGlobalBounds().height > 0) {
-		window.draw(m_background_shape);
+	sf::FloatRect bounds = m_background_shape.getGlobalBounds();
+	if (bounds.width > 0 && bounds.height > 0) {
+		batch.add_rect(bounds, m_background_shape.getFillColor());
 	}
 
-	if (m_background_sprite && m_background_sprite->getGlobalBounds().width > 0 && m_background_sprite->getGlobalBounds().height > 0) {
-		window.draw(*m_background_sprite);
+	if (m_background_image && m_width > 0 && m_height > 0) {
+		batch.add_image(*m_background_image, sf::FloatRect(m_pos, sf::Vector2f(m_width, m_height)));
 	}
+}
 
-	window.draw(m_text_object->get_text());
+void MenuItem::draw_content(sf::RenderTarget& target)
+{
+	RenderStats::draw(target, m_text_object->get_text());
 }
 
 void MenuItem::set_position(float x, float y)
@@ -53,14 +65,22 @@ void MenuItem::set_position(float x, float y)
 	m_text_object->set_position(m_pos.x + offsetX, m_pos.y + offsetY);
 }
 
+void MenuItem::set_size(float width, float height)
+{
+	m_width = width;
+	m_height = height;
+	set_position(m_pos.x, m_pos.y);
+	set_measured_size(width, height);
+}
+
 void MenuItem::change_text(const std::string& text)
 {
 	m_text_object->set_text(text);
 }
 
-void MenuItem::set_background_sprite(sf::Sprite* sprite)
+void MenuItem::set_background_image(const AtlasImage* image)
 {
-	m_background_sprite = sprite;
+	m_background_image = image;
 }
 
 sf::Color MenuItem::get_background_color()
@@ -73,9 +93,9 @@ sf::RectangleShape MenuItem::get_background_rect()
 	return m_background_shape;
 }
 
-sf::Sprite* MenuItem::get_background_sprite()
+const AtlasImage* MenuItem::get_background_image()
 {
-	return m_background_sprite;
+	return m_background_image;
 }
 
 sf::Vector2f MenuItem::get_position()
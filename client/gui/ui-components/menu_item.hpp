@@ -15,19 +15,26 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../ui-util/directives.hpp"
+#include "../ui-util/layout_node.hpp"
 
 #ifndef MENU_ITEM_HPP
 #define MENU_ITEM_HPP
 
 class TextObject;
+class SpriteBatch;
+struct AtlasImage;
 
-class MenuItem
+class MenuItem : public LayoutNode
 {
 public:
 	MenuItem(const std::string& label, float margin_x, float margin_y);
 	virtual ~MenuItem();
 
-	virtual void draw(sf::RenderWindow& window);
+	virtual void draw(sf::RenderTarget& target);
+
+	virtual void batch_background(SpriteBatch& batch);
+
+	virtual void draw_content(sf::RenderTarget& target);
 
 	virtual float get_distance() const { return 0.f;  }
 
@@ -39,7 +46,7 @@ public:
 
 	sf::RectangleShape get_background_rect();
 
-	sf::Sprite* get_background_sprite();
+	const AtlasImage* get_background_image();
 
 	sf::Vector2f get_position();
 
@@ -47,7 +54,11 @@ public:
 
 	void set_position(float x, float y);
 
-	void set_background_sprite(sf::Sprite* sprite);
+	void place(float x, float y) override { set_position(x, y); }
+
+	void set_size(float width, float height);
+
+	void set_background_image(const AtlasImage* image);
 
 	void set_background_rect(const sf::RectangleShape& rect);
 
@@ -59,7 +70,7 @@ private:
 
 	std::unique_ptr<TextObject> m_text_object;
 	sf::RectangleShape m_background_shape;
-	sf::Sprite* m_background_sprite = nullptr;
+	const AtlasImage* m_background_image = nullptr;
 	sf::Color m_background_color = sf::Color::White;
 
 	sf::Vector2f m_pos = { 0.f, 0.f };
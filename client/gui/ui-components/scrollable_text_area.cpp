@@ -0,0 +1,532 @@
+#include "scrollable_text_area.hpp"
+#include "../ui-assets/font_cache.hpp"
+#include "../../utf8.hpp"
+#include "../ui-util/render_stats.hpp"
+#include "../ui-util/worker_pool.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    const float kMarginX = 20.f;
+    const float kMarginY = 5.f;
+    const unsigned int kCharacterSize = 20;
+    const sf::Color kHighlightColor(255, 220, 90);
+
+    std::shared_ptr<const TextBlock> recolored(const TextBlock& block, const sf::Color& color) {
+        auto copy = std::make_shared<TextBlock>(block);
+        for (sf::Vertex& vertex : copy->vertices) {
+            vertex.color = color;
+        }
+        copy->color = color;
+        return copy;
+    }
+}
+
+ScrollableTextArea::ScrollableTextArea(const sf::Vector2f& pos, float width, float height)
+    : Menu(pos, false, true), m_font(FontCache::get()), m_menu_width(width), m_menu_height(height), m_pos(pos), m_isDragging(false),
+    m_wrap_width(width - 2 * kMarginX), m_layout_results(std::make_shared<LayoutResults>()), m_batch(sf::Triangles) {
+    m_view.setSize(width, height);
+    m_view.setCenter(width / 2, height / 2);
+
+    m_content_top = m_pos.y + kMarginY;
+    m_content_bottom = m_content_top;
+
+    if (!FontCache::loaded()) {
+        throw std::runtime_error("Failed to load font");
+    }
+    m_glyphs = GlyphSnapshot::create(m_font, kCharacterSize);
+}
+
+void ScrollableTextArea::draw_content(sf::RenderTarget& target) {
+    apply_pending_lines();
+    settle_view();
+
+    sf::View originalView = target.getView();
+
+    target.setView(m_view);
+
+    float visibleTop = view_top();
+    float visibleBottom = view_bottom();
+
+    // Every row's glyphs come from the same font texture, so the rows in
+    // view go out as a single batch
+    m_batch.clear();
+    auto it = std::partition_point(m_visibleTexts.begin(), m_visibleTexts.end(), [visibleTop](const Row& row) {
+        return row.y + row.height < visibleTop;
+        });
+    for (; it != m_visibleTexts.end() && it->y <= visibleBottom; ++it) {
+        if (!it->block) {
+            continue;
+        }
+        sf::Vector2f origin(m_pos.x + kMarginX, it->y);
+        for (const sf::Vertex& vertex : it->block->vertices) {
+            m_batch.append(sf::Vertex(vertex.position + origin, vertex.color, vertex.texCoords));
+        }
+    }
+    if (m_batch.getVertexCount() > 0) {
+        RenderStats::draw(target, m_batch, sf::RenderStates(&m_glyphs->get_texture()));
+    }
+
+    target.setView(originalView);
+}
+
+sf::FloatRect ScrollableTextArea::get_hit_bounds() const {
+    return sf::FloatRect(m_pos.x, m_pos.y, m_menu_width, m_menu_height);
+}
+
+void ScrollableTextArea::handle_event(const sf::Event& event, sf::RenderTarget& target) {
+    if (event.type == sf::Event::MouseButtonPressed) {
+        if (event.mouseButton.button == sf::Mouse::Left) {
+            m_isDragging = true;
+            m_lastMousePosition = target.mapPixelToCoords(sf::Vector2i(event.mouseButton.x, event.mouseButton.y));
+        }
+    }
+    else if (event.type == sf::Event::MouseButtonReleased) {
+        if (event.mouseButton.button == sf::Mouse::Left) {
+            m_isDragging = false;
+        }
+    }
+    else if (event.type == sf::Event::MouseMoved) {
+        if (m_isDragging) {
+            sf::Vector2f currentMousePosition = target.mapPixelToCoords(sf::Vector2i(event.mouseMove.x, event.mouseMove.y));
+            sf::Vector2f delta = m_lastMousePosition - currentMousePosition;
+            m_view.move(delta);
+            m_lastMousePosition = currentMousePosition;
+            page_if_needed();
+        }
+    }
+    else if (event.type == sf::Event::MouseWheelScrolled) {
+        m_view.move(0, event.mouseWheelScroll.delta * -10);
+        page_if_needed();
+    }
+}
+
+void ScrollableTextArea::add_string(std::string_view new_line) {
+    bool at_tail = window_at_tail();
+    m_total_count++;
+
+    // The user has paged back through history; the new line will be paged
+    // in when they scroll down to it.
+    if (!at_tail) {
+        return;
+    }
+
+    // Lines that would be trimmed again in the same pass are not kept
+    if (m_pending_lines.size() >= m_max_rows) {
+        m_pending_lines.pop_front();
+        m_pending_skipped++;
+    }
+    m_pending_lines.emplace_back(new_line);
+}
+
+void ScrollableTextArea::add_lines(size_t count) {
+    bool at_tail = window_at_tail();
+    m_total_count += count;
+
+    if (at_tail) {
+        // Anything still queued is now older than the skipped lines
+        m_pending_skipped += m_pending_lines.size() + count;
+        m_pending_lines.clear();
+    }
+}
+
+void ScrollableTextArea::set_max_rows(size_t max_rows) {
+    m_max_rows = std::max<size_t>(max_rows, 1);
+    m_page_rows = std::max<size_t>(m_max_rows / 10, 1);
+    trim_front();
+}
+
+void ScrollableTextArea::set_history_provider(HistoryProvider provider) {
+    m_history_provider = std::move(provider);
+}
+
+void ScrollableTextArea::set_size(float width, float height) {
+    bool was_at_bottom = m_view.getCenter().y + m_menu_height / 2 >= m_content_bottom;
+
+    float wrap_width = std::max(width - 2 * kMarginX, 1.f);
+    m_menu_width = width;
+    m_menu_height = height;
+    m_view.setSize(width, height);
+    m_view.setCenter(width / 2, m_view.getCenter().y);
+
+    if (wrap_width != m_wrap_width) {
+        m_wrap_width = wrap_width;
+        if (!m_visibleTexts.empty()) {
+            request_layouts_from(anchor_row());
+        }
+    }
+    if (was_at_bottom) {
+        scroll_to_bottom();
+    }
+}
+
+void ScrollableTextArea::scroll_to(size_t index) {
+    apply_pending_lines();
+    if (index >= m_total_count) {
+        return;
+    }
+
+    if (index < m_first_index || index >= m_first_index + m_visibleTexts.size()) {
+        if (!m_history_provider) {
+            return;
+        }
+
+        // Rebuild the window around the target instead of paging through everything between
+        size_t first = index - std::min(index, m_page_rows);
+        size_t count = std::min(m_total_count - first, 2 * m_page_rows + 1);
+        std::vector<std::string> lines = m_history_provider(first, count);
+        if (lines.size() <= index - first) {
+            return;
+        }
+
+        discard_rows();
+        m_first_index = first;
+        m_content_top = m_pos.y + kMarginY;
+        m_content_bottom = m_content_top;
+        for (const auto& line : lines) {
+            push_back_row(line, false);
+        }
+        request_layouts_from(index - first);
+    }
+
+    size_t previous = m_highlight_index;
+    m_highlight_index = index;
+    set_row_color(previous, sf::Color::White);
+    set_row_color(index, kHighlightColor);
+
+    // Centred on the row's real height, not the estimate
+    wait_for_row(index);
+    const Row& row = m_visibleTexts[index - m_first_index];
+    m_view.setCenter(m_menu_width / 2, row.y + row.height / 2);
+}
+
+void ScrollableTextArea::update_line(size_t index, std::string_view text) {
+    if (index >= m_first_index && index - m_first_index < m_visibleTexts.size()) {
+        // The old block is drawn until the new one arrives; collecting it
+        // repositions the rows around the anchor
+        Row& row = m_visibleTexts[index - m_first_index];
+        row.line.assign(text.data(), text.size());
+        row.source.reset();
+        request_layout(index);
+        return;
+    }
+
+    // Queued lines are the newest ones, but only while following the tail
+    size_t pending_first = m_total_count - m_pending_lines.size();
+    if (window_at_tail() && index >= pending_first && index < m_total_count) {
+        m_pending_lines[index - pending_first].assign(text.data(), text.size());
+    }
+}
+
+float ScrollableTextArea::estimated_row_height() const {
+    return m_glyphs->get_line_height() + kMarginY;
+}
+
+sf::Color ScrollableTextArea::row_color(size_t index) const {
+    return index == m_highlight_index ? kHighlightColor : sf::Color::White;
+}
+
+void ScrollableTextArea::request_layout(size_t index) {
+    Row& row = m_visibleTexts[index - m_first_index];
+    row.ticket = m_next_ticket++;
+
+    // The job gets its own copy of everything it reads; the glyph snapshot
+    // and decoded text are immutable and shared
+    std::string line = row.source ? std::string() : row.line;
+    WorkerPool::get().post([results = m_layout_results, glyphs = m_glyphs, source = row.source, line = std::move(line),
+        index, ticket = row.ticket, width = m_wrap_width, color = row_color(index)]() {
+        if (ticket < results->first_live_ticket) {
+            return;
+        }
+
+        LayoutResult result{ index, ticket, source, nullptr, {} };
+        if (!result.source) {
+            thread_local std::vector<sf::Uint32> decoded;
+            decoded.resize(line.size() + 1);
+            size_t length = utf8::Decode(line.data(), line.size(), decoded.data());
+            decoded[length] = 0;
+            result.source = std::make_shared<const sf::String>(decoded.data());
+        }
+
+        TextLayout layout(*glyphs);
+        if (layout.find_missing(*result.source, result.missing)) {
+            auto block = std::make_shared<TextBlock>();
+            layout.shape(*result.source, width, color, *block);
+            result.block = std::move(block);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(results->mutex);
+            results->done.push_back(std::move(result));
+        }
+        results->ready.notify_one();
+        });
+}
+
+void ScrollableTextArea::request_layouts_from(size_t row) {
+    // Outward from `row`: it and everything below, then everything above
+    for (size_t i = row; i < m_visibleTexts.size(); ++i) {
+        request_layout(m_first_index + i);
+    }
+    for (size_t i = row; i-- > 0;) {
+        request_layout(m_first_index + i);
+    }
+}
+
+bool ScrollableTextArea::collect_layouts() {
+    {
+        std::lock_guard<std::mutex> lock(m_layout_results->mutex);
+        m_collected.swap(m_layout_results->done);
+    }
+    if (m_collected.empty()) {
+        return false;
+    }
+
+    bool was_at_bottom = m_view.getCenter().y + m_menu_height / 2 >= m_content_bottom;
+    size_t anchor = anchor_row();
+    bool resized = false;
+
+    for (LayoutResult& result : m_collected) {
+        if (result.index < m_first_index || result.index - m_first_index >= m_visibleTexts.size()) {
+            continue;
+        }
+        Row& row = m_visibleTexts[result.index - m_first_index];
+        if (row.ticket != result.ticket) {
+            continue;
+        }
+
+        row.source = std::move(result.source);
+        row.line.clear();
+        if (!result.block) {
+            // The font renders the missing glyphs here, on the thread that
+            // owns its texture, and the row is laid out again
+            m_glyphs = m_glyphs->extend(result.missing);
+            request_layout(result.index);
+            continue;
+        }
+
+        row.ticket = 0;
+        row.block = std::move(result.block);
+        sf::Color color = row_color(result.index);
+        if (row.block->color != color) {
+            row.block = recolored(*row.block, color);
+        }
+
+        float height = row.block->line_count * m_glyphs->get_line_height() + kMarginY;
+        resized = resized || height != row.height;
+        row.height = height;
+    }
+    m_collected.clear();
+
+    if (resized) {
+        reposition_rows(anchor);
+        if (was_at_bottom) {
+            scroll_to_bottom();
+        }
+    }
+    return true;
+}
+
+void ScrollableTextArea::wait_for_layouts() {
+    std::unique_lock<std::mutex> lock(m_layout_results->mutex);
+    m_layout_results->ready.wait(lock, [this] { return !m_layout_results->done.empty(); });
+}
+
+void ScrollableTextArea::settle_view() {
+    // Only the rows in view are waited for, so nothing is drawn with an
+    // estimated height or a stale wrap; the rest finish in the background
+    collect_layouts();
+    for (;;) {
+        float visibleTop = view_top();
+        float visibleBottom = view_bottom();
+        auto it = std::partition_point(m_visibleTexts.begin(), m_visibleTexts.end(), [visibleTop](const Row& row) {
+            return row.y + row.height < visibleTop;
+            });
+        while (it != m_visibleTexts.end() && it->y <= visibleBottom && it->ticket == 0) {
+            ++it;
+        }
+        if (it == m_visibleTexts.end() || it->y > visibleBottom) {
+            return;
+        }
+        wait_for_layouts();
+        collect_layouts();
+    }
+}
+
+void ScrollableTextArea::wait_for_row(size_t index) {
+    collect_layouts();
+    while (index >= m_first_index && index - m_first_index < m_visibleTexts.size()
+        && m_visibleTexts[index - m_first_index].ticket != 0) {
+        wait_for_layouts();
+        collect_layouts();
+    }
+}
+
+size_t ScrollableTextArea::anchor_row() const {
+    // The first row reaching into the view keeps its place when the rows
+    // around it change height
+    float visibleTop = view_top();
+    auto it = std::partition_point(m_visibleTexts.begin(), m_visibleTexts.end(), [visibleTop](const Row& row) {
+        return row.y + row.height < visibleTop;
+        });
+    size_t anchor = static_cast<size_t>(it - m_visibleTexts.begin());
+    return m_visibleTexts.empty() ? 0 : std::min(anchor, m_visibleTexts.size() - 1);
+}
+
+void ScrollableTextArea::reposition_rows(size_t anchor) {
+    if (m_visibleTexts.empty()) {
+        return;
+    }
+
+    float y = m_visibleTexts[anchor].y;
+    for (size_t i = anchor; i < m_visibleTexts.size(); ++i) {
+        m_visibleTexts[i].y = y;
+        y += m_visibleTexts[i].height;
+    }
+    m_content_bottom = y;
+
+    y = m_visibleTexts[anchor].y;
+    for (size_t i = anchor; i-- > 0;) {
+        y -= m_visibleTexts[i].height;
+        m_visibleTexts[i].y = y;
+    }
+    m_content_top = y;
+}
+
+void ScrollableTextArea::set_row_color(size_t index, const sf::Color& color) {
+    if (index < m_first_index || index - m_first_index >= m_visibleTexts.size()) {
+        return;
+    }
+    // A layout still in flight is recoloured when it arrives
+    Row& row = m_visibleTexts[index - m_first_index];
+    if (row.block && row.block->color != color) {
+        row.block = recolored(*row.block, color);
+    }
+}
+
+void ScrollableTextArea::apply_pending_lines() {
+    if (m_pending_lines.empty() && m_pending_skipped == 0) {
+        return;
+    }
+
+    if (m_pending_skipped > 0) {
+        // The skipped lines sit between the old rows and the new ones, so the
+        // window starts over at the tail
+        discard_rows();
+        m_first_index = m_total_count - m_pending_lines.size();
+        m_content_top = m_content_bottom;
+
+        if (m_history_provider && m_pending_lines.size() < m_page_rows) {
+            size_t count = std::min(m_page_rows - m_pending_lines.size(), m_first_index);
+            std::vector<std::string> lines = m_history_provider(m_first_index - count, count);
+            if (lines.size() == count) {
+                m_first_index -= count;
+                for (auto it = lines.rbegin(); it != lines.rend(); ++it) {
+                    m_pending_lines.push_front(std::move(*it));
+                }
+            }
+        }
+    }
+
+    for (const auto& line : m_pending_lines) {
+        push_back_row(line, false);
+    }
+    size_t added = m_pending_lines.size();
+    m_pending_lines.clear();
+    m_pending_skipped = 0;
+    trim_front();
+
+    // Newest first, as those are the rows the view follows
+    added = std::min(added, m_visibleTexts.size());
+    for (size_t i = m_visibleTexts.size(); i-- > m_visibleTexts.size() - added;) {
+        request_layout(m_first_index + i);
+    }
+    scroll_to_bottom();
+}
+
+bool ScrollableTextArea::window_at_tail() const {
+    return m_first_index + m_visibleTexts.size() + m_pending_skipped + m_pending_lines.size() >= m_total_count;
+}
+
+void ScrollableTextArea::discard_rows() {
+    // Layouts queued for these rows are skipped rather than run
+    m_layout_results->first_live_ticket = m_next_ticket;
+    m_visibleTexts.clear();
+}
+
+void ScrollableTextArea::push_back_row(std::string_view line, bool layout) {
+    // Placed at an estimated height until its layout comes back
+    Row row;
+    row.line.assign(line.data(), line.size());
+    row.y = m_content_bottom;
+    row.height = estimated_row_height();
+    m_content_bottom += row.height;
+    m_visibleTexts.push_back(std::move(row));
+    if (layout) {
+        request_layout(m_first_index + m_visibleTexts.size() - 1);
+    }
+}
+
+void ScrollableTextArea::push_front_row(std::string_view line) {
+    Row row;
+    row.line.assign(line.data(), line.size());
+    row.height = estimated_row_height();
+    m_content_top -= row.height;
+    row.y = m_content_top;
+    m_visibleTexts.push_front(std::move(row));
+    m_first_index--;
+    request_layout(m_first_index);
+}
+
+void ScrollableTextArea::trim_front() {
+    while (m_visibleTexts.size() > m_max_rows) {
+        m_content_top += m_visibleTexts.front().height;
+        m_visibleTexts.pop_front();
+        m_first_index++;
+    }
+}
+
+void ScrollableTextArea::trim_back() {
+    while (m_visibleTexts.size() > m_max_rows) {
+        m_content_bottom -= m_visibleTexts.back().height;
+        m_visibleTexts.pop_back();
+    }
+}
+
+void ScrollableTextArea::page_if_needed() {
+    if (!m_history_provider) {
+        return;
+    }
+    apply_pending_lines();
+
+    float visibleTop = view_top();
+    float visibleBottom = view_bottom();
+
+    if (visibleTop < m_content_top && m_first_index > 0) {
+        size_t count = std::min(m_page_rows, m_first_index);
+        std::vector<std::string> lines = m_history_provider(m_first_index - count, count);
+        if (lines.size() == count) {
+            for (auto it = lines.rbegin(); it != lines.rend(); ++it) {
+                push_front_row(*it);
+            }
+            trim_back();
+        }
+    }
+    else if (visibleBottom > m_content_bottom && !window_at_tail()) {
+        size_t first = m_first_index + m_visibleTexts.size();
+        size_t count = std::min(m_page_rows, m_total_count - first);
+        std::vector<std::string> lines = m_history_provider(first, count);
+        for (const auto& line : lines) {
+            push_back_row(line);
+        }
+        trim_front();
+    }
+}
+
+void ScrollableTextArea::scroll_to_bottom() {
+    // Adjust the view's center to ensure the latest message is visible
+    float viewBottom = m_pos.y + m_menu_height;
+    if (m_content_bottom > viewBottom) {
+        m_view.setCenter(m_menu_width / 2, m_content_bottom - m_menu_height / 2);
+    }
+}
@@ -1,108 +1,142 @@
 #include <SFML/Graphics.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "menu.hpp"
+#include "../ui-util/event_target.hpp"
+#include "../ui-util/text_layout.hpp"
 
 #ifndef SCROLLABLE_TEXT_AREA_HPP
 #define SCROLLABLE_TEXT_AREA_HPP
 
-class ScrollableTextArea : public Menu {
+class ScrollableTextArea : public Menu, public EventTarget {
 public:
-    ScrollableTextArea(const sf::Vector2f& pos, float width, float height)
-        : Menu(pos, false, true), m_menu_width(width), m_menu_height(height), m_pos(pos), m_isDragging(false) {
-        m_view.setSize(width, height);
-        m_view.setCenter(width / 2, height / 2);
-
-        if (!m_font.loadFromFile("font.ttf")) {
-            throw std::runtime_error("Failed to load font");
-        }
-    }
+    // Returns up to `count` lines of history starting at logical index `first`.
+    using HistoryProvider = std::function<std::vector<std::string>(size_t first, size_t count)>;
 
+    ScrollableTextArea(const sf::Vector2f& pos, float width, float height);
     ~ScrollableTextArea() {}
 
-    void draw(sf::RenderWindow& window) override {
-        sf::View originalView = window.getView();
-
-        window.setView(m_view);
-
-        sf::FloatRect visibleArea(
-            m_view.getCenter().x - m_view.getSize().x / 2.f,
-            m_view.getCenter().y - m_view.getSize().y / 2.f,
-            m_view.getSize().x, m_view.getSize().y);
-
-        // Draw only the text items that are within the visible area
-        for (const auto& text : m_visibleTexts) {
-            if (visibleArea.intersects(text.getGlobalBounds())) {
-                window.draw(text);
-            }
-        }
-
-        window.setView(originalView);
-    }
-
-    void handle_event(const sf::Event& event, sf::RenderWindow& window) {
-        Menu::handle_event(event);
-
-        if (event.type == sf::Event::MouseButtonPressed) {
-            if (event.mouseButton.button == sf::Mouse::Left) {
-                m_isDragging = true;
-                m_lastMousePosition = window.mapPixelToCoords(sf::Vector2i(event.mouseButton.x, event.mouseButton.y));
-            }
-        }
-        else if (event.type == sf::Event::MouseButtonReleased) {
-            if (event.mouseButton.button == sf::Mouse::Left) {
-                m_isDragging = false;
-            }
-        }
-        else if (event.type == sf::Event::MouseMoved) {
-            if (m_isDragging) {
-                sf::Vector2f currentMousePosition = window.mapPixelToCoords(sf::Vector2i(event.mouseMove.x, event.mouseMove.y));
-                sf::Vector2f delta = m_lastMousePosition - currentMousePosition;
-                m_view.move(delta);
-                m_lastMousePosition = currentMousePosition;
-            }
-        }
-        else if (event.type == sf::Event::MouseWheelScrolled) {
-            m_view.move(0, event.mouseWheelScroll.delta * -10);
-        }
-    }
-
-    void add_string(const std::string& new_line) {
-        float margin_x = 20.f;
-        float margin_y = 5.f;
-
-        sf::Text text;
-        text.setFont(m_font);
-        text.setCharacterSize(20);
-        text.setFillColor(sf::Color::White);
-        text.setString(new_line);
-
-        m_visibleTexts.push_back(text);
-
-        // Adjust the positions of all text items
-        float currentY = m_pos.y + m_menu_height - margin_y;
-        for (auto it = m_visibleTexts.rbegin(); it != m_visibleTexts.rend(); ++it) {
-            it->setPosition(m_pos.x + margin_x, currentY - it->getLocalBounds().height);
-            currentY -= it->getLocalBounds().height + margin_y;
-        }
-
-        // Adjust the view's center to ensure the latest message is visible
-        float viewBottom = m_pos.y + m_menu_height;
-        float contentBottom = m_visibleTexts.back().getPosition().y + m_visibleTexts.back().getLocalBounds().height + margin_y;
-        if (contentBottom > viewBottom) {
-            m_view.setCenter(m_menu_width / 2, contentBottom - m_menu_height / 2);
-        }
-    }
+    void draw_content(sf::RenderTarget& target) override;
+    void handle_event(const sf::Event& event, sf::RenderTarget& target);
+
+    sf::FloatRect get_hit_bounds() const override;
+    void dispatch_event(const sf::Event& event, sf::RenderWindow& window) override { handle_event(event, window); }
+    // New lines are queued and turned into rows by the next draw, once per
+    // frame however many arrived. Rows are laid out on the worker pool; a
+    // draw only waits for the ones in view.
+    void add_string(std::string_view new_line);
+    // Counts `count` new lines without their text. While the view follows
+    // the tail, the newest lines are fetched from the history provider in
+    // the next layout pass and everything older is only paged in on demand.
+    void add_lines(size_t count);
+
+    // Only `max_rows` lines are kept as drawable text. Lines that fall out of
+    // the window are fetched again from the provider when scrolled back to.
+    void set_max_rows(size_t max_rows);
+    size_t get_max_rows() const { return m_max_rows; }
+    void set_history_provider(HistoryProvider provider);
+
+    // A width change lays every row out again on the worker pool, starting
+    // with the ones in view.
+    void set_size(float width, float height);
+
+    // Brings the line with logical index `index` into view and highlights it,
+    // paging it in from the history provider if it is outside the window.
+    void scroll_to(size_t index);
+
+    // Replaces the text of the line with logical index `index`. A row in the
+    // window is laid out again on its own and the rows around it move to
+    // fit its new height, keeping the view where it was. Lines outside the
+    // window are picked up from the provider when paged in.
+    void update_line(size_t index, std::string_view text);
 
 private:
+    struct Row {
+        std::string line;                         // Until the text is decoded
+        std::shared_ptr<const sf::String> source;
+        std::shared_ptr<const TextBlock> block;   // Null until laid out
+        float y = 0.f;
+        float height = 0.f;
+        uint64_t ticket = 0;                      // Layout in flight, 0 if none
+    };
+
+    // Layouts finished by the workers, waiting for the thread that draws.
+    // Jobs hold a reference, so it outlives a text area destroyed mid-layout.
+    struct LayoutResult {
+        size_t index;
+        uint64_t ticket;
+        std::shared_ptr<const sf::String> source;
+        std::shared_ptr<const TextBlock> block;   // Null if glyphs were missing
+        std::vector<sf::Uint32> missing;
+    };
+    struct LayoutResults {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::vector<LayoutResult> done;
+        // Jobs older than this were for rows that are gone and are skipped
+        std::atomic<uint64_t> first_live_ticket{ 0 };
+    };
+
     sf::View m_view;
-    sf::Font m_font;
+    const sf::Font& m_font;
     float m_menu_width;
     float m_menu_height;
     sf::Vector2f m_accumulatedMouseDelta;
     sf::Vector2f m_pos;
-    std::vector<sf::Text> m_visibleTexts;
+    std::deque<Row> m_visibleTexts;
     bool m_isDragging;
     sf::Vector2f m_lastMousePosition;
+
+    HistoryProvider m_history_provider;
+    size_t m_max_rows = 500;
+    size_t m_page_rows = 50;
+    size_t m_first_index = 0;
+    size_t m_total_count = 0;
+    float m_content_top = 0.f;
+    float m_content_bottom = 0.f;
+    float m_wrap_width;
+    size_t m_highlight_index = static_cast<size_t>(-1);
+
+    std::shared_ptr<const GlyphSnapshot> m_glyphs;
+    std::shared_ptr<LayoutResults> m_layout_results;
+    std::vector<LayoutResult> m_collected;
+    uint64_t m_next_ticket = 1;
+    sf::VertexArray m_batch;
+
+    // Lines added since the last layout pass. `m_pending_skipped` lines come
+    // between the rows and these and are never laid out unless scrolled to.
+    std::deque<std::string> m_pending_lines;
+    size_t m_pending_skipped = 0;
+
+    float view_top() const { return m_view.getCenter().y - m_view.getSize().y / 2.f; }
+    float view_bottom() const { return view_top() + m_view.getSize().y; }
+    float estimated_row_height() const;
+    sf::Color row_color(size_t index) const;
+    void request_layout(size_t index);
+    void request_layouts_from(size_t row);
+    bool collect_layouts();
+    void wait_for_layouts();
+    void settle_view();
+    void wait_for_row(size_t index);
+    size_t anchor_row() const;
+    void reposition_rows(size_t anchor);
+    void set_row_color(size_t index, const sf::Color& color);
+    void apply_pending_lines();
+    bool window_at_tail() const;
+    void discard_rows();
+    void push_back_row(std::string_view line, bool layout = true);
+    void push_front_row(std::string_view line);
+    void trim_front();
+    void trim_back();
+    void page_if_needed();
+    void scroll_to_bottom();
 };
 
-#endif // SCROLLABLE_TEXT_AREA_HPP
\ No newline at end of file
+#endif // SCROLLABLE_TEXT_AREA_HPP
@@ -0,0 +1,153 @@
+#include "virtual_list.hpp"
+#include "../ui-assets/font_cache.hpp"
+#include "../../utf8.hpp"
+#include "../ui-util/render_stats.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    const float kMarginX = 8.f;
+    const float kMarginY = 3.f;
+    const unsigned int kCharacterSize = 16;
+    const long kWheelRows = 3;
+}
+
+VirtualList::VirtualList(const sf::Vector2f& pos, float width, float height)
+    : Menu(pos, false, true), m_bounds(pos, sf::Vector2f(width, height)), m_batch(sf::Triangles) {
+    if (!FontCache::loaded()) {
+        throw std::runtime_error("Failed to load font");
+    }
+    m_glyphs = GlyphSnapshot::create(FontCache::get(), kCharacterSize);
+    set_bounds(m_bounds);
+}
+
+void VirtualList::set_row_provider(RowProvider provider) {
+    m_provider = std::move(provider);
+    m_stale = true;
+}
+
+void VirtualList::set_row_count(size_t count) {
+    m_row_count = count;
+    scroll_by(0);
+    m_stale = true;
+}
+
+void VirtualList::set_bounds(const sf::FloatRect& bounds) {
+    m_bounds = bounds;
+    m_pos = sf::Vector2f(bounds.left, bounds.top);
+    set_menu_width(bounds.width);
+    set_menu_height(bounds.height);
+
+    sf::RectangleShape background(sf::Vector2f(bounds.width, bounds.height));
+    background.setPosition(m_pos);
+    background.setFillColor(sf::Color(0, 0, 0, 90));
+    set_background_rect(background);
+
+    scroll_by(0);
+    m_stale = true;
+}
+
+sf::FloatRect VirtualList::get_hit_bounds() const {
+    return m_bounds;
+}
+
+void VirtualList::handle_event(const sf::Event& event) {
+    if (event.type == sf::Event::MouseWheelScrolled) {
+        scroll_by(static_cast<long>(-event.mouseWheelScroll.delta * kWheelRows));
+    }
+}
+
+float VirtualList::row_height() const {
+    return m_glyphs->get_line_height() + kMarginY;
+}
+
+size_t VirtualList::visible_rows() const {
+    return static_cast<size_t>(std::max(m_bounds.height - kMarginY, 0.f) / row_height());
+}
+
+void VirtualList::scroll_by(long rows) {
+    size_t last_first = m_row_count - std::min(m_row_count, visible_rows());
+    long first = static_cast<long>(m_first_row) + rows;
+    size_t clamped = static_cast<size_t>(std::max(first, 0L));
+    clamped = std::min(clamped, last_first);
+    if (clamped != m_first_row) {
+        m_first_row = clamped;
+        m_stale = true;
+    }
+}
+
+void VirtualList::refresh() {
+    m_stale = false;
+    m_fetched.clear();
+    size_t count = std::min(visible_rows(), m_row_count - m_first_row);
+    if (m_provider && count > 0) {
+        m_provider(m_first_row, count, m_fetched);
+    }
+
+    // Slots are matched by position on screen: a row that stayed put, as
+    // most do when one member comes or goes far away, isn't shaped again
+    m_slots.resize(m_fetched.size());
+    for (size_t i = 0; i < m_fetched.size(); ++i) {
+        Slot& slot = m_slots[i];
+        if (slot.shaped && slot.row.text == m_fetched[i].text && slot.row.color == m_fetched[i].color) {
+            continue;
+        }
+        slot.row = std::move(m_fetched[i]);
+        shape(slot);
+    }
+}
+
+void VirtualList::shape(Slot& slot) {
+    std::basic_string<uint32_t> decoded(slot.row.text.size() + 1, 0);
+    decoded.resize(utf8::Decode(slot.row.text.data(), slot.row.text.size(), &decoded[0]));
+    sf::String text(reinterpret_cast<const sf::Uint32*>(decoded.c_str()));
+
+    if (!TextLayout(*m_glyphs).find_missing(text, m_missing)) {
+        // Only the thread that draws touches the font, and that is this one
+        m_glyphs = m_glyphs->extend(m_missing);
+    }
+    TextLayout layout(*m_glyphs);
+
+    // One line per row: text that doesn't fit is cut short
+    float width = std::max(m_bounds.width - 2 * kMarginX, 1.f);
+    float used = 0.f;
+    size_t length = 0;
+    for (; length < text.getSize(); ++length) {
+        float advance = layout.get_advance(text[length]);
+        if (used + advance > width) {
+            break;
+        }
+        used += advance;
+    }
+    if (length < text.getSize()) {
+        float ellipsis = 3 * layout.get_advance('.');
+        while (length > 0 && used + ellipsis > width) {
+            used -= layout.get_advance(text[--length]);
+        }
+        text = text.substring(0, length) + sf::String("...");
+    }
+    layout.shape(text, width + 1.f, slot.row.color, slot.block);
+    slot.shaped = true;
+}
+
+void VirtualList::draw_content(sf::RenderTarget& target) {
+    if (m_stale) {
+        refresh();
+    }
+
+    m_batch.clear();
+    float y = m_bounds.top + kMarginY;
+    for (const Slot& slot : m_slots) {
+        if (!slot.shaped) {
+            continue;
+        }
+        sf::Vector2f origin(m_bounds.left + kMarginX, y);
+        for (const sf::Vertex& vertex : slot.block.vertices) {
+            m_batch.append(sf::Vertex(vertex.position + origin, vertex.color, vertex.texCoords));
+        }
+        y += row_height();
+    }
+    if (m_batch.getVertexCount() > 0) {
+        RenderStats::draw(target, m_batch, sf::RenderStates(&m_glyphs->get_texture()));
+    }
+}
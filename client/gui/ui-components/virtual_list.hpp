@@ -0,0 +1,74 @@
+#include <SFML/Graphics.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "menu.hpp"
+#include "../ui-util/event_target.hpp"
+#include "../ui-util/text_layout.hpp"
+
+#ifndef VIRTUAL_LIST_HPP
+#define VIRTUAL_LIST_HPP
+
+// A list of single-line rows of which only the ones in view exist as text.
+// Rows are asked for by position from a provider, so the list can front a
+// collection of any size, and a change anywhere in it costs one fetch of
+// the rows in view on the next draw, however many changes came in between.
+// Rows whose text didn't change keep their glyph quads.
+class VirtualList : public Menu, public EventTarget {
+public:
+    struct Row {
+        std::string text;
+        sf::Color color = sf::Color::White;
+    };
+
+    // Appends up to `count` rows starting at position `first` to `rows`.
+    using RowProvider = std::function<void(size_t first, size_t count, std::vector<Row>& rows)>;
+
+    VirtualList(const sf::Vector2f& pos, float width, float height);
+
+    void set_row_provider(RowProvider provider);
+
+    // The rows in view are fetched again on the next draw. The first row
+    // shown keeps its position unless the list got too short for it.
+    void set_row_count(size_t count);
+    void invalidate() { m_stale = true; }
+
+    size_t get_row_count() const { return m_row_count; }
+    size_t get_first_row() const { return m_first_row; }
+
+    void set_bounds(const sf::FloatRect& bounds);
+
+    void draw_content(sf::RenderTarget& target) override;
+
+    sf::FloatRect get_hit_bounds() const override;
+    void dispatch_event(const sf::Event& event, sf::RenderWindow& window) override { handle_event(event); }
+    void handle_event(const sf::Event& event) override;
+
+private:
+    struct Slot {
+        Row row;
+        TextBlock block;
+        bool shaped = false;
+    };
+
+    sf::FloatRect m_bounds;
+    RowProvider m_provider;
+    size_t m_row_count = 0;
+    size_t m_first_row = 0;
+    bool m_stale = true;
+
+    std::shared_ptr<const GlyphSnapshot> m_glyphs;
+    std::vector<Row> m_fetched;
+    std::vector<Slot> m_slots;
+    std::vector<sf::Uint32> m_missing;
+    sf::VertexArray m_batch;
+
+    float row_height() const;
+    size_t visible_rows() const;
+    void scroll_by(long rows);
+    void refresh();
+    void shape(Slot& slot);
+};
+
+#endif // VIRTUAL_LIST_HPP
@@ -0,0 +1,39 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EVENT_TARGET_HPP
+#define EVENT_TARGET_HPP
+
+#include <SFML/Graphics.hpp>
+
+// A widget that MenuUtil can route events to. Pointer events reach it when
+// they land inside its hit bounds, keyboard events only while it has focus.
+class EventTarget
+{
+public:
+	virtual ~EventTarget() {}
+
+	// Area in window pixels that receives pointer events.
+	virtual sf::FloatRect get_hit_bounds() const = 0;
+
+	virtual void dispatch_event(const sf::Event& event, sf::RenderWindow& window) = 0;
+
+	virtual bool accepts_focus() const { return false; }
+
+	virtual void set_focused(bool focused) {}
+};
+
+#endif // EVENT_TARGET_HPP
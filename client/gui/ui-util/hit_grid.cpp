@@ -0,0 +1,127 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "hit_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+HitGrid::HitGrid(float cell_size) : m_cell_size(cell_size) {}
+
+int HitGrid::cell_coord(float value) const
+{
+	return static_cast<int>(std::floor(value / m_cell_size));
+}
+
+int64_t HitGrid::cell_key(int x, int y)
+{
+	return (static_cast<int64_t>(x) << 32) ^ static_cast<uint32_t>(y);
+}
+
+void HitGrid::insert_entry(const Entry& entry)
+{
+	int x0 = cell_coord(entry.bounds.left);
+	int y0 = cell_coord(entry.bounds.top);
+	int x1 = cell_coord(entry.bounds.left + entry.bounds.width);
+	int y1 = cell_coord(entry.bounds.top + entry.bounds.height);
+
+	for (int y = y0; y <= y1; ++y)
+		for (int x = x0; x <= x1; ++x)
+			m_cells[cell_key(x, y)].push_back(entry);
+}
+
+void HitGrid::remove_entry(const Entry& entry)
+{
+	int x0 = cell_coord(entry.bounds.left);
+	int y0 = cell_coord(entry.bounds.top);
+	int x1 = cell_coord(entry.bounds.left + entry.bounds.width);
+	int y1 = cell_coord(entry.bounds.top + entry.bounds.height);
+
+	for (int y = y0; y <= y1; ++y)
+	{
+		for (int x = x0; x <= x1; ++x)
+		{
+			auto cell = m_cells.find(cell_key(x, y));
+			if (cell == m_cells.end())
+				continue;
+
+			auto& list = cell->second;
+			list.erase(std::remove_if(list.begin(), list.end(), [&entry](const Entry& e) {
+				return e.target == entry.target;
+				}), list.end());
+			if (list.empty())
+				m_cells.erase(cell);
+		}
+	}
+}
+
+void HitGrid::insert(EventTarget* target, const sf::FloatRect& bounds)
+{
+	remove(target);
+
+	Entry entry{ target, bounds, m_next_z++ };
+	m_entries[target] = entry;
+	insert_entry(entry);
+}
+
+void HitGrid::remove(EventTarget* target)
+{
+	auto it = m_entries.find(target);
+	if (it == m_entries.end())
+		return;
+
+	remove_entry(it->second);
+	m_entries.erase(it);
+}
+
+void HitGrid::update(EventTarget* target, const sf::FloatRect& bounds)
+{
+	auto it = m_entries.find(target);
+	if (it == m_entries.end())
+	{
+		insert(target, bounds);
+		return;
+	}
+
+	if (it->second.bounds == bounds)
+		return;
+
+	// Keep the stacking order the target was first registered with
+	remove_entry(it->second);
+	it->second.bounds = bounds;
+	insert_entry(it->second);
+}
+
+EventTarget* HitGrid::query(const sf::Vector2f& point) const
+{
+	auto cell = m_cells.find(cell_key(cell_coord(point.x), cell_coord(point.y)));
+	if (cell == m_cells.end())
+		return nullptr;
+
+	const Entry* top = nullptr;
+	for (const auto& entry : cell->second)
+	{
+		if (entry.bounds.contains(point) && (!top || entry.z > top->z))
+			top = &entry;
+	}
+	return top ? top->target : nullptr;
+}
+
+void HitGrid::clear()
+{
+	m_cells.clear();
+	m_entries.clear();
+}
@@ -0,0 +1,65 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HIT_GRID_HPP
+#define HIT_GRID_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class EventTarget;
+
+// Uniform grid over widget bounds. Each target is listed in every cell its
+// bounds overlap, so a point query only looks at the few targets sharing
+// one cell instead of testing every widget.
+class HitGrid
+{
+public:
+	explicit HitGrid(float cell_size = 64.f);
+
+	// Targets inserted later sit on top of earlier ones.
+	void insert(EventTarget* target, const sf::FloatRect& bounds);
+
+	void remove(EventTarget* target);
+
+	void update(EventTarget* target, const sf::FloatRect& bounds);
+
+	EventTarget* query(const sf::Vector2f& point) const;
+
+	void clear();
+
+private:
+	struct Entry
+	{
+		EventTarget* target;
+		sf::FloatRect bounds;
+		uint64_t z;
+	};
+
+	float m_cell_size;
+	uint64_t m_next_z = 0;
+	std::unordered_map<int64_t, std::vector<Entry>> m_cells;
+	std::unordered_map<EventTarget*, Entry> m_entries;
+
+	int cell_coord(float value) const;
+	static int64_t cell_key(int x, int y);
+	void insert_entry(const Entry& entry);
+	void remove_entry(const Entry& entry);
+};
+
+#endif // HIT_GRID_HPP
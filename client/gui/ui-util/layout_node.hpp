@@ -0,0 +1,63 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LAYOUT_NODE_HPP
+#define LAYOUT_NODE_HPP
+
+#include <SFML/Graphics.hpp>
+
+// A widget's place in a retained layout. The node caches its measured size;
+// when that changes it tells its parent, which marks itself dirty from that
+// child onwards and repositions only those children on its next relayout.
+class LayoutNode
+{
+public:
+	virtual ~LayoutNode() {}
+
+	const sf::Vector2f& get_measured_size() const { return m_measured_size; }
+
+	LayoutNode* get_layout_parent() const { return m_layout_parent; }
+
+	void attach_to_layout(LayoutNode* parent, size_t index)
+	{
+		m_layout_parent = parent;
+		m_layout_index = index;
+	}
+
+	// Moves the node to the position its parent's layout assigned it.
+	virtual void place(float x, float y) = 0;
+
+protected:
+	void set_measured_size(float width, float height)
+	{
+		sf::Vector2f delta(width - m_measured_size.x, height - m_measured_size.y);
+		if (delta.x == 0.f && delta.y == 0.f)
+			return;
+
+		m_measured_size = sf::Vector2f(width, height);
+		if (m_layout_parent)
+			m_layout_parent->on_child_resized(m_layout_index, delta);
+	}
+
+	virtual void on_child_resized(size_t index, const sf::Vector2f& delta) {}
+
+private:
+	LayoutNode* m_layout_parent = nullptr;
+	size_t m_layout_index = 0;
+	sf::Vector2f m_measured_size;
+};
+
+#endif // LAYOUT_NODE_HPP
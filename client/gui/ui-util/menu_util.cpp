@@ -17,6 +17,8 @@
 #include "menu_util.hpp"
 
 #include "../ui-components/menu.hpp"
+#include "../ui-components/input_field.hpp"
+#include "event_target.hpp"
 
 MenuUtil::MenuUtil() {}
 
@@ -33,6 +35,104 @@ void MenuUtil::clear_stack()
 void MenuUtil::add_menu(Menu* menu)
 {
     m_menu_stack.push_back(menu);
+
+    if (menu)
+    {
+        for (auto& input : menu->m_input_fields)
+            register_target(input.get());
+    }
+}
+
+void MenuUtil::register_target(EventTarget* target)
+{
+    if (!target)
+    {
+        std::cerr << "Cannot register a null event target.\n";
+        return;
+    }
+
+    m_hit_grid.insert(target, target->get_hit_bounds());
+}
+
+void MenuUtil::unregister_target(EventTarget* target)
+{
+    m_hit_grid.remove(target);
+
+    if (m_focused == target)
+        m_focused = nullptr;
+    if (m_pointer_capture == target)
+        m_pointer_capture = nullptr;
+}
+
+void MenuUtil::update_target_bounds(EventTarget* target)
+{
+    if (target)
+        m_hit_grid.update(target, target->get_hit_bounds());
+}
+
+void MenuUtil::set_focus(EventTarget* target)
+{
+    if (target == m_focused)
+        return;
+
+    if (m_focused)
+        m_focused->set_focused(false);
+
+    m_focused = target;
+
+    if (m_focused)
+        m_focused->set_focused(true);
+}
+
+void MenuUtil::handle_event(const sf::Event& event, sf::RenderWindow& window)
+{
+    switch (event.type)
+    {
+    case sf::Event::MouseButtonPressed:
+    {
+        EventTarget* hit = m_hit_grid.query(sf::Vector2f(static_cast<float>(event.mouseButton.x), static_cast<float>(event.mouseButton.y)));
+        set_focus(hit && hit->accepts_focus() ? hit : nullptr);
+        m_pointer_capture = hit;
+        if (hit)
+            hit->dispatch_event(event, window);
+        break;
+    }
+    case sf::Event::MouseButtonReleased:
+    {
+        EventTarget* target = m_pointer_capture ? m_pointer_capture
+            : m_hit_grid.query(sf::Vector2f(static_cast<float>(event.mouseButton.x), static_cast<float>(event.mouseButton.y)));
+        m_pointer_capture = nullptr;
+        if (target)
+            target->dispatch_event(event, window);
+        break;
+    }
+    case sf::Event::MouseMoved:
+    {
+        EventTarget* target = m_pointer_capture ? m_pointer_capture
+            : m_hit_grid.query(sf::Vector2f(static_cast<float>(event.mouseMove.x), static_cast<float>(event.mouseMove.y)));
+        if (target)
+            target->dispatch_event(event, window);
+        break;
+    }
+    case sf::Event::MouseWheelScrolled:
+    {
+        EventTarget* target = m_hit_grid.query(sf::Vector2f(static_cast<float>(event.mouseWheelScroll.x), static_cast<float>(event.mouseWheelScroll.y)));
+        if (target)
+            target->dispatch_event(event, window);
+        break;
+    }
+    case sf::Event::KeyPressed:
+    case sf::Event::KeyReleased:
+    case sf::Event::TextEntered:
+        if (m_focused)
+            m_focused->dispatch_event(event, window);
+        break;
+    case sf::Event::LostFocus:
+        m_pointer_capture = nullptr;
+        break;
+    default:
+        break;
+    }
 }
 
 void MenuUtil::stop_menu(Menu* menu)
@@ -43,12 +143,28 @@ void MenuUtil::stop_menu(Menu* menu)
         std::cerr << "Cannot access null ptr or menu is already inactive!\n";
 }
 
-void MenuUtil::draw_menus(sf::RenderWindow& window)
+void MenuUtil::draw_menus(sf::RenderTarget& target)
 {
+    // The backgrounds of every menu go out first, one draw call per atlas
+    // page, then the text on top of them. Menus in the stack sit side by
+    // side, so nothing depends on one menu's text being covered by the next.
+    for (const auto& menu : m_menu_stack)
+    {
+        if (menu && menu->m_is_active)
+            menu->batch_background(m_batch);
+    }
+    m_batch.draw(target);
+
     for (const auto& menu : m_menu_stack)
     {
         if (menu && menu->m_is_active)
-            menu->draw(window);
+        {
+            menu->draw_content(target);
+
+            // Drawing settles the menu's layout, which may have moved its fields
+            for (auto& input : menu->m_input_fields)
+                update_target_bounds(input.get());
+        }
     }
 }
 
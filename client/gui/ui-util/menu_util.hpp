@@ -15,8 +15,12 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../ui-util/directives.hpp"
+#include "hit_grid.hpp"
+#include "sprite_batch.hpp"
+#include "../ui-assets/texture_atlas.hpp"
 
 class Menu;
+class EventTarget;
 
 #ifndef MENU_UTIL_HPP
 #define MENU_UTIL_HPP
@@ -92,7 +96,24 @@ public:
 
     void stop_menu(Menu* menu);
 
-    void draw_menus(sf::RenderWindow& window);
+    void draw_menus(sf::RenderTarget& target);
+
+    // Routes one event: pointer events to the topmost target under the
+    // cursor (or the one holding the pointer during a drag), keyboard and
+    // text events only to the focused target.
+    void handle_event(const sf::Event& event, sf::RenderWindow& window);
+
+    // Targets registered later are hit-tested on top of earlier ones.
+    void register_target(EventTarget* target);
+
+    void unregister_target(EventTarget* target);
+
+    // Call after a registered target has moved or been resized.
+    void update_target_bounds(EventTarget* target);
+
+    void set_focus(EventTarget* target);
+
+    EventTarget* get_focus() const { return m_focused; }
 
     template <typename T>
     void add_bg_to_element(T* t) {
@@ -143,40 +164,20 @@ public:
             return;
         }
 
-        sf::Sprite* sprite = new sf::Sprite;
-
-        sf::Texture* texture = new sf::Texture;
-        texture->setSmooth(true);
-        texture->setRepeated(true);
-        if (!texture->loadFromFile(texture_path)) {
+        // Shared through the atlas: every element showing the same file uses
+        // the same pixels, and is stretched over its own bounds when drawn
+        const AtlasImage* image = TextureAtlas::get().load(texture_path);
+        if (!image) {
             std::cerr << "Error: Failed to load texture from file: " << texture_path << "\n";
-            delete texture;
             return;
         }
-        sprite->setTexture(*texture);
-
-        // Check if T has the get_menu_width and get_menu_height functions
-        if constexpr (has_get_width<T>::value && has_get_height<T>::value) {
-            sprite->setScale(sf::Vector2f(t->get_width() / texture->getSize().x, t->get_height() / texture->getSize().y));
-        }
-        else {
-            std::cerr << "T doesn't have get_width or get_height functions.\n";
-        }
 
-        // Check if T has the get_position function
-        if constexpr (has_get_position<T>::value) {
-            sprite->setPosition(t->get_position());
-        }
-        else {
-            std::cerr << "T doesn't have a get_position function.\n";
-        }
-
-        // Check if T has the set_background_rect function
-        if constexpr (std::is_member_function_pointer<decltype(&T::set_background_sprite)>::value) {
-            t->set_background_sprite(sprite);
+        // Check if T has the set_background_image function
+        if constexpr (std::is_member_function_pointer<decltype(&T::set_background_image)>::value) {
+            t->set_background_image(image);
         }
         else {
-            std::cerr << "T doesn't have a set_background_sprite function.\n";
+            std::cerr << "T doesn't have a set_background_image function.\n";
         }
     }
 
@@ -186,6 +187,11 @@ public:
 
 private:
     std::vector<Menu*> m_menu_stack;
+    HitGrid m_hit_grid;
+    EventTarget* m_focused = nullptr;
+    EventTarget* m_pointer_capture = nullptr;
+    // Reused every frame, so its vertex arrays stop growing once warm
+    SpriteBatch m_batch;
 };
 
 #endif // MENU_UTIL_HPP
\ No newline at end of file
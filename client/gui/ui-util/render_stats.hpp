@@ -0,0 +1,77 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RENDER_STATS_HPP
+#define RENDER_STATS_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+
+// Counts what the widgets submit to SFML, so benchmarks can report draw
+// calls and vertices per frame. Widgets draw through RenderStats::draw; the
+// vertex counts mirror how SFML 2 builds each drawable.
+class RenderStats
+{
+public:
+	size_t draw_calls = 0;
+	size_t vertices = 0;
+
+	static RenderStats& get()
+	{
+		static RenderStats stats;
+		return stats;
+	}
+
+	static void reset() { get() = RenderStats(); }
+
+	template <typename T>
+	static void draw(sf::RenderTarget& target, const T& drawable)
+	{
+		target.draw(drawable);
+		RenderStats& stats = get();
+		stats.draw_calls += draw_call_count(drawable);
+		stats.vertices += vertex_count(drawable);
+	}
+
+	template <typename T>
+	static void draw(sf::RenderTarget& target, const T& drawable, const sf::RenderStates& states)
+	{
+		target.draw(drawable, states);
+		RenderStats& stats = get();
+		stats.draw_calls += draw_call_count(drawable);
+		stats.vertices += vertex_count(drawable);
+	}
+
+private:
+	// Outlined texts and shapes are drawn twice: outline, then fill
+	static size_t draw_call_count(const sf::Text& text) { return text.getOutlineThickness() != 0.f ? 2 : 1; }
+	static size_t draw_call_count(const sf::Shape& shape) { return shape.getOutlineThickness() != 0.f ? 2 : 1; }
+	static size_t draw_call_count(const sf::Sprite&) { return 1; }
+	static size_t draw_call_count(const sf::VertexArray&) { return 1; }
+
+	// Six vertices (two triangles) per glyph
+	static size_t vertex_count(const sf::Text& text) { return text.getString().getSize() * 6 * draw_call_count(text); }
+	// A triangle fan over the points plus the centre and closing vertex
+	static size_t vertex_count(const sf::Shape& shape)
+	{
+		size_t points = shape.getPointCount();
+		return points + 2 + (shape.getOutlineThickness() != 0.f ? (points + 1) * 2 : 0);
+	}
+	static size_t vertex_count(const sf::Sprite&) { return 4; }
+	static size_t vertex_count(const sf::VertexArray& vertices) { return vertices.getVertexCount(); }
+};
+
+#endif // RENDER_STATS_HPP
@@ -0,0 +1,54 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "shelf_packer.hpp"
+
+ShelfPacker::ShelfPacker(unsigned int width, unsigned int height) : m_width(width), m_height(height) {}
+
+bool ShelfPacker::pack(unsigned int width, unsigned int height, sf::Vector2u& position)
+{
+	if (width > m_width || height > m_height)
+		return false;
+
+	Shelf* best = nullptr;
+	for (Shelf& shelf : m_shelves)
+	{
+		if (shelf.height < height || m_width - shelf.used_width < width)
+			continue;
+		if (!best || shelf.height < best->height)
+			best = &shelf;
+	}
+
+	// A new shelf is only opened when none fits, or the best one would waste
+	// more than half its height
+	if (!best || best->height > 2 * height)
+	{
+		if (m_height - m_next_shelf_y >= height)
+		{
+			m_shelves.push_back({ m_next_shelf_y, height, 0 });
+			m_next_shelf_y += height;
+			best = &m_shelves.back();
+		}
+		else if (!best)
+		{
+			return false;
+		}
+	}
+
+	position = sf::Vector2u(best->used_width, best->y);
+	best->used_width += width;
+	return true;
+}
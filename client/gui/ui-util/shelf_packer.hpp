@@ -0,0 +1,52 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SHELF_PACKER_HPP
+#define SHELF_PACKER_HPP
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+// Packs rectangles into a fixed-size page in horizontal shelves. Each shelf
+// is as tall as the first rectangle placed on it; later ones go on the
+// shelf that wastes the least height, or open a new shelf below the last.
+// Good enough for UI images, which come in a handful of similar sizes.
+class ShelfPacker
+{
+public:
+	ShelfPacker(unsigned int width, unsigned int height);
+
+	// Finds room for a width x height rectangle. Returns false when the page
+	// is full.
+	bool pack(unsigned int width, unsigned int height, sf::Vector2u& position);
+
+	unsigned int get_used_height() const { return m_next_shelf_y; }
+
+private:
+	struct Shelf
+	{
+		unsigned int y;
+		unsigned int height;
+		unsigned int used_width;
+	};
+
+	unsigned int m_width;
+	unsigned int m_height;
+	unsigned int m_next_shelf_y = 0;
+	std::vector<Shelf> m_shelves;
+};
+
+#endif // SHELF_PACKER_HPP
@@ -0,0 +1,78 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "sprite_batch.hpp"
+#include "render_stats.hpp"
+#include "../ui-assets/texture_atlas.hpp"
+
+void SpriteBatch::add_rect(const sf::FloatRect& rect, const sf::Color& color)
+{
+	// Every vertex samples the middle of the white block
+	const AtlasImage& white = TextureAtlas::get().get_white();
+	sf::FloatRect center(white.rect.left + white.rect.width / 2.f, white.rect.top + white.rect.height / 2.f, 0.f, 0.f);
+	add_quad(white.page, rect, center, color);
+}
+
+void SpriteBatch::add_image(const AtlasImage& image, const sf::FloatRect& rect, const sf::Color& color)
+{
+	add_quad(image.page, rect, sf::FloatRect(image.rect), color);
+}
+
+void SpriteBatch::add_quad(size_t page, const sf::FloatRect& rect, const sf::FloatRect& tex_rect, const sf::Color& color)
+{
+	if (page >= m_pages.size())
+		m_pages.resize(page + 1, sf::VertexArray(sf::Triangles));
+
+	float right = rect.left + rect.width;
+	float bottom = rect.top + rect.height;
+	float tex_right = tex_rect.left + tex_rect.width;
+	float tex_bottom = tex_rect.top + tex_rect.height;
+
+	sf::Vertex top_left(sf::Vector2f(rect.left, rect.top), color, sf::Vector2f(tex_rect.left, tex_rect.top));
+	sf::Vertex top_right(sf::Vector2f(right, rect.top), color, sf::Vector2f(tex_right, tex_rect.top));
+	sf::Vertex bottom_left(sf::Vector2f(rect.left, bottom), color, sf::Vector2f(tex_rect.left, tex_bottom));
+	sf::Vertex bottom_right(sf::Vector2f(right, bottom), color, sf::Vector2f(tex_right, tex_bottom));
+
+	// Two triangles, so quads from every widget share one primitive type
+	sf::VertexArray& vertices = m_pages[page];
+	vertices.append(top_left);
+	vertices.append(top_right);
+	vertices.append(bottom_left);
+	vertices.append(bottom_left);
+	vertices.append(top_right);
+	vertices.append(bottom_right);
+}
+
+void SpriteBatch::draw(sf::RenderTarget& target)
+{
+	TextureAtlas& atlas = TextureAtlas::get();
+	for (size_t page = 0; page < m_pages.size(); ++page)
+	{
+		if (m_pages[page].getVertexCount() == 0)
+			continue;
+
+		RenderStats::draw(target, m_pages[page], sf::RenderStates(&atlas.get_page(page)));
+		m_pages[page].clear();
+	}
+}
+
+size_t SpriteBatch::get_quad_count() const
+{
+	size_t vertices = 0;
+	for (const auto& page : m_pages)
+		vertices += page.getVertexCount();
+	return vertices / 6;
+}
@@ -0,0 +1,48 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SPRITE_BATCH_HPP
+#define SPRITE_BATCH_HPP
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+struct AtlasImage;
+
+// Collects solid rectangles and atlas images as textured triangles, one
+// vertex array per atlas page, and draws each page with a single call.
+// The arrays keep their capacity, so a batch reused every frame stops
+// allocating once warm.
+class SpriteBatch
+{
+public:
+	void add_rect(const sf::FloatRect& rect, const sf::Color& color);
+
+	void add_image(const AtlasImage& image, const sf::FloatRect& rect, const sf::Color& color = sf::Color::White);
+
+	// Draws and empties the batch. Pages are drawn in order, so where quads
+	// overlap, those on a later page end up on top.
+	void draw(sf::RenderTarget& target);
+
+	size_t get_quad_count() const;
+
+private:
+	std::vector<sf::VertexArray> m_pages;
+
+	void add_quad(size_t page, const sf::FloatRect& rect, const sf::FloatRect& tex_rect, const sf::Color& color);
+};
+
+#endif // SPRITE_BATCH_HPP
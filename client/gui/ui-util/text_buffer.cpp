@@ -0,0 +1,170 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "text_buffer.hpp"
+
+TextBuffer::Entry TextBuffer::left_total() const
+{
+	return m_left.empty() ? Entry{ 0.0, 0 } : m_left.back();
+}
+
+TextBuffer::Entry TextBuffer::right_total() const
+{
+	return m_right.empty() ? Entry{ 0.0, 0 } : m_right.back();
+}
+
+void TextBuffer::move_gap(size_t index)
+{
+	while (m_left.size() > index)
+	{
+		Entry last = m_left.back();
+		m_left.pop_back();
+		Entry before = left_total();
+		Entry after = right_total();
+		m_right.push_back({ after.x + (last.x - before.x), after.bytes + (last.bytes - before.bytes) });
+
+		for (size_t i = before.bytes; i < last.bytes; ++i)
+		{
+			m_right_bytes.push_back(m_left_bytes.back());
+			m_left_bytes.pop_back();
+		}
+	}
+
+	while (m_left.size() < index && !m_right.empty())
+	{
+		Entry first = m_right.back();
+		m_right.pop_back();
+		Entry after = right_total();
+		Entry before = left_total();
+		m_left.push_back({ before.x + (first.x - after.x), before.bytes + (first.bytes - after.bytes) });
+
+		for (size_t i = after.bytes; i < first.bytes; ++i)
+		{
+			m_left_bytes.push_back(m_right_bytes.back());
+			m_right_bytes.pop_back();
+		}
+	}
+}
+
+void TextBuffer::insert(size_t index, sf::Uint32 codepoint, float advance)
+{
+	move_gap(index);
+
+	char encoded[4];
+	char* end = sf::Utf8::encode(codepoint, encoded);
+	m_left_bytes.insert(m_left_bytes.end(), encoded, end);
+
+	Entry before = left_total();
+	m_left.push_back({ before.x + advance, before.bytes + static_cast<size_t>(end - encoded) });
+}
+
+void TextBuffer::erase(size_t index)
+{
+	if (index >= size())
+		return;
+
+	move_gap(index + 1);
+
+	m_left.pop_back();
+	m_left_bytes.resize(left_total().bytes);
+}
+
+void TextBuffer::clear()
+{
+	m_left.clear();
+	m_right.clear();
+	m_left_bytes.clear();
+	m_right_bytes.clear();
+}
+
+float TextBuffer::x_of(size_t index) const
+{
+	if (index == 0)
+		return 0.f;
+	if (index <= m_left.size())
+		return static_cast<float>(m_left[index - 1].x);
+
+	double total = left_total().x + right_total().x;
+	if (index >= size())
+		return static_cast<float>(total);
+	return static_cast<float>(total - m_right[size() - 1 - index].x);
+}
+
+size_t TextBuffer::byte_of(size_t index) const
+{
+	if (index == 0)
+		return 0;
+	if (index <= m_left.size())
+		return m_left[index - 1].bytes;
+
+	size_t total = left_total().bytes + right_total().bytes;
+	if (index >= size())
+		return total;
+	return total - m_right[size() - 1 - index].bytes;
+}
+
+char TextBuffer::byte_at(size_t offset) const
+{
+	if (offset < m_left_bytes.size())
+		return m_left_bytes[offset];
+	return m_right_bytes[m_right_bytes.size() - 1 - (offset - m_left_bytes.size())];
+}
+
+size_t TextBuffer::index_before(float x) const
+{
+	// x_of is monotonic in the index, so bisect over [0, size]
+	size_t low = 0;
+	size_t high = size();
+	while (low < high)
+	{
+		size_t mid = low + (high - low + 1) / 2;
+		if (x_of(mid) <= x)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+	return low;
+}
+
+size_t TextBuffer::index_at(float x) const
+{
+	size_t index = index_before(x);
+	if (index < size() && x - x_of(index) > x_of(index + 1) - x)
+		++index;
+	return index;
+}
+
+std::string TextBuffer::utf8() const
+{
+	std::string result;
+	result.reserve(m_left_bytes.size() + m_right_bytes.size());
+	result.append(m_left_bytes.begin(), m_left_bytes.end());
+	result.append(m_right_bytes.rbegin(), m_right_bytes.rend());
+	return result;
+}
+
+sf::String TextBuffer::slice(size_t first, size_t last) const
+{
+	size_t from = byte_of(first);
+	size_t to = byte_of(last);
+
+	std::string bytes;
+	bytes.reserve(to - from);
+	for (size_t i = from; i < to; ++i)
+		bytes.push_back(byte_at(i));
+
+	return sf::String::fromUtf8(bytes.begin(), bytes.end());
+}
@@ -0,0 +1,78 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TEXT_BUFFER_HPP
+#define TEXT_BUFFER_HPP
+
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <vector>
+
+// Editable UTF-8 text kept as a gap buffer. Alongside the bytes, every
+// codepoint stores running totals of glyph advance and byte length: the
+// side before the gap counts from the start, the side after it counts from
+// the end. Both sides stay sorted, so edits at the caret are O(1) and
+// position <-> x lookups are O(log n) binary searches.
+class TextBuffer
+{
+public:
+	size_t size() const { return m_left.size() + m_right.size(); }
+
+	bool empty() const { return size() == 0; }
+
+	void insert(size_t index, sf::Uint32 codepoint, float advance);
+
+	void erase(size_t index);
+
+	void clear();
+
+	// Horizontal offset of the caret placed before character `index`.
+	float x_of(size_t index) const;
+
+	float width() const { return x_of(size()); }
+
+	// Largest caret index whose offset is not past `x`.
+	size_t index_before(float x) const;
+
+	// Caret index closest to `x`.
+	size_t index_at(float x) const;
+
+	std::string utf8() const;
+
+	sf::String slice(size_t first, size_t last) const;
+
+private:
+	struct Entry
+	{
+		double x;
+		size_t bytes;
+	};
+
+	// m_right and m_right_bytes are stored back to front, so their back()
+	// is the element right after the gap.
+	std::vector<Entry> m_left;
+	std::vector<Entry> m_right;
+	std::vector<char> m_left_bytes;
+	std::vector<char> m_right_bytes;
+
+	Entry left_total() const;
+	Entry right_total() const;
+	size_t byte_of(size_t index) const;
+	char byte_at(size_t offset) const;
+	void move_gap(size_t index);
+};
+
+#endif // TEXT_BUFFER_HPP
@@ -0,0 +1,184 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "text_layout.hpp"
+#include <algorithm>
+
+namespace
+{
+	// sf::Text pads every glyph quad by a pixel so smoothing has room
+	const float kGlyphPadding = 1.f;
+	const int kTabSpaces = 4;
+
+	bool is_whitespace(sf::Uint32 c)
+	{
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+}
+
+TextLayout::TextLayout(const GlyphSnapshot& glyphs)
+	: m_glyphs(glyphs)
+{
+}
+
+float TextLayout::get_advance(sf::Uint32 codepoint) const
+{
+	// Tabs are drawn as a run of spaces, as sf::Text does
+	if (codepoint == '\t')
+		return kTabSpaces * get_advance(' ');
+
+	const GlyphSnapshot::Metrics* metrics = m_glyphs.find(codepoint);
+	return metrics ? metrics->advance : 0.f;
+}
+
+bool TextLayout::find_missing(const sf::String& text, std::vector<sf::Uint32>& missing) const
+{
+	missing.clear();
+	for (size_t i = 0; i < text.getSize(); ++i)
+	{
+		sf::Uint32 c = text[i];
+		if (c >= 128 && !m_glyphs.find(c) && std::find(missing.begin(), missing.end(), c) == missing.end())
+			missing.push_back(c);
+	}
+	return missing.empty();
+}
+
+void TextLayout::wrap(const sf::String& text, float max_width, std::vector<size_t>& line_starts) const
+{
+	line_starts.clear();
+
+	size_t line_start = 0;
+	size_t last_space = sf::String::InvalidPos;
+	float line_width = 0.f;
+	float width_after_space = 0.f;
+	sf::Uint32 previous = 0;
+
+	for (size_t i = 0; i < text.getSize(); ++i)
+	{
+		sf::Uint32 c = text[i];
+
+		if (c == '\n')
+		{
+			line_start = i + 1;
+			line_starts.push_back(line_start);
+			last_space = sf::String::InvalidPos;
+			line_width = 0.f;
+			previous = 0;
+			continue;
+		}
+
+		float advance = get_advance(c) + m_glyphs.get_kerning(previous, c);
+		previous = c;
+
+		if (line_width + advance > max_width && i > line_start)
+		{
+			if (last_space != sf::String::InvalidPos)
+			{
+				// Carry the partial word over to the next line
+				line_start = last_space + 1;
+				line_width = line_width - width_after_space;
+			}
+			else
+			{
+				line_start = i;
+				line_width = 0.f;
+			}
+			line_starts.push_back(line_start);
+			last_space = sf::String::InvalidPos;
+		}
+
+		line_width += advance;
+
+		if (c == ' ' || c == '\t')
+		{
+			last_space = i;
+			width_after_space = line_width;
+		}
+	}
+}
+
+void TextLayout::shape(const sf::String& text, float max_width, const sf::Color& color, TextBlock& block) const
+{
+	std::vector<size_t> line_starts;
+	wrap(text, max_width, line_starts);
+
+	block.vertices.clear();
+	block.line_count = line_starts.size() + 1;
+	block.wrap_width = max_width;
+	block.color = color;
+
+	float line_height = m_glyphs.get_line_height();
+	float x = 0.f;
+	float y = static_cast<float>(m_glyphs.get_character_size());
+	sf::Uint32 previous = 0;
+	size_t next_break = 0;
+
+	for (size_t i = 0; i < text.getSize(); ++i)
+	{
+		sf::Uint32 c = text[i];
+
+		// Forced breaks start their line at the newline below instead
+		for (; next_break < line_starts.size() && line_starts[next_break] == i; ++next_break)
+		{
+			if (i == 0 || text[i - 1] != '\n')
+			{
+				x = 0.f;
+				y += line_height;
+				previous = 0;
+			}
+		}
+
+		x += m_glyphs.get_kerning(previous, c);
+		previous = c;
+
+		if (is_whitespace(c))
+		{
+			if (c == '\n')
+			{
+				x = 0.f;
+				y += line_height;
+			}
+			else if (c != '\r')
+			{
+				x += get_advance(c);
+			}
+			continue;
+		}
+
+		const GlyphSnapshot::Metrics* glyph = m_glyphs.find(c);
+		if (!glyph)
+			continue;
+
+		float left = x + glyph->bounds.left - kGlyphPadding;
+		float top = y + glyph->bounds.top - kGlyphPadding;
+		float right = x + glyph->bounds.left + glyph->bounds.width + kGlyphPadding;
+		float bottom = y + glyph->bounds.top + glyph->bounds.height + kGlyphPadding;
+
+		float u1 = glyph->texture_rect.left - kGlyphPadding;
+		float v1 = glyph->texture_rect.top - kGlyphPadding;
+		float u2 = glyph->texture_rect.left + glyph->texture_rect.width + kGlyphPadding;
+		float v2 = glyph->texture_rect.top + glyph->texture_rect.height + kGlyphPadding;
+
+		block.vertices.emplace_back(sf::Vector2f(left, top), color, sf::Vector2f(u1, v1));
+		block.vertices.emplace_back(sf::Vector2f(right, top), color, sf::Vector2f(u2, v1));
+		block.vertices.emplace_back(sf::Vector2f(left, bottom), color, sf::Vector2f(u1, v2));
+		block.vertices.emplace_back(sf::Vector2f(left, bottom), color, sf::Vector2f(u1, v2));
+		block.vertices.emplace_back(sf::Vector2f(right, top), color, sf::Vector2f(u2, v1));
+		block.vertices.emplace_back(sf::Vector2f(right, bottom), color, sf::Vector2f(u2, v2));
+
+		x += glyph->advance;
+	}
+}
@@ -0,0 +1,63 @@
+//  AcornUI
+//  Copyright (C) 2024 bruhmoent
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TEXT_LAYOUT_HPP
+#define TEXT_LAYOUT_HPP
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include "../ui-assets/glyph_snapshot.hpp"
+
+// Text laid out for drawing: two triangles per visible glyph, relative to
+// the top left corner, to be drawn with the snapshot's font texture.
+struct TextBlock
+{
+	std::vector<sf::Vertex> vertices;
+	size_t line_count = 1;
+	float wrap_width = 0.f;
+	sf::Color color = sf::Color::White;
+};
+
+// Breaks text into lines that fit a given width and builds its glyph quads,
+// the way sf::Text would place them, from a glyph snapshot rather than the
+// font. It keeps no state of its own, so any thread may use it.
+class TextLayout
+{
+public:
+	explicit TextLayout(const GlyphSnapshot& glyphs);
+
+	// Fills `missing` with the characters of `text` the snapshot lacks.
+	// Returns false if there are any.
+	bool find_missing(const sf::String& text, std::vector<sf::Uint32>& missing) const;
+
+	// Fills `line_starts` with the index of the first character of every
+	// wrapped line after the first. Breaks at the last space that fits,
+	// or mid-word when a single word is wider than `max_width`.
+	void wrap(const sf::String& text, float max_width, std::vector<size_t>& line_starts) const;
+
+	// Wraps `text` and builds its quads into `block`. Every character must
+	// be in the snapshot (see find_missing).
+	void shape(const sf::String& text, float max_width, const sf::Color& color, TextBlock& block) const;
+
+	float get_advance(sf::Uint32 codepoint) const;
+
+	float get_line_height() const { return m_glyphs.get_line_height(); }
+
+private:
+	const GlyphSnapshot& m_glyphs;
+};
+
+#endif // TEXT_LAYOUT_HPP
@@ -1,140 +1,880 @@
 #include "lime_chat.hpp"
+#include "log.hpp"
+#include "utf8.hpp"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
 #include <limits>
-#include <sstream>
-#include <unordered_set>
-#pragma comment(lib, "ws2_32.lib")
+#include <memory>
 
-LimeChat::LimeChat(const std::string& serverIp, int serverPort)
-    : serverIp(serverIp), serverPort(serverPort), running(true), authenticated(false) {
+namespace {
+    // Reads per wake-up, so one busy connection can't starve the others
+    const int kMaxReadsPerWake = 16;
+
+    // Attachment control lines start with one of these; they are only
+    // acted on once the whole line has arrived
+    const std::string_view kControlVerbs[] = { "FILE_OFFER|", "FILE_RESUME|", "FILE_CHUNK|", "FILE_DONE|" };
+    const size_t kMaxControlLine = 1024;
+
+    // A line cut by a read boundary is held until the rest arrives; one
+    // that never ends is let through in pieces past this size
+    const size_t kMaxPartialLine = 64 * 1024;
+
+    // True also for the start of a verb cut off by the end of the data
+    bool StartsControlLine(const char* data, size_t size) {
+        for (std::string_view verb : kControlVerbs) {
+            if (size > 0 && std::memcmp(data, verb.data(), std::min(size, verb.size())) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+LimeChat::LimeChat(const std::string& serverIp, int serverPort, const RetentionPolicy& retention, const TransportOptions& transportOptions,
+    const std::string& statePrefix)
+    : serverIp(serverIp), serverPort(serverPort), transportOptions(transportOptions), connected(false), running(true),
+    authenticated(false), historyRequested(false), loop(NetworkLoop::Shared()), started(false), newMessagesFlag(nullptr),
+    replaying(false), nextFrameId(1), chatMessages(retention), outbox(statePrefix + "_outbox"), atLineStart(true) {
     InitializeNetworking();
 }
 
 LimeChat::~LimeChat() {
-    running = false;
-    closesocket(clientSocket);
-    WSACleanup();
+    Stop();
+    transport.reset();
+    CleanupSockets();
 }
 
 void LimeChat::InitializeNetworking() {
-    WSADATA wsData;
-    WORD ver = MAKEWORD(2, 2);
-    int wsResult = WSAStartup(ver, &wsData);
-    if (wsResult != 0) {
-        std::cerr << "Can't start Winsock, Err #" << wsResult << std::endl;
+    if (!InitializeSockets()) {
         exit(1);
     }
+}
 
-    clientSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (clientSocket == INVALID_SOCKET) {
-        std::cerr << "Can't create socket, Err #" << WSAGetLastError() << std::endl;
-        WSACleanup();
-        exit(1);
+void LimeChat::Start(const std::string& username, const std::string& password, bool& newMessagesReceivedFlag) {
+    if (started || replayThread.joinable()) {
+        return;
     }
 
-    SOCKADDR_IN serverAddr;
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(serverPort);
-    inet_pton(AF_INET, serverIp.c_str(), &serverAddr.sin_addr);
+    this->username = username;
+    this->password = password;
+    newMessagesFlag = &newMessagesReceivedFlag;
+    started = true;
 
-    if (connect(clientSocket, (SOCKADDR*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
-        std::cerr << "Connect failed, Err #" << WSAGetLastError() << std::endl;
-        closesocket(clientSocket);
-        WSACleanup();
-        exit(1);
+    // Connecting and logging in happen on the loop's threads, so the caller
+    // is never blocked on the network
+    loop.Add(this);
+}
+
+void LimeChat::Stop() {
+    running = false;
+    Disconnect(); // Interrupts an upload in progress
+
+    // Once removed, no loop thread touches this session again
+    loop.Remove(this);
+    if (replayThread.joinable() && replayThread.get_id() != std::this_thread::get_id()) {
+        replayThread.join();
+    }
+}
+
+bool LimeChat::Connect() {
+    std::unique_ptr<Transport> newTransport = CreateTransport(transportOptions);
+    if (!newTransport) {
+        return false;
+    }
+
+    // Stop() clears running before it takes the lock, so either it sees
+    // this transport or this sees running cleared
+    {
+        std::lock_guard<std::mutex> lock(socketMutex);
+        connectingTransport = newTransport.get();
+    }
+    bool connectedNow = running && newTransport->Connect(serverIp, serverPort);
+
+    {
+        std::lock_guard<std::mutex> lock(socketMutex);
+        connectingTransport = nullptr;
+        if (!connectedNow || !running) {
+            return false;
+        }
+        transport = std::move(newTransport);
+        connected = true;
+    }
+    link.Reset();
+
+    LOG_INFO(Network) << "Connected to server!";
+    return true;
+}
+
+void LimeChat::Disconnect() {
+    std::lock_guard<std::mutex> lock(socketMutex);
+    if (transport) {
+        transport->Shutdown();
+    }
+    if (connectingTransport) {
+        connectingTransport->Shutdown();
+    }
+    connected = false;
+    authenticated = false;
+}
+
+bool LimeChat::ConnectAndLogIn() {
+    // The I/O thread has stopped reading the old transport, so it can go
+    {
+        std::lock_guard<std::mutex> lock(socketMutex);
+        transport.reset();
+    }
+    ResetFraming();
+
+    if (!Connect()) {
+        return false;
+    }
+    SendMessage("", username, password);
+    return true;
+}
+
+void LimeChat::OnDisconnected() {
+    Disconnect();
+    ResetFraming();
+}
+
+bool LimeChat::SendRaw(const std::string& data) {
+    std::lock_guard<std::mutex> lock(socketMutex);
+    if (!connected) {
+        return false;
+    }
+
+    if (!transport->SendAll(data.data(), data.size())) {
+        // The network loop notices and reconnects
+        transport->Shutdown();
+        connected = false;
+        return false;
+    }
+    return true;
+}
+
+void LimeChat::SendLine(const std::string& line, bool dropOnReconnect) {
+    uint64_t id = nextFrameId++;
+    QueueLine({ id, FrameLine(line, id), 0, dropOnReconnect }, false);
+}
+
+void LimeChat::QueueRaw(std::string data, bool dropOnReconnect, bool urgent) {
+    QueueLine({ nextFrameId++, { std::move(data) }, 0, dropOnReconnect }, urgent);
+}
+
+void LimeChat::QueueLine(QueuedLine line, bool urgent) {
+    {
+        // Receivers put fragments together by ID, so an urgent line may
+        // also go between the frames of one already started
+        std::lock_guard<std::mutex> lock(framesMutex);
+        if (urgent) {
+            queuedLines.push_front(std::move(line));
+        }
+        else {
+            queuedLines.push_back(std::move(line));
+        }
+    }
+    loop.QueueFrames(this);
+}
+
+void LimeChat::SendQueuedFrames() {
+    for (;;) {
+        // The frame is copied out, so nobody queueing waits on the write
+        std::string frame;
+        uint64_t lineId;
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(framesMutex);
+            // The rest waits for the next login; ResetFraming drops the
+            // lines that don't outlive the connection
+            if (queuedLines.empty() || !running || !authenticated) {
+                return;
+            }
+            const QueuedLine& line = queuedLines.front();
+            frame = line.frames[line.sent];
+            lineId = line.id;
+            generation = framesGeneration;
+        }
+
+        bool sent = SendRaw(frame);
+
+        std::lock_guard<std::mutex> lock(framesMutex);
+        if (!sent) {
+            return;
+        }
+        // Urgent lines may have been put in front of it meanwhile
+        auto it = std::find_if(queuedLines.begin(), queuedLines.end(), [lineId](const QueuedLine& line) {
+            return line.id == lineId;
+            });
+        if (generation == framesGeneration && it != queuedLines.end() && ++it->sent == it->frames.size()) {
+            queuedLines.erase(it);
+        }
     }
+}
 
-    std::cout << "Connected to server!" << std::endl;
+void LimeChat::ReplayOutbox() {
+    std::vector<Outbox::Entry> unsent = outbox.Pending();
+    if (unsent.empty()) {
+        return;
+    }
 
-    SendCredentials();
+    // Queued back to back; the ACKs stream back as the server works through
+    // them
+    for (const auto& entry : unsent) {
+        SendLine(EscapeBody(entry.content) + "|" + username + "|" + password + "|" + std::to_string(entry.clientId), true);
+    }
+    LOG_INFO(Protocol) << "Resending " << unsent.size() << " unacknowledged message(s)";
 }
 
-void LimeChat::SendCredentials() {
+bool LimeChat::SendAttachment(const std::string& path) {
+    std::string offer = transfers.AddUpload(path);
+    if (offer.empty()) {
+        return false;
+    }
+
+    // Before login the offer goes out with the others once authenticated
+    if (authenticated) {
+        QueueRaw(offer, true);
+    }
+    return true;
+}
+
+bool LimeChat::AcceptDownload(uint64_t transferId) {
+    if (!transfers.AcceptDownload(transferId)) {
+        return false;
+    }
+
+    // Dropped if the connection goes; the sender repeats the offer after
+    // the reconnect and the download resumes then
+    std::string replies = transfers.TakeReplies();
+    if (!replies.empty()) {
+        QueueRaw(std::move(replies), true);
+    }
+    return true;
+}
+
+bool LimeChat::UploadChunk(uint64_t transferId, uint64_t& offset) {
+    // The loop queues the next chunk behind other work, so chat lines and
+    // other sessions' uploads go out between chunks
+    if (!running) {
+        return false;
+    }
+    return transfers.UploadChunk(transferId, offset, [this](const std::string& header, const AttachmentFile& file, uint64_t chunkOffset, size_t length) {
+        return SendChunk(header, file, chunkOffset, length);
+        });
+}
+
+bool LimeChat::SendChunk(const std::string& header, const AttachmentFile& file, uint64_t offset, size_t length) {
+    std::lock_guard<std::mutex> lock(socketMutex);
+    if (!connected || !authenticated) {
+        return false;
+    }
+
+    if (!transport->SendAll(header.data(), header.size()) || !transport->SendFile(file, offset, length)) {
+        transport->Shutdown();
+        connected = false;
+        return false;
+    }
+    return true;
+}
+
+void LimeChat::Heartbeat() {
+    if (!authenticated) {
+        return;
+    }
+
+    // A half-open connection never fails a read; dropping it here makes the
+    // loop reconnect. Shutdown() needs no lock, so an upload stuck sending
+    // on the dead link can't hold this up.
+    if (link.IsDead(transportOptions.heartbeatTimeoutMs)) {
+        LOG_WARNING(Network) << "No reply from " << serverIp << " in " << transportOptions.heartbeatTimeoutMs << " ms, reconnecting";
+        transport->Shutdown();
+        connected = false;
+        authenticated = false;
+        return;
+    }
+
+    // Ahead of the queue, so it only waits for the frame or chunk going out
+    QueueRaw(link.MakePing(), true, true);
+}
+
+void LimeChat::PromptCredentials() {
     std::cout << "Enter username: ";
     std::getline(std::cin, username);
     std::cout << "Enter password: ";
     std::getline(std::cin, password);
-
-    SendMessage("", username, password);
 }
 
 void LimeChat::RequestPastMessages(int channelId) {
     // Send a request to the server to retrieve past messages for the channel
     std::string request = "GET_PAST_MESSAGES|" + std::to_string(channelId) + "\n";
-    send(clientSocket, request.c_str(), request.size(), 0);
+    QueueRaw(std::move(request), false);
 }
 
-void LimeChat::HandleIncomingMessages(bool& newMessagesReceivedFlag) {
-    char buffer[4096];
-    int bytesReceived;
+void LimeChat::IngestBytes(const char* data, size_t size) {
+    // Attachment chunks are raw bytes between the text lines. They are
+    // written to their file as they arrive and never reach the text path.
+    while (size > 0) {
+        size_t used;
+        if (transfers.inChunk()) {
+            used = transfers.ReceiveChunkBytes(data, size);
+            atLineStart = true;
+        }
+        else if (!controlLine.empty() || (atLineStart && StartsControlLine(data, size))) {
+            used = IngestControlLine(data, size);
+        }
+        else {
+            // Text runs up to the next line that may be a control line
+            used = size;
+            for (const char* newline = static_cast<const char*>(std::memchr(data, '\n', size)); newline;
+                newline = static_cast<const char*>(std::memchr(newline + 1, '\n', data + size - newline - 1))) {
+                size_t next = static_cast<size_t>(newline - data) + 1;
+                if (next == size || StartsControlLine(data + next, size - next)) {
+                    used = next;
+                    break;
+                }
+            }
+            IngestText(data, used);
+            atLineStart = data[used - 1] == '\n';
+        }
+        data += used;
+        size -= used;
+    }
 
-    while (running) {
-        ZeroMemory(buffer, 4096);
-        bytesReceived = recv(clientSocket, buffer, 4096, 0);
+    std::string replies = transfers.TakeReplies();
+    if (!replies.empty()) {
+        QueueRaw(std::move(replies), true);
+    }
+}
 
-        if (bytesReceived > 0) {
-            std::string message(buffer, bytesReceived);
-            std::cout << "Received message from server: " << message << std::endl;
+size_t LimeChat::IngestControlLine(const char* data, size_t size) {
+    // Control lines are collected whole, as a chunk header cut in two by a
+    // read boundary would otherwise lose the chunk that follows it
+    const char* newline = static_cast<const char*>(std::memchr(data, '\n', size));
+    size_t used = newline ? static_cast<size_t>(newline - data) + 1 : size;
+    controlLine.append(data, used);
+    if (!newline && controlLine.size() < kMaxControlLine) {
+        return used;
+    }
+
+    std::string_view line(controlLine);
+    if (newline) {
+        line.remove_suffix(1);
+    }
+    // A line that only looks like a chunk header is chat text
+    if (line.compare(0, 11, "FILE_CHUNK|") != 0 || !transfers.BeginChunk(line)) {
+        IngestText(controlLine.data(), controlLine.size());
+    }
+    controlLine.clear();
+    atLineStart = newline != nullptr;
+    return used;
+}
+
+void LimeChat::ResetFraming() {
+    pendingBytes.clear();
+    controlLine.clear();
+    atLineStart = true;
+    transfers.AbortChunk();
+    fragments.Clear();
+
+    std::lock_guard<std::mutex> lock(framesMutex);
+    framesGeneration++;
+    queuedLines.erase(std::remove_if(queuedLines.begin(), queuedLines.end(), [](const QueuedLine& line) {
+        return line.dropOnReconnect;
+        }), queuedLines.end());
+    // A line cut off part way is sent again from its first frame
+    for (QueuedLine& line : queuedLines) {
+        line.sent = 0;
+    }
+}
 
-            ProcessMessage(message);
-            newMessagesReceivedFlag = true;
+void LimeChat::IngestText(const char* data, size_t size) {
+    // A line split across two reads is finished by the next one, so only
+    // whole lines go on. The buffer is reused across reads, so it stops
+    // allocating once warm.
+    std::string& message = receiveBuffer;
+    message.assign(pendingBytes);
+    message.append(data, size);
+    size_t complete = message.rfind('\n') + 1; // 0 when there is no newline
+    if (message.size() - complete > kMaxPartialLine) {
+        complete = message.size() - utf8::IncompleteTail(message.data(), message.size());
+    }
+    pendingBytes.assign(message, complete, std::string::npos);
+    message.resize(complete);
+    if (message.empty()) {
+        return;
+    }
+
+    // Validate once here so everything downstream can trust the text is UTF-8
+    utf8::Sanitize(message);
+    LOG_DEBUG(Protocol) << "Received message from server: " << message;
+
+    ProcessMessage(message);
+}
+
+bool LimeChat::StartCapture(const std::string& path) {
+    if (!capture.Open(path)) {
+        return false;
+    }
+    LOG_INFO(General) << "Capturing inbound traffic to " << path;
+    return true;
+}
+
+bool LimeChat::StartReplay(const std::string& path, double speed, bool& newMessagesReceivedFlag) {
+    if (started || replayThread.joinable()) {
+        return false;
+    }
+
+    auto reader = std::make_shared<CaptureReader>();
+    if (!reader->Open(path)) {
+        return false;
+    }
+
+    replaying = true;
+    replayThread = std::thread([this, reader, speed, &newMessagesReceivedFlag] {
+        ReplayCapture(*reader, speed, newMessagesReceivedFlag);
+        });
+    return true;
+}
+
+void LimeChat::ReplayCapture(CaptureReader& reader, double speed, bool& newMessagesReceivedFlag) {
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    CaptureReader::Chunk chunk;
+    size_t chunks = 0;
+    size_t bytes = 0;
+
+    // Chunks go through the same ingest as live traffic, only the socket is
+    // replaced. Speed 0 replays as fast as the client can take it.
+    while (running && reader.Next(chunk)) {
+        if (speed > 0) {
+            auto due = start + std::chrono::microseconds(static_cast<long long>(chunk.offsetUs / speed));
+            std::this_thread::sleep_until(due);
+        }
+
+        IngestBytes(chunk.bytes.data(), chunk.bytes.size());
+        newMessagesReceivedFlag = true;
+        chunks++;
+        bytes += chunk.bytes.size();
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << "Replayed " << chunks << " chunks (" << bytes << " bytes, " << getChatMessageCount()
+        << " messages stored) in " << seconds << " s" << std::endl;
+    replaying = false;
+}
+
+bool LimeChat::ReadAvailable(char* buffer, size_t size) {
+    for (int reads = 0; reads < kMaxReadsPerWake; ++reads) {
+        int bytesReceived = transport->TryReceive(buffer, size);
+
+        if (bytesReceived > 0) {
+            link.OnReceive();
+            if (capture.isOpen()) {
+                capture.Record(buffer, static_cast<size_t>(bytesReceived));
+            }
+            IngestBytes(buffer, static_cast<size_t>(bytesReceived));
+            *newMessagesFlag = true;
+        }
+        else if (bytesReceived == Transport::kWouldBlock) {
+            return true;
         }
         else if (bytesReceived == 0) {
-            std::cout << "Server disconnected" << std::endl;
-            break;
+            LOG_INFO(Network) << "Server " << serverIp << " disconnected, reconnecting";
+            return false;
         }
         else {
-            std::cerr << "Error in recv(). Quitting" << std::endl;
-            break;
+            if (running) {
+                LOG_WARNING(Network) << "Error reading from " << serverIp << ", reconnecting";
+            }
+            return false;
         }
     }
+    return true;
+}
+
+void LimeChat::ProcessMessage(std::string_view message) {
+    while (!message.empty()) {
+        size_t end = message.find('\n');
+        std::string_view line = message.substr(0, end);
+        message.remove_prefix(end == std::string_view::npos ? message.size() : end + 1);
 
-    newMessagesReceivedFlag = false;
+        // A reassembled line is never taken for a fragment itself
+        if (!IsFragment(line)) {
+            ProcessLine(line);
+        }
+        else if (fragments.Add(line, assembledLine)) {
+            ProcessLine(assembledLine);
+        }
+    }
 }
 
+bool LimeChat::ProcessTransferLine(std::string_view line) {
+    if (line.compare(0, 11, "FILE_OFFER|") == 0) {
+        return transfers.AcceptOffer(line);
+    }
+    if (line.compare(0, 10, "FILE_DONE|") == 0) {
+        return transfers.ConfirmUpload(line);
+    }
+    if (line.compare(0, 12, "FILE_RESUME|") == 0) {
+        uint64_t transferId = 0;
+        uint64_t offset = 0;
+        const char* end = line.data() + line.size();
+        auto parsed = std::from_chars(line.data() + 12, end, transferId);
+        if (parsed.ec != std::errc() || parsed.ptr == end || *parsed.ptr != '|') {
+            return false;
+        }
+        parsed = std::from_chars(parsed.ptr + 1, end, offset);
+        if (parsed.ec != std::errc() || parsed.ptr != end) {
+            return false;
+        }
+        loop.QueueUpload(this, transferId, offset);
+        return true;
+    }
+    return false;
+}
 
-void LimeChat::ProcessMessage(const std::string& message) {
-    std::istringstream iss(message);
-    std::string line;
+void LimeChat::ProcessLine(std::string_view line) {
+    // Transfer lines that don't parse are shown as chat like any other
+    if (line.compare(0, 5, "FILE_") == 0 && ProcessTransferLine(line)) {
+        return;
+    }
 
-    while (std::getline(iss, line)) {
-        if (line == "Authentication successful") {
-            authenticated = true;
+    if (line == "Authentication successful") {
+        // Lines kept from the last connection follow what this login sends.
+        // Nothing is sent before `authenticated` is set, so none of them is
+        // in flight.
+        std::deque<QueuedLine> kept;
+        {
+            std::lock_guard<std::mutex> lock(framesMutex);
+            kept.swap(queuedLines);
+        }
+        authenticated = true;
+        // Everyone present follows, as presence lines
+        members.Clear();
+        // History only needs fetching once; after a reconnect the store
+        // already has it
+        if (!historyRequested) {
+            historyRequested = true;
             RequestPastMessages(1);
         }
-        else if (line == "Welcome to the chat server!") {
-            std::cout << line << std::endl;
+        ReplayOutbox();
+
+        // Unfinished uploads are offered again; the server answers with
+        // how far it got and they continue from there
+        loop.ClearUploads(this);
+        std::string offers = transfers.PendingOffers();
+        if (!offers.empty()) {
+            QueueRaw(std::move(offers), true);
         }
-        else if (line.find("GET_PAST_MESSAGES|") != std::string::npos) {
-            ProcessPastMessages(line);
+
+        {
+            std::lock_guard<std::mutex> lock(framesMutex);
+            queuedLines.insert(queuedLines.end(), std::make_move_iterator(kept.begin()), std::make_move_iterator(kept.end()));
         }
-        else {
-            ProcessRegularMessage(line);
+        loop.QueueFrames(this);
+    }
+    else if (line.compare(0, 5, "PONG|") == 0) {
+        link.OnPong(line);
+    }
+    else if (line.compare(0, 5, "PING|") == 0) {
+        std::string pong = LinkHealth::MakePong(line);
+        if (!pong.empty()) {
+            QueueRaw(std::move(pong), true, true);
         }
     }
+    else if (line.compare(0, 4, "ACK|") == 0) {
+        ProcessAck(line);
+    }
+    else if (line.compare(0, 5, "EDIT|") == 0 || line.compare(0, 7, "DELETE|") == 0) {
+        ProcessEdit(line);
+    }
+    else if (line.compare(0, 9, "PRESENCE|") == 0) {
+        ProcessPresence(line);
+    }
+    else if (line.compare(0, 12, "EDIT_DENIED|") == 0) {
+        LOG_WARNING(Protocol) << "Server refused to change message " << line.substr(12);
+    }
+    else if (line == "Welcome to the chat server!") {
+        LOG_INFO(Protocol) << line;
+    }
+    else if (line.find("GET_PAST_MESSAGES|") != std::string_view::npos) {
+        ProcessPastMessages(line);
+    }
+    else {
+        ProcessRegularMessage(line);
+    }
 }
 
-void LimeChat::ProcessPastMessages(const std::string& message) {
+void LimeChat::ProcessPastMessages(std::string_view message) {
     // Extract channel ID from the message
     size_t pos = message.find('|');
-    if (pos != std::string::npos) {
-        int channelId = std::stoi(message.substr(pos + 1));
-        RequestPastMessages(channelId);
+    if (pos != std::string_view::npos) {
+        int channelId = 0;
+        const char* first = message.data() + pos + 1;
+        if (std::from_chars(first, message.data() + message.size(), channelId).ec == std::errc()) {
+            RequestPastMessages(channelId);
+        }
     }
 }
 
-void LimeChat::ProcessRegularMessage(const std::string& message) {
-    if (!message.empty()) {
-        chatMessages.push_back(message);
+void LimeChat::ProcessRegularMessage(std::string_view message) {
+    if (message.empty()) {
+        return;
+    }
+
+    Message parsed;
+    std::string_view user;
+    if (ParseMessageLine(message, parsed, user)) {
+        parsed.userId = users.Intern(user);
+        link.OnMessageTimestamp(parsed.timestampMs);
     }
+    else {
+        // Legacy servers send "content|..." with no metadata
+        parsed.timestampMs = link.ServerTimeMs();
+        parsed.body = message.substr(0, message.find('|'));
+    }
+    if (UnescapeBody(parsed.body, unescapeBuffer)) {
+        parsed.body = unescapeBuffer;
+    }
+    StoreMessage(parsed);
+}
+
+// "ACK|clientId" from older servers, "ACK|clientId|channel|id" when the
+// server also says which ID it gave the message.
+void LimeChat::ProcessAck(std::string_view line) {
+    const char* end = line.data() + line.size();
+    uint64_t clientId = 0;
+    uint32_t channel = 0;
+    uint64_t id = 0;
+    auto parsed = std::from_chars(line.data() + 4, end, clientId);
+    outbox.Acknowledge(clientId);
+    if (parsed.ptr == end || *parsed.ptr != '|') {
+        return;
+    }
+    parsed = std::from_chars(parsed.ptr + 1, end, channel);
+    if (parsed.ptr == end || *parsed.ptr != '|' || std::from_chars(parsed.ptr + 1, end, id).ec != std::errc()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(chatMessagesMutex);
+    auto local = localByClientId.find(clientId);
+    if (local == localByClientId.end()) {
+        return;
+    }
+    size_t index = local->second;
+    localByClientId.erase(local);
+    if (index < chatMessages.residentBegin()) {
+        return;
+    }
+
+    // Same size, so this patches the header where it is
+    Message message = DecodeMessage(chatMessages.At(index));
+    message.id = id;
+    message.channel = channel;
+    ReplaceStoredMessage(index, message);
+    indexById[{ channel, id }] = index;
+}
+
+// "EDIT|channel|id|body" or "DELETE|channel|id", sent to every client once
+// the server has stored the change.
+void LimeChat::ProcessEdit(std::string_view line) {
+    bool deleted = line[0] == 'D';
+    std::string_view rest = line.substr(deleted ? 7 : 5);
+    const char* end = rest.data() + rest.size();
+    uint32_t channel = 0;
+    uint64_t id = 0;
+    auto parsed = std::from_chars(rest.data(), end, channel);
+    if (parsed.ptr == end || *parsed.ptr != '|') {
+        return;
+    }
+    parsed = std::from_chars(parsed.ptr + 1, end, id);
+    if (parsed.ec != std::errc()) {
+        return;
+    }
+    std::string_view body;
+    if (!deleted) {
+        if (parsed.ptr == end || *parsed.ptr != '|') {
+            return;
+        }
+        body = rest.substr(static_cast<size_t>(parsed.ptr + 1 - rest.data()));
+        if (UnescapeBody(body, unescapeBuffer)) {
+            body = unescapeBuffer;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(chatMessagesMutex);
+    auto it = indexById.find({ channel, id });
+    if (it == indexById.end()) {
+        return; // Not loaded here; history will come with the change applied
+    }
+    size_t index = it->second;
+    // The body is copied: the replacement may be written over it
+    Message message = DecodeMessage(chatMessages.At(index));
+    std::string newBody(body);
+    message.body = newBody;
+    message.flags |= deleted ? kMessageDeleted : kMessageEdited;
+    ReplaceStoredMessage(index, message);
+    changedMessages.push_back(index);
+}
+
+// "PRESENCE|user|online", "away" or "offline"; the user name has no '|'.
+void LimeChat::ProcessPresence(std::string_view line) {
+    std::string_view rest = line.substr(9);
+    size_t bar = rest.rfind('|');
+    MemberStatus status;
+    if (bar == std::string_view::npos || bar == 0 || !MemberList::ParseStatus(rest.substr(bar + 1), status)) {
+        return;
+    }
+    members.Apply(rest.substr(0, bar), status);
+}
+
+bool LimeChat::SetPresence(MemberStatus status) {
+    if (!authenticated || status == MemberStatus::Offline) {
+        return false;
+    }
+    SendLine(std::string("STATUS|") + MemberList::StatusName(status));
+    return true;
+}
+
+size_t LimeChat::AddLocalMessage(const std::string& message) {
+    Message local;
+    // On the server's clock, so it sorts and displays with the others
+    local.timestampMs = link.ServerTimeMs();
+    local.userId = users.Intern(username);
+    local.body = message;
+    return StoreMessage(local);
+}
+
+size_t LimeChat::StoreMessage(const Message& message) {
+    std::lock_guard<std::mutex> lock(chatMessagesMutex);
+    EncodeMessage(message, encodeBuffer);
+    size_t index = chatMessages.Append(encodeBuffer);
+    searchIndex.Add(index, message.body);
+    if (message.id != 0) {
+        indexById[{ message.channel, message.id }] = index;
+    }
+    return index;
+}
+
+// Callers hold chatMessagesMutex.
+void LimeChat::ReplaceStoredMessage(size_t index, const Message& message) {
+    EncodeMessage(message, encodeBuffer);
+    chatMessages.Replace(index, encodeBuffer);
+}
+
+bool LimeChat::ServerIdOf(size_t index, uint32_t& channel, uint64_t& id) {
+    std::lock_guard<std::mutex> lock(chatMessagesMutex);
+    if (index >= chatMessages.size()) {
+        return false;
+    }
+    Message message = DecodeMessage(chatMessages.At(index));
+    if (message.id == 0 || (message.flags & kMessageDeleted)) {
+        return false;
+    }
+    channel = message.channel;
+    id = message.id;
+    return true;
+}
+
+bool LimeChat::EditMessage(size_t index, const std::string& content) {
+    uint32_t channel = 0;
+    uint64_t id = 0;
+    if (!authenticated || content.empty() || !ServerIdOf(index, channel, id)) {
+        return false;
+    }
+    SendLine("EDIT|" + std::to_string(channel) + "|" + std::to_string(id) + "|" + EscapeBody(content));
+    return true;
+}
+
+bool LimeChat::DeleteMessage(size_t index) {
+    uint32_t channel = 0;
+    uint64_t id = 0;
+    if (!authenticated || !ServerIdOf(index, channel, id)) {
+        return false;
+    }
+    SendLine("DELETE|" + std::to_string(channel) + "|" + std::to_string(id));
+    return true;
+}
+
+std::vector<size_t> LimeChat::TakeChangedMessages() {
+    std::lock_guard<std::mutex> lock(chatMessagesMutex);
+    std::vector<size_t> changed;
+    changed.swap(changedMessages);
+    return changed;
+}
+
+size_t LimeChat::FindLastOwnMessage() {
+    uint32_t own = users.Intern(username);
+    std::lock_guard<std::mutex> lock(chatMessagesMutex);
+    for (size_t i = chatMessages.size(); i > chatMessages.residentBegin(); --i) {
+        Message message = DecodeMessage(chatMessages.At(i - 1));
+        if (message.userId == own && !(message.flags & kMessageDeleted)) {
+            return i - 1;
+        }
+    }
+    return std::string::npos;
+}
+
+std::vector<uint64_t> LimeChat::SearchMessages(const std::string& query, size_t limit) {
+    std::lock_guard<std::mutex> lock(chatMessagesMutex);
+    // The index keeps a message's original words; deleted ones are left
+    // out here rather than taken out of the posting lists
+    std::vector<uint64_t> hits = searchIndex.Find(query, limit, [this](uint64_t id) {
+        return std::string(DecodeMessage(chatMessages.At(static_cast<size_t>(id))).body);
+        });
+    hits.erase(std::remove_if(hits.begin(), hits.end(), [this](uint64_t id) {
+        return (DecodeMessage(chatMessages.At(static_cast<size_t>(id))).flags & kMessageDeleted) != 0;
+        }), hits.end());
+    return hits;
+}
+
+std::vector<std::string> LimeChat::getChatMessages(size_t first, size_t count) {
+    std::vector<std::string> bodies;
+    VisitChatMessages(first, count, [&bodies](const Message& message) {
+        bodies.emplace_back(message.body);
+        });
+    return bodies;
+}
+
+void LimeChat::VisitChatMessages(size_t first, size_t count, const std::function<void(const Message&)>& visit) {
+    std::lock_guard<std::mutex> lock(chatMessagesMutex);
+    size_t last = std::min(chatMessages.size(), first + count);
+    for (size_t i = first; i < last; ++i) {
+        visit(DecodeMessage(chatMessages.At(i)));
+    }
+}
+
+size_t LimeChat::getChatMessageCount() const {
+    std::lock_guard<std::mutex> lock(chatMessagesMutex);
+    return chatMessages.size();
 }
 
 void LimeChat::SendMessage(const std::string& messageContent, const std::string& username, const std::string& password) {
-    std::string message = messageContent + "|" + username + "|" + password + "\n";
-    send(clientSocket, message.c_str(), message.size(), 0);
+    if (messageContent.empty()) {
+        SendRaw("|" + username + "|" + password + "\n");
+        return;
+    }
+
+    // Journaled first, so it is replayed after a reconnect if this send is
+    // lost or never acknowledged
+    uint64_t clientId = outbox.Add(messageContent);
+    // Shown right away and given its server ID by the ACK, which may come
+    // back before this returns
+    size_t index = AddLocalMessage(messageContent);
+    {
+        std::lock_guard<std::mutex> lock(chatMessagesMutex);
+        localByClientId[clientId] = index;
+    }
+    if (authenticated) {
+        SendLine(EscapeBody(messageContent) + "|" + username + "|" + password + "|" + std::to_string(clientId), true);
+    }
 }
 
 void LimeChat::Run(bool& newMessagesReceivedFlag) {
-    std::thread receiveThread(&LimeChat::HandleIncomingMessages, this, std::ref(newMessagesReceivedFlag));
+    PromptCredentials();
+    Start(username, password, newMessagesReceivedFlag);
 
     std::string userInput;
 
@@ -150,16 +890,10 @@ void LimeChat::Run(bool& newMessagesReceivedFlag) {
             running = false;
         }
         else {
-            // If authenticated, send the user input to the server as a message
-            if (authenticated) {
-                SendMessage(userInput, username, password);
-            }
-            else {
-                // If not authenticated, re-send the credentials
-                SendMessage("Please authenticate again", username, password);
-            }
+            // Queued in the outbox until the server has accepted the login
+            SendMessage(userInput, username, password);
         }
     }
 
-    receiveThread.join();
+    Stop();
 }
\ No newline at end of file
@@ -1,44 +1,212 @@
 #ifndef LIME_CHAT_HPP
 #define LIME_CHAT_HPP
 
-#include <ws2tcpip.h>
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
+#include "file_transfer.hpp"
+#include "fragment.hpp"
+#include "link_health.hpp"
+#include "member_list.hpp"
+#include "message.hpp"
+#include "network_loop.hpp"
+#include "outbox.hpp"
+#include "scrollback.hpp"
+#include "search_index.hpp"
+#include "traffic_capture.hpp"
+#include "transport.hpp"
 
+// One account on one server. Sessions don't own threads: all of them are
+// read, kept alive and reconnected by the shared NetworkLoop.
 class LimeChat {
+    friend class NetworkLoop;
+
 private:
     std::string serverIp;
     int serverPort;
-    SOCKET clientSocket;
-    bool running;
-    bool authenticated;
+    TransportOptions transportOptions;
+    std::unique_ptr<Transport> transport;
+    Transport* connectingTransport = nullptr; // So Stop() can cut a connect short
+    std::mutex socketMutex;
+    std::atomic<bool> connected;
+    std::atomic<bool> running;
+    std::atomic<bool> authenticated;
+    bool historyRequested;
+    NetworkLoop& loop;
+    bool started;
+    bool* newMessagesFlag;
+    std::thread replayThread;
+    CaptureWriter capture;
+    std::atomic<bool> replaying;
     std::string username;
     std::string password;
-    std::vector<std::string> chatMessages;
+    std::string pendingBytes;
+    std::string receiveBuffer;
+    std::string encodeBuffer;
+    std::string unescapeBuffer;
+    FragmentAssembler fragments;
+    std::string assembledLine;
+    // A protocol line left for the loop's upload thread to send a frame at
+    // a time.
+    struct QueuedLine {
+        uint64_t id;
+        std::vector<std::string> frames;
+        size_t sent = 0;
+        // Chat messages are resent by the outbox and pings go stale, so they
+        // are dropped with the connection; other lines go again, whole,
+        // after the next login
+        bool dropOnReconnect = false;
+    };
+    // Everything sent after the login goes through here and out on the
+    // loop's upload thread, so neither the GUI nor the I/O thread ever waits
+    // on a socket write. framesMutex is never held across one.
+    std::mutex framesMutex;
+    std::deque<QueuedLine> queuedLines;
+    // Bumped by ResetFraming, so a frame in flight across it isn't counted
+    uint64_t framesGeneration = 0;
+    std::atomic<uint64_t> nextFrameId;
+    Scrollback chatMessages;
+    SearchIndex searchIndex;
+    UserTable users;
+    MemberList members;
+    Outbox outbox;
+    FileTransfers transfers;
+    std::string controlLine;
+    bool atLineStart;
+    LinkHealth link;
+    mutable std::mutex chatMessagesMutex;
+    struct MessageKeyHash {
+        size_t operator()(const std::pair<uint32_t, uint64_t>& key) const {
+            return std::hash<uint64_t>()(key.second * 0x9E3779B97F4A7C15ull ^ key.first);
+        }
+    };
+    // Store index of every message by channel and server ID, so an edit
+    // patches the one message instead of reloading history
+    std::unordered_map<std::pair<uint32_t, uint64_t>, size_t, MessageKeyHash> indexById;
+    // Own messages waiting for the ACK that tells their server ID
+    std::unordered_map<uint64_t, size_t> localByClientId;
+    std::vector<size_t> changedMessages;
     void InitializeNetworking();
-    void SendCredentials();
+    bool Connect();
+    void Disconnect();
+    // Writes to the socket right away; only for the login and the upload
+    // thread.
+    bool SendRaw(const std::string& data);
+    // Queues one protocol line (without its newline), fragmented if it is
+    // longer than a frame.
+    void SendLine(const std::string& line, bool dropOnReconnect = false);
+    // Queues whole lines, newlines included, as one frame; `urgent` ones go
+    // ahead of everything not yet started.
+    void QueueRaw(std::string data, bool dropOnReconnect, bool urgent = false);
+    void QueueLine(QueuedLine line, bool urgent);
+    void ReplayOutbox();
+    bool SendChunk(const std::string& header, const AttachmentFile& file, uint64_t offset, size_t length);
+    void ResetFraming();
+    void PromptCredentials();
     void RequestPastMessages(int channelId);
-    void ProcessMessage(const std::string& message);
-    void ProcessPastMessages(const std::string& message);
-    void ProcessRegularMessage(const std::string& message);
+    void IngestBytes(const char* data, size_t size);
+    void IngestText(const char* data, size_t size);
+    size_t IngestControlLine(const char* data, size_t size);
+    void ReplayCapture(CaptureReader& reader, double speed, bool& newMessagesReceivedFlag);
+    void ProcessMessage(std::string_view message);
+    void ProcessLine(std::string_view line);
+    // Acts on a FILE_ line; false if it isn't a well-formed one.
+    bool ProcessTransferLine(std::string_view line);
+    void ProcessPastMessages(std::string_view message);
+    void ProcessRegularMessage(std::string_view message);
+    void ProcessAck(std::string_view line);
+    void ProcessEdit(std::string_view line);
+    void ProcessPresence(std::string_view line);
+    size_t StoreMessage(const Message& message);
+    void ReplaceStoredMessage(size_t index, const Message& message);
+    bool ServerIdOf(size_t index, uint32_t& channel, uint64_t& id);
+
+    // Called by the NetworkLoop's threads
+    bool ConnectAndLogIn();
+    // Reads what the socket has ready; false once the connection is gone.
+    bool ReadAvailable(char* buffer, size_t size);
+    void OnDisconnected();
+    void Heartbeat();
+    // Sends one chunk and moves `offset` past it; true while more is left.
+    bool UploadChunk(uint64_t transferId, uint64_t& offset);
+    void SendQueuedFrames();
+    int heartbeatIntervalMs() const { return transportOptions.heartbeatIntervalMs; }
+    SOCKET PollHandle() const { return transport->PollHandle(); }
+    bool HasBufferedData() const { return transport->HasBufferedData(); }
 
 public:
-    LimeChat(const std::string& serverIp, int serverPort);
+    // Files the session keeps between runs (the outbox journal) are named
+    // after `statePrefix`; sessions running side by side need different ones.
+    LimeChat(const std::string& serverIp, int serverPort, const RetentionPolicy& retention = RetentionPolicy(),
+        const TransportOptions& transportOptions = TransportOptions(), const std::string& statePrefix = "limechat");
     ~LimeChat();
+    // Console client: asks for credentials on stdin, then reads messages
+    // from it until "/quit"
     void Run(bool& newMessagesReceivedFlag);
+    // Connects and logs in in the background and keeps the connection up
+    // until Stop(). Returns immediately.
+    void Start(const std::string& username, const std::string& password, bool& newMessagesReceivedFlag);
+    void Stop();
+    // Records every inbound chunk, as received, to a capture file. Call
+    // before Start().
+    bool StartCapture(const std::string& path);
+    // Feeds a capture through the normal ingest path instead of connecting.
+    // `speed` scales the recorded timing; 0 replays as fast as possible.
+    bool StartReplay(const std::string& path, double speed, bool& newMessagesReceivedFlag);
+    bool isReplaying() const { return replaying; }
     bool isRunning() const { return running; }
     bool isAuthenticated() const { return authenticated; }
+    bool isConnected() const { return connected; }
+    size_t getUnsentCount() const { return outbox.size(); }
+    LinkHealth::Stats getLinkStats() const { return link.stats(); }
     std::string getUsername() const { return username; }
     std::string getPassword() const { return password; }    
-    std::vector<std::string> getChatMessages() const {
-        return chatMessages;
-    }
-    void Stop() {
-        running = false;
-    }
-    void HandleIncomingMessages(bool& newMessagesReceivedFlag);
+    // Message bodies only
+    std::vector<std::string> getChatMessages(size_t first, size_t count);
+    // Calls `visit` with each stored message in order, without copying them.
+    // The bodies are only valid inside the callback.
+    void VisitChatMessages(size_t first, size_t count, const std::function<void(const Message&)>& visit);
+    std::string_view getUserName(uint32_t userId) const { return users.Name(userId); }
+    size_t getChatMessageCount() const;
+    // Returns the message's index in the store.
+    size_t AddLocalMessage(const std::string& message);
+    std::vector<uint64_t> SearchMessages(const std::string& query, size_t limit);
+    // Chat messages are stored locally, then go through the outbox and are
+    // delivered once the server acknowledges them; an empty message is a
+    // login and is sent directly.
     void SendMessage(const std::string& messageContent, const std::string& username, const std::string& password);
+    // Ask the server to change or remove stored message `index`. The store
+    // only changes when the server sends the edit back to every client.
+    // False if the message has no server ID (yet) or the session is offline.
+    bool EditMessage(size_t index, const std::string& content);
+    bool DeleteMessage(size_t index);
+    // Store indexes of the messages edited or deleted since the last call.
+    std::vector<size_t> TakeChangedMessages();
+    // The newest message this account sent that is still resident, or
+    // npos if there is none.
+    size_t FindLastOwnMessage();
+    // Offers the file to the server and streams it once accepted, without
+    // holding up chat lines. Returns false if the file can't be opened.
+    bool SendAttachment(const std::string& path);
+    void SetTransferProgressCallback(FileTransfers::ProgressCallback callback) { transfers.SetProgressCallback(std::move(callback)); }
+    // Incoming files wait for AcceptDownload or DeclineDownload; the callback
+    // announces each one, from the network threads.
+    void SetTransferOfferCallback(FileTransfers::ProgressCallback callback) { transfers.SetOfferCallback(std::move(callback)); }
+    // False if there is no such offer or no room to save the file.
+    bool AcceptDownload(uint64_t transferId);
+    void DeclineDownload(uint64_t transferId) { transfers.DeclineDownload(transferId); }
+    // Who is on the server, kept up to date from presence changes. The
+    // server sends everyone present after each login.
+    const MemberList& getMembers() const { return members; }
+    // Shows this account as away or online again to everyone else.
+    bool SetPresence(MemberStatus status);
 };
 
 #endif // LIME_CHAT_HPP
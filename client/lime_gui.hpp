@@ -1,79 +1,80 @@
 #include <SFML/Graphics.hpp>
 #include <vector>
+#include <algorithm>
+#include <deque>
+#include <future>
 #include <memory>
-#include <thread>
+#include <mutex>
 #include <sstream>
-#include <ctime>
-#include <unordered_set>
-#include <iomanip>
+#include <thread>
 #include "gui/ui-components/menu.hpp"
 #include "gui/ui-components/input_field.hpp"
 #include "gui/ui-util/menu_util.hpp"
+#include "gui/ui-util/render_stats.hpp"
 #include "gui/ui-assets/text_object.hpp"
 #include "gui/ui-components/scrollable_text_area.hpp"
+#include "gui/ui-components/virtual_list.hpp"
 #include "lime_chat.hpp"
+#include "log.hpp"
+#include "session_config.hpp"
+#include "startup_profile.hpp"
+#include "timestamp_formatter.hpp"
 
 #ifndef LIME_GUI_HPP
 #define LIME_GUI_HPP
 
+// One window over any number of sessions. Each has its own client and
+// message view; a tab row switches between them and the window title sums
+// up what is unread. Only the session on screen is laid out each frame, the
+// others just count what has arrived since they were last looked at.
 class LimeGUI {
 public:
-    LimeGUI(const std::string& serverIp, int serverPort) : chatClient(serverIp, serverPort),
-        window(sf::VideoMode(640, 480), "Lime Chat"),
-        textObject("Default Text", 40.0f, 40.0f, 16, 0, 0, 0),
-        newMessagesReceived(false) {
+    explicit LimeGUI(const std::vector<SessionConfig>& sessionConfigs)
+        // Image decoding starts first and runs on workers while the font,
+        // window and widgets are set up here; only the texture upload has to
+        // wait for the GL thread
+        : iconImage(std::async(std::launch::async, [this] { return decodeImage("limechat.png", "icon"); })),
+        backgroundImage(std::async(std::launch::async, [this] { return decodeImage("background.png", "background"); })),
+        textObject("Default Text", 40.0f, 40.0f, 16, 0, 0, 0) {
 
+        window.create(sf::VideoMode(640, 480), "Lime Chat");
         window.setFramerateLimit(60);
-        sf::Image icon;
-        if (!icon.loadFromFile("limechat.png")) {
-            std::cerr << "Failed to load application icon!" << std::endl;
-        }
-        else {
-            window.setIcon(icon.getSize().x, icon.getSize().y, icon.getPixelsPtr());
-        }
+        startup.Mark("window");
 
         menuUtil = std::make_unique<MenuUtil>();
-
-        messageDisplayMenu = std::make_unique<ScrollableTextArea>(sf::Vector2f(0, 20), 600, 400);
-        menuUtil->add_menu(messageDisplayMenu.get());
-
-        if (!backgroundTexture.loadFromFile("background.png")) {
-            std::cerr << "Failed to load background texture!" << std::endl;
-            return;
+        buildLoginForm();
+        buildChatView();
+        for (const SessionConfig& config : sessionConfigs) {
+            addSession(config);
         }
+        layoutTabs();
+        startup.Mark("widgets");
+    }
 
-        backgroundSprite = sf::Sprite(backgroundTexture);
+    // Records the first session's inbound traffic for later replay; call
+    // before run()
+    bool captureTraffic(const std::string& path) {
+        return sessions.front()->client->StartCapture(path);
+    }
 
-        inputMenu = std::make_unique<Menu>(sf::Vector2f(20, 0), false, true);
-        inputMenu->set_background_color(sf::Color(200, 200, 200));
-        inputField = std::make_unique<InputField>("Enter your message", 450, 40);
-        inputField->set_position(20, 0);
-        inputField->set_background_color(sf::Color::White);
-        inputField->set_text_color(sf::Color::White);
-        inputMenu->add_input_field("Enter your message", 450, 40);
-        inputField->set_enter_callback([this](const std::string& message) {
-            if (!message.empty()) {
-                auto now = std::chrono::system_clock::now();
-                auto now_c = std::chrono::system_clock::to_time_t(now);
-                std::tm tm_time;
-                localtime_s(&tm_time, &now_c); // Convert time to local time
-                std::stringstream ss;
-                ss << "[" << std::put_time(&tm_time, "%Y-%m-%d %H:%M:%S") << "]";
-                std::string current_time = ss.str();
-
-                if(message != "")
-                { 
-                    chatClient.SendMessage(message, chatClient.getUsername(), chatClient.getPassword());
-                    chatMessages.push_back(current_time + " <" + chatClient.getUsername() + ">: " + message);
-                    newMessagesReceived = true;
-                }
-            }
-            });
-        menuUtil->add_menu(inputMenu.get());
+    // Skips the login form and plays a capture through the first session
+    // instead of connecting. Frame times are reported when it finishes.
+    bool replayTraffic(const std::string& path, double speed) {
+        Session& session = *sessions.front();
+        if (!session.client->StartReplay(path, speed, session.newMessages)) {
+            return false;
+        }
+        session.started = true;
+        showChatView();
+        statusText.set_text(std::string("Replaying ") + path);
+        replayActive = true;
+        return true;
     }
 
     void run() {
-        std::thread clientThread(&LimeChat::Run, &chatClient, std::ref(newMessagesReceived));
+        bool firstFrame = true;
+        sf::Clock frameClock;
+        startConfiguredSessions();
 
         while (window.isOpen()) {
             sf::Event event;
@@ -81,60 +82,681 @@ public:
                 if (event.type == sf::Event::Closed) {
                     window.close();
                 }
+                else if (event.type == sf::Event::Resized) {
+                    float width = static_cast<float>(event.size.width);
+                    float height = static_cast<float>(event.size.height);
+                    window.setView(sf::View(sf::FloatRect(0, 0, width, height)));
+                    for (auto& session : sessions) {
+                        session->view->set_size(width - 50.f - kMemberPanelWidth, height - 80.f);
+                    }
+                    memberList->set_bounds(sf::FloatRect(width - 20.f - kMemberPanelWidth, 20.f, kMemberPanelWidth, height - 80.f));
+                    memberHeader.set_position(width - 20.f - kMemberPanelWidth, height - 58.f);
+                    menuUtil->update_target_bounds(activeSession().view.get());
+                    menuUtil->update_target_bounds(memberList.get());
+                }
 
-                inputField->handle_event(event);
-                messageDisplayMenu->handle_event(event, window);
+                if (handleSessionShortcut(event)) {
+                    continue;
+                }
+                menuUtil->handle_event(event, window);
             }
 
-            window.clear(sf::Color(1, 52, 32));
+            applyDecodedImages();
+            trackConnection();
+            showTransferStatus();
+            showLinkStats();
+            showMembers();
 
-            window.draw(backgroundSprite);
-            menuUtil->draw_menus(window);
-            inputField->draw(window);
+            drawFrame(window);
 
-            // Only update chat messages if new messages were received
-            if (newMessagesReceived) {
-                displayChatMessages();
-                newMessagesReceived = false;
+            // Only the session on screen is laid out; the others only count
+            // their unread messages
+            for (size_t i = 0; i < sessions.size(); ++i) {
+                Session& session = *sessions[i];
+                if (!session.newMessages) {
+                    continue;
+                }
+                session.newMessages = false;
+                applyMessageChanges(session);
+                if (i == current && !displayChatMessages(session)) {
+                    // Over budget; the rest is taken on the next frames
+                    session.newMessages = true;
+                }
+                else {
+                    session.unread = session.client->getChatMessageCount() - session.displayedMessageCount;
+                    unreadChanged = true;
+                }
+            }
+            if (unreadChanged) {
+                showUnread();
             }
 
             window.display();
+
+            float frameMs = frameClock.restart().asSeconds() * 1000.f;
+            if (replayActive) {
+                replayFrameMs.push_back(frameMs);
+                if (!sessions.front()->client->isReplaying() && !sessions.front()->newMessages) {
+                    reportReplayFrames();
+                }
+            }
+
+            if (firstFrame) {
+                firstFrame = false;
+                startup.Mark("first frame");
+                startup.Report();
+            }
         }
 
-        if (clientThread.joinable()) {
-            clientThread.join();
+        for (auto& session : sessions) {
+            session->client->Stop();
         }
     }
 
 private:
-    LimeChat chatClient;
+    // Time a frame may spend turning new messages into lines, so a flood is
+    // spread over several frames instead of freezing one
+    static constexpr sf::Int64 kIngestBudgetUs = 4000;
+    // Messages formatted between checks of the budget
+    static constexpr size_t kIngestSlice = 64;
+    // The member list sits right of the messages
+    static constexpr float kMemberPanelWidth = 150.f;
+
+    struct Session {
+        SessionConfig config;
+        std::unique_ptr<LimeChat> client;
+        std::unique_ptr<ScrollableTextArea> view;
+        TextObject tab{ "", 0.0f, 462.0f, 14, 255, 255, 255 };
+        bool newMessages = false;
+        size_t displayedMessageCount = 0;
+        size_t unread = 0;
+        bool started = false;
+        bool wasConnected = false;
+        bool wasAuthenticated = false;
+        // Incoming files waiting for /accept or /decline, oldest first;
+        // guarded by transferMutex
+        std::deque<uint64_t> offeredFiles;
+    };
+
+    StartupProfile startup;
+    std::future<sf::Image> iconImage;
+    std::future<sf::Image> backgroundImage;
+    std::vector<std::unique_ptr<Session>> sessions;
+    size_t current = 0;
+    bool unreadChanged = true;
+    // The character typed along with a session shortcut is not input
+    bool swallowText = false;
     std::unique_ptr<MenuUtil> menuUtil;
     std::unique_ptr<InputField> inputField;
-    std::unique_ptr<ScrollableTextArea> messageDisplayMenu;
+    std::unique_ptr<InputField> searchField;
+    std::unique_ptr<InputField> usernameField;
+    std::unique_ptr<InputField> passwordField;
     std::unique_ptr<Menu> inputMenu;
     sf::RenderWindow window;
     TextObject textObject;
+    TextObject statusText{ "", 20.0f, 440.0f, 16, 255, 255, 255 };
+    TextObject linkText{ "", 480.0f, 440.0f, 16, 255, 255, 255 };
+    TextObject memberHeader{ "", 470.0f, 422.0f, 14, 200, 200, 200 };
+    std::unique_ptr<VirtualList> memberList;
+    uint64_t shownMembersVersion = static_cast<uint64_t>(-1);
+    sf::Clock linkTextClock;
     sf::Texture backgroundTexture;
     sf::Sprite backgroundSprite;
-    std::vector<std::string> chatMessages;
-    std::unordered_set<std::string> addedMessages;
-    bool newMessagesReceived;
+    bool loggedIn = false;
+    bool replayActive = false;
+    std::vector<float> replayFrameMs;
+    bool statusStale = true;
+    std::mutex transferMutex;
+    std::string transferStatus;
+    bool transferStatusChanged = false;
+    std::string searchQuery;
+    std::vector<uint64_t> searchHits;
+    size_t searchHitCursor = 0;
+
+    sf::Image decodeImage(const std::string& path, const std::string& phase) {
+        sf::Image image;
+        if (!image.loadFromFile(path)) {
+            LOG_ERROR(General) << "Failed to load " << path << "!";
+        }
+        startup.Mark(phase + " decoded");
+        return image;
+    }
+
+    // Uploads images once their worker has finished, without ever waiting on it
+    void applyDecodedImages() {
+        auto ready = [](const std::future<sf::Image>& image) {
+            return image.valid() && image.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        };
+
+        if (ready(iconImage)) {
+            sf::Image icon = iconImage.get();
+            if (icon.getSize().x > 0) {
+                window.setIcon(icon.getSize().x, icon.getSize().y, icon.getPixelsPtr());
+            }
+        }
+        if (ready(backgroundImage)) {
+            sf::Image background = backgroundImage.get();
+            if (background.getSize().x > 0 && backgroundTexture.loadFromImage(background)) {
+                backgroundSprite = sf::Sprite(backgroundTexture);
+            }
+        }
+    }
+
+    void buildLoginForm() {
+        usernameField = std::make_unique<InputField>("Username", 300, 40);
+        usernameField->set_position(170, 180);
+        usernameField->set_text_color(sf::Color::Black);
+        usernameField->set_clear_on_enter(false);
+        usernameField->set_enter_callback([this](const std::string&) {
+            menuUtil->set_focus(passwordField.get());
+            });
+
+        passwordField = std::make_unique<InputField>("Password", 300, 40);
+        passwordField->set_position(170, 230);
+        passwordField->set_text_color(sf::Color::Black);
+        passwordField->set_masked(true);
+        passwordField->set_enter_callback([this](const std::string& password) {
+            if (!usernameField->get_text().empty()) {
+                logIn(usernameField->get_text(), password);
+            }
+            });
+
+        menuUtil->register_target(usernameField.get());
+        menuUtil->register_target(passwordField.get());
+        menuUtil->set_focus(usernameField.get());
+    }
+
+    Session& activeSession() { return *sessions[current]; }
+    LimeChat& activeClient() { return *sessions[current]->client; }
+
+    void addSession(const SessionConfig& config) {
+        auto session = std::make_unique<Session>();
+        Session* owner = session.get();
+        session->config = config;
+        session->client = std::make_unique<LimeChat>(config.host, config.port, config.retention, config.transport, config.statePrefix);
+        session->client->SetTransferProgressCallback([this](const TransferProgress& progress) {
+            onTransferProgress(progress);
+            });
+        session->client->SetTransferOfferCallback([this, owner](const TransferProgress& offer) {
+            onTransferOffer(*owner, offer);
+            });
+
+        session->view = std::make_unique<ScrollableTextArea>(sf::Vector2f(0, 20), 590 - kMemberPanelWidth, 400);
+        session->view->set_history_provider([this, owner](size_t first, size_t count) {
+            std::vector<std::string> lines;
+            lines.reserve(count);
+            owner->client->VisitChatMessages(first, count, [this, owner, &lines](const Message& message) {
+                lines.emplace_back(formatMessage(*owner->client, message));
+                });
+            return lines;
+            });
+        sessions.push_back(std::move(session));
+    }
+
+    // Sessions given with a password log in without the form
+    void startConfiguredSessions() {
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            Session& session = *sessions[i];
+            if (!session.started && session.config.hasCredentials()) {
+                startSession(session, session.config.username, session.config.password);
+            }
+        }
+        if (activeSession().started && !loggedIn) {
+            showChatView();
+        }
+    }
+
+    void startSession(Session& session, const std::string& username, const std::string& password) {
+        session.started = true;
+        session.client->Start(username, password, session.newMessages);
+    }
+
+    void buildChatView() {
+        inputMenu = std::make_unique<Menu>(sf::Vector2f(20, 0), false, true);
+        inputMenu->set_background_color(sf::Color(200, 200, 200));
+        inputField = std::make_unique<InputField>("Enter your message", 450, 40);
+        inputField->set_position(20, 0);
+        inputField->set_background_color(sf::Color::White);
+        inputField->set_text_color(sf::Color::White);
+        // Shift+Enter for a new line; long messages are fragmented on the wire
+        inputField->set_multiline(true);
+        inputMenu->add_input_field("Enter your message", 450, 40);
+        inputField->set_enter_callback([this](const std::string& message) {
+            // "/send <path>" shares a file instead of sending a line
+            if (message.compare(0, 6, "/send ") == 0) {
+                std::string path = message.substr(6);
+                if (!activeClient().SendAttachment(path)) {
+                    statusText.set_text(std::string("Can't open ") + path);
+                }
+            }
+            // "/edit <text>" and "/delete" change the highlighted search hit,
+            // or else your last message
+            else if (message.compare(0, 6, "/edit ") == 0 || message == "/delete") {
+                LimeChat& client = activeClient();
+                size_t index = searchHits.empty() ? client.FindLastOwnMessage() : static_cast<size_t>(searchHits[searchHitCursor]);
+                bool sent = index != std::string::npos
+                    && (message == "/delete" ? client.DeleteMessage(index) : client.EditMessage(index, message.substr(6)));
+                if (!sent) {
+                    statusText.set_text(std::string("Nothing to change, or it isn't on the server yet"));
+                }
+            }
+            // "/accept" and "/decline" answer the oldest file offered to this session
+            else if (message == "/accept" || message == "/decline") {
+                answerOffer(activeSession(), message == "/accept");
+            }
+            else if (message == "/away" || message == "/back") {
+                activeClient().SetPresence(message == "/away" ? MemberStatus::Away : MemberStatus::Online);
+            }
+            else if (!message.empty()) {
+                LimeChat& client = activeClient();
+                client.SendMessage(message, client.getUsername(), client.getPassword());
+                activeSession().newMessages = true;
+            }
+            });
+
+        // Rows are read from the active session's roster only when in view
+        memberList = std::make_unique<VirtualList>(sf::Vector2f(470, 20), kMemberPanelWidth, 400);
+        memberList->set_row_provider([this](size_t first, size_t count, std::vector<VirtualList::Row>& rows) {
+            activeClient().getMembers().Visit(first, count, [&rows](std::string_view name, MemberStatus status) {
+                rows.push_back({ std::string(name), status == MemberStatus::Away ? sf::Color(150, 150, 150) : sf::Color::White });
+                });
+            });
+
+        searchField = std::make_unique<InputField>("Search", 150, 40);
+        searchField->set_position(480, 0);
+        searchField->set_background_color(sf::Color::White);
+        searchField->set_text_color(sf::Color::Black);
+        searchField->set_enter_callback([this](const std::string& query) {
+            // Pressing enter again on the same query steps to the next older hit
+            if (query != searchQuery) {
+                searchQuery = query;
+                searchHits = activeClient().SearchMessages(query, 500);
+                searchHitCursor = 0;
+            }
+            else if (!searchHits.empty()) {
+                searchHitCursor = (searchHitCursor + 1) % searchHits.size();
+            }
+
+            if (!searchHits.empty()) {
+                activeSession().view->scroll_to(static_cast<size_t>(searchHits[searchHitCursor]));
+            }
+            });
+    }
+
+    // Swaps the login form for the chat view straight away; the connection
+    // comes up in the background and the status line follows it
+    void logIn(const std::string& username, const std::string& password) {
+        showChatView();
+        statusText.set_text(std::string("Connecting..."));
+        startup.Mark("login submitted");
+        startSession(activeSession(), username, password);
+    }
 
-    void displayChatMessages() {
-        std::vector<std::string> latestMessages = chatClient.getChatMessages();
+    void showChatView() {
+        menuUtil->unregister_target(usernameField.get());
+        menuUtil->unregister_target(passwordField.get());
+
+        // The menu stack only ever holds the current session's view
+        menuUtil->clear_stack();
+        menuUtil->add_menu(activeSession().view.get());
+        menuUtil->register_target(activeSession().view.get());
+        menuUtil->add_menu(inputMenu.get());
+        menuUtil->add_menu(memberList.get());
+        menuUtil->register_target(memberList.get());
+        menuUtil->register_target(inputField.get());
+        menuUtil->register_target(searchField.get());
+        menuUtil->set_focus(inputField.get());
+        loggedIn = true;
+    }
+
+    void showLoginForm() {
+        menuUtil->clear_stack();
+        menuUtil->unregister_target(inputField.get());
+        menuUtil->unregister_target(searchField.get());
+        menuUtil->unregister_target(memberList.get());
+
+        statusText.set_text("Log in to " + activeSession().config.name);
+        menuUtil->register_target(usernameField.get());
+        menuUtil->register_target(passwordField.get());
+        menuUtil->set_focus(usernameField.get());
+        loggedIn = false;
+    }
+
+    void switchSession(size_t index) {
+        if (index >= sessions.size() || index == current || replayActive) {
+            return;
+        }
 
-        chatMessages.insert(chatMessages.end(), latestMessages.begin(), latestMessages.end());
+        menuUtil->unregister_target(activeSession().view.get());
+        current = index;
+        searchQuery.clear();
+        searchHits.clear();
+        shownMembersVersion = static_cast<uint64_t>(-1);
 
-        for (const auto& message : chatMessages) {
-            std::istringstream iss(message);
-            std::string messageContent;
-            std::getline(iss, messageContent, '|'); // Read message content only
+        Session& session = activeSession();
+        if (session.started) {
+            showChatView();
+            session.newMessages = true;
+        }
+        else {
+            showLoginForm();
+        }
+        statusStale = true;
+        unreadChanged = true;
+        linkText.set_text(std::string());
+        linkTextClock.restart();
+    }
+
+    // Ctrl+Tab cycles through the sessions, Ctrl+1..9 picks one and a click
+    // on a tab selects it. Returns true when the event was used up.
+    bool handleSessionShortcut(const sf::Event& event) {
+        if (event.type == sf::Event::TextEntered && swallowText) {
+            swallowText = false;
+            return true;
+        }
+        if (sessions.size() < 2) {
+            return false;
+        }
+
+        if (event.type == sf::Event::KeyPressed && event.key.control) {
+            if (event.key.code == sf::Keyboard::Tab) {
+                switchSession((current + (event.key.shift ? sessions.size() - 1 : 1)) % sessions.size());
+                swallowText = true;
+                return true;
+            }
+            if (event.key.code >= sf::Keyboard::Num1 && event.key.code <= sf::Keyboard::Num9) {
+                switchSession(static_cast<size_t>(event.key.code - sf::Keyboard::Num1));
+                swallowText = true;
+                return true;
+            }
+        }
+        else if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
+            sf::Vector2f point(static_cast<float>(event.mouseButton.x), static_cast<float>(event.mouseButton.y));
+            for (size_t i = 0; i < sessions.size(); ++i) {
+                if (sessions[i]->tab.get_text().getGlobalBounds().contains(point)) {
+                    switchSession(i);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Tab labels carry each session's unread count; the title carries the total
+    void showUnread() {
+        unreadChanged = false;
+        size_t total = 0;
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            total += i == current ? 0 : sessions[i]->unread;
+        }
+        layoutTabs();
+        window.setTitle(total > 0 ? "Lime Chat (" + std::to_string(total) + " unread)" : std::string("Lime Chat"));
+    }
+
+    void layoutTabs() {
+        if (sessions.size() < 2) {
+            return;
+        }
+
+        float x = 20.0f;
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            Session& session = *sessions[i];
+            std::string label = session.config.name;
+            if (i != current && session.unread > 0) {
+                label += " (" + std::to_string(session.unread) + ")";
+            }
+            session.tab.set_text(label);
+            session.tab.set_position(x, 462.0f);
+            if (i == current) {
+                session.tab.set_color(255, 255, 255);
+            }
+            else if (session.unread > 0) {
+                session.tab.set_color(255, 220, 120);
+            }
+            else {
+                session.tab.set_color(150, 150, 150);
+            }
+            x += session.tab.get_local_bounds().width + 18.0f;
+        }
+    }
+
+    void drawFrame(sf::RenderTarget& target) {
+        target.clear(sf::Color(1, 52, 32));
+
+        RenderStats::draw(target, backgroundSprite);
+        if (loggedIn) {
+            menuUtil->draw_menus(target);
+            inputField->draw(target);
+            searchField->draw(target);
+        }
+        else {
+            usernameField->draw(target);
+            passwordField->draw(target);
+        }
+        RenderStats::draw(target, statusText.get_text());
+        if (loggedIn) {
+            RenderStats::draw(target, linkText.get_text());
+            RenderStats::draw(target, memberHeader.get_text());
+        }
+        if (sessions.size() > 1) {
+            for (const auto& session : sessions) {
+                RenderStats::draw(target, session->tab.get_text());
+            }
+        }
+    }
+
+    void reportReplayFrames() {
+        replayActive = false;
+        statusText.set_text(std::string("Replay finished"));
+        if (replayFrameMs.empty()) {
+            return;
+        }
+
+        std::vector<float> sorted = replayFrameMs;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&sorted](double p) {
+            return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+        };
+        std::cout << "Replay frames: " << sorted.size() << ", p50 " << percentile(0.5) << " ms, p99 "
+            << percentile(0.99) << " ms, max " << sorted.back() << " ms" << std::endl;
+        replayFrameMs.clear();
+    }
+
+    // Called from the network threads; the status line is updated on the next frame
+    void onTransferProgress(const TransferProgress& progress) {
+        std::ostringstream status;
+        if (progress.finished) {
+            status << (progress.upload ? "Sent " : "Saved ") << progress.name;
+        }
+        else {
+            status << (progress.upload ? "Sending " : "Receiving ") << progress.name << ": "
+                << (progress.totalBytes > 0 ? progress.bytesDone * 100 / progress.totalBytes : 100) << "% of "
+                << (progress.totalBytes + 1023) / 1024 << " KB";
+        }
+
+        std::lock_guard<std::mutex> lock(transferMutex);
+        transferStatus = status.str();
+        transferStatusChanged = true;
+    }
+
+    // Called from the network threads
+    void onTransferOffer(Session& session, const TransferProgress& offer) {
+        std::ostringstream status;
+        status << offer.name << " (" << (offer.totalBytes + 1023) / 1024 << " KB) offered: /accept or /decline";
+
+        std::lock_guard<std::mutex> lock(transferMutex);
+        session.offeredFiles.push_back(offer.transferId);
+        transferStatus = status.str();
+        transferStatusChanged = true;
+    }
+
+    void answerOffer(Session& session, bool accept) {
+        uint64_t transferId;
+        {
+            std::lock_guard<std::mutex> lock(transferMutex);
+            if (session.offeredFiles.empty()) {
+                statusText.set_text(std::string("No file is waiting to be accepted"));
+                return;
+            }
+            transferId = session.offeredFiles.front();
+            session.offeredFiles.pop_front();
+        }
+
+        if (!accept) {
+            session.client->DeclineDownload(transferId);
+        }
+        else if (!session.client->AcceptDownload(transferId)) {
+            // Still on offer, e.g. to try again once there is room for it
+            std::lock_guard<std::mutex> lock(transferMutex);
+            session.offeredFiles.push_front(transferId);
+            statusText.set_text(std::string("Can't save the file; is there room for it?"));
+        }
+    }
+
+    void showTransferStatus() {
+        std::lock_guard<std::mutex> lock(transferMutex);
+        if (transferStatusChanged) {
+            statusText.set_text(transferStatus);
+            transferStatusChanged = false;
+        }
+    }
+
+    // Round trip and jitter, refreshed once a second
+    void showLinkStats() {
+        if (linkTextClock.getElapsedTime().asSeconds() < 1.f) {
+            return;
+        }
+        linkTextClock.restart();
+
+        LinkHealth::Stats link = activeClient().getLinkStats();
+        if (!link.hasSample || !activeClient().isConnected()) {
+            linkText.set_text(std::string());
+            return;
+        }
+        std::ostringstream text;
+        text << "RTT " << static_cast<int>(link.smoothedRttMs + 0.5) << " ms +/- " << static_cast<int>(link.rttVarianceMs + 0.5);
+        linkText.set_text(text.str());
+    }
+
+    void trackConnection() {
+        if (!loggedIn || replayActive) {
+            return;
+        }
+
+        Session& session = activeSession();
+        bool connected = session.client->isConnected();
+        bool authenticated = session.client->isAuthenticated();
+        if (connected == session.wasConnected && authenticated == session.wasAuthenticated && !statusStale) {
+            return;
+        }
+
+        if (connected && !session.wasConnected) {
+            startup.Mark("connected");
+        }
+        if (authenticated && !session.wasAuthenticated) {
+            startup.Mark("logged in");
+            startup.Report();
+        }
+        session.wasConnected = connected;
+        session.wasAuthenticated = authenticated;
+        statusStale = false;
+
+        if (authenticated) {
+            statusText.set_text(std::string());
+        }
+        else if (connected) {
+            statusText.set_text(std::string("Logging in..."));
+        }
+        else {
+            statusText.set_text(std::string("Offline, reconnecting..."));
+        }
+    }
+
+    // However many presence changes came in, the list fetches the rows in
+    // view once, in frames where the roster changed
+    void showMembers() {
+        const MemberList& members = activeClient().getMembers();
+        uint64_t version = members.getVersion();
+        if (version == shownMembersVersion) {
+            return;
+        }
+        shownMembersVersion = version;
+        size_t count = members.size();
+        memberList->set_row_count(count);
+        memberHeader.set_text(std::to_string(members.onlineCount()) + " online, " + std::to_string(count) + " in all");
+    }
+
+    TimestampFormatter timestampFormatter;
+    std::string lineBuffer;
+
+    // Builds the displayed "[time] <user>: body" line from the message fields.
+    // Legacy lines have no known sender and are shown as they arrived.
+    std::string_view formatMessage(const LimeChat& client, const Message& message) {
+        if (message.userId == 0) {
+            return message.body;
+        }
+
+        lineBuffer.assign(timestampFormatter.Format(message.timestampMs));
+        lineBuffer.append(" <");
+        lineBuffer.append(client.getUserName(message.userId));
+        lineBuffer.append(">: ");
+        if (message.flags & kMessageDeleted) {
+            lineBuffer.append("[message deleted]");
+            return lineBuffer;
+        }
+        lineBuffer.append(message.body);
+        if (message.flags & kMessageEdited) {
+            lineBuffer.append(" (edited)");
+        }
+        return lineBuffer;
+    }
+
+    // Edited and deleted messages already on screen are re-laid out one row
+    // each; the ones not shown yet are formatted with the change anyway.
+    void applyMessageChanges(Session& session) {
+        for (size_t index : session.client->TakeChangedMessages()) {
+            if (index >= session.displayedMessageCount) {
+                continue;
+            }
+            session.client->VisitChatMessages(index, 1, [this, &session, index](const Message& message) {
+                session.view->update_line(index, formatMessage(*session.client, message));
+                });
+        }
+    }
+
+    // Returns false when the budget ran out before every new message was shown.
+    bool displayChatMessages(Session& session) {
+        if (session.unread > 0) {
+            session.unread = 0;
+            unreadChanged = true;
+        }
+
+        // The history is append-only, so only lines past the ones already shown
+        // are new. They are read in place from the store, not copied out.
+        LimeChat& client = *session.client;
+        size_t total = client.getChatMessageCount();
+
+        // More than the view keeps would only be trimmed again: those are
+        // counted, and the view fetches whatever it ends up showing
+        size_t backlog = total - session.displayedMessageCount;
+        if (backlog > session.view->get_max_rows()) {
+            size_t skipped = backlog - session.view->get_max_rows();
+            session.view->add_lines(skipped);
+            session.displayedMessageCount += skipped;
+        }
 
-            if (addedMessages.find(messageContent) == addedMessages.end()) {
-                messageDisplayMenu->add_string(messageContent);
-                addedMessages.insert(messageContent);
+        sf::Clock budget;
+        while (session.displayedMessageCount < total) {
+            if (budget.getElapsedTime().asMicroseconds() >= kIngestBudgetUs) {
+                return false;
             }
+            size_t count = std::min(kIngestSlice, total - session.displayedMessageCount);
+            client.VisitChatMessages(session.displayedMessageCount, count, [this, &session, &client](const Message& message) {
+                session.view->add_string(formatMessage(client, message));
+                session.displayedMessageCount++;
+                });
         }
+        return true;
     }
 };
 
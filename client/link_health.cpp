@@ -0,0 +1,162 @@
+#include "link_health.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <iterator>
+
+namespace {
+    const size_t kOffsetSamples = 8;
+    const size_t kMaxOutstanding = 16;
+    const double kMinTimeoutMs = 1000;  // RFC 6298 lower bound on the RTO
+    // Older timestamps come from history being fetched, not live delivery
+    const int64_t kMaxDeliveryMs = 60000;
+
+    bool ReadField(std::string_view& line, int64_t& value) {
+        const char* end = line.data() + line.size();
+        auto result = std::from_chars(line.data(), end, value);
+        if (result.ec != std::errc() || (result.ptr != end && *result.ptr != '|')) {
+            return false;
+        }
+        line.remove_prefix(result.ptr - line.data() + (result.ptr != end ? 1 : 0));
+        return true;
+    }
+}
+
+LinkHealth::LinkHealth() : nextSequence(1), peerAnswers(false), lastReceiveNs(0), offsetUs(0) {
+    OnReceive();
+}
+
+int64_t LinkHealth::WallClockUs() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+void LinkHealth::Reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    outstanding.clear();
+    peerAnswers = false;
+    OnReceive();
+}
+
+void LinkHealth::OnReceive() {
+    lastReceiveNs = SteadyClock::now().time_since_epoch().count();
+}
+
+double LinkHealth::RetransmissionTimeoutMs() const {
+    if (!current.hasSample) {
+        return 3 * kMinTimeoutMs;
+    }
+    return std::max(kMinTimeoutMs, current.smoothedRttMs + 4 * current.rttVarianceMs);
+}
+
+std::string LinkHealth::MakePing() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Pings unanswered for longer than the RTO count as lost
+    SteadyClock::time_point now = SteadyClock::now();
+    auto timeout = std::chrono::duration<double, std::milli>(RetransmissionTimeoutMs());
+    while (!outstanding.empty() && (now - outstanding.front().sent > timeout || outstanding.size() >= kMaxOutstanding)) {
+        outstanding.pop_front();
+        current.pingsLost++;
+    }
+
+    uint64_t sequence = nextSequence++;
+    outstanding.push_back({ sequence, now });
+    current.pingsSent++;
+    return "PING|" + std::to_string(sequence) + "|" + std::to_string(WallClockUs()) + "\n";
+}
+
+bool LinkHealth::OnPong(std::string_view line) {
+    SteadyClock::time_point arrived = SteadyClock::now();
+    int64_t t4 = WallClockUs();
+
+    line.remove_prefix(5);
+    int64_t sequence = 0;
+    int64_t t1 = 0;
+    int64_t t2 = 0;
+    int64_t t3 = 0;
+    if (!ReadField(line, sequence) || !ReadField(line, t1) || !ReadField(line, t2) || !ReadField(line, t3)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto ping = std::find_if(outstanding.begin(), outstanding.end(), [sequence](const OutstandingPing& entry) {
+        return entry.sequence == static_cast<uint64_t>(sequence);
+        });
+    if (ping == outstanding.end()) {
+        return false;
+    }
+
+    // The round trip is timed on the steady clock, so a wall clock step
+    // can't distort it; the server's processing time is taken out
+    double elapsedMs = std::chrono::duration<double, std::milli>(arrived - ping->sent).count();
+    double rttMs = std::max(0.0, elapsedMs - (t3 - t2) / 1000.0);
+    double offsetMs = ((t2 - t1) + (t3 - t4)) / 2000.0;
+    outstanding.erase(outstanding.begin(), std::next(ping));
+    peerAnswers = true;
+
+    if (!current.hasSample) {
+        current.smoothedRttMs = rttMs;
+        current.rttVarianceMs = rttMs / 2;
+        current.hasSample = true;
+    }
+    else {
+        current.rttVarianceMs = 0.75 * current.rttVarianceMs + 0.25 * std::fabs(current.smoothedRttMs - rttMs);
+        current.smoothedRttMs = 0.875 * current.smoothedRttMs + 0.125 * rttMs;
+    }
+    current.latestRttMs = rttMs;
+    current.pongsReceived++;
+
+    samples.push_back({ rttMs, offsetMs });
+    if (samples.size() > kOffsetSamples) {
+        samples.pop_front();
+    }
+    auto best = std::min_element(samples.begin(), samples.end(), [](const Sample& a, const Sample& b) {
+        return a.rttMs < b.rttMs;
+        });
+    current.clockOffsetMs = best->offsetMs;
+    offsetUs = static_cast<int64_t>(best->offsetMs * 1000);
+    return true;
+}
+
+std::string LinkHealth::MakePong(std::string_view ping) {
+    int64_t t2 = WallClockUs();
+    ping.remove_prefix(5);
+    int64_t sequence = 0;
+    int64_t t1 = 0;
+    if (!ReadField(ping, sequence) || !ReadField(ping, t1)) {
+        return std::string();
+    }
+    return "PONG|" + std::to_string(sequence) + "|" + std::to_string(t1) + "|" + std::to_string(t2) + "|"
+        + std::to_string(WallClockUs()) + "\n";
+}
+
+bool LinkHealth::IsDead(int timeoutMs) const {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!peerAnswers) {
+            return false;
+        }
+    }
+    int64_t silentNs = SteadyClock::now().time_since_epoch().count() - lastReceiveNs;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(SteadyClock::duration(silentNs)).count() > timeoutMs;
+}
+
+int64_t LinkHealth::ServerTimeMs() const {
+    return (WallClockUs() + offsetUs) / 1000;
+}
+
+void LinkHealth::OnMessageTimestamp(int64_t serverTimestampMs) {
+    int64_t delayMs = ServerTimeMs() - serverTimestampMs;
+    if (delayMs < 0 || delayMs > kMaxDeliveryMs) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    current.deliveryMs = current.deliveryMs == 0 ? delayMs : 0.875 * current.deliveryMs + 0.125 * delayMs;
+}
+
+LinkHealth::Stats LinkHealth::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
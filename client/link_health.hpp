@@ -0,0 +1,92 @@
+#ifndef LINK_HEALTH_HPP
+#define LINK_HEALTH_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// Liveness, latency and clock offset of the connection, measured with
+// protocol-level pings:
+//   PING|seq|t1            t1 = sender's clock when sent, µs since the epoch
+//   PONG|seq|t1|t2|t3      t2/t3 = responder's clock on receipt and reply
+// With t4 the time the pong arrived, the round trip is (t4 - t1) - (t3 - t2)
+// and the responder's clock is ahead by ((t2 - t1) + (t3 - t4)) / 2, as in
+// NTP. RTT is smoothed as in RFC 6298; the offset comes from the sample with
+// the shortest round trip among the last few, which is the least skewed by
+// asymmetric queuing.
+class LinkHealth {
+public:
+    struct Stats {
+        bool hasSample = false;
+        double smoothedRttMs = 0;
+        double rttVarianceMs = 0;  // RFC 6298 RTTVAR, a jitter estimate
+        double latestRttMs = 0;
+        double clockOffsetMs = 0;  // Server clock minus ours
+        double deliveryMs = 0;     // Smoothed server timestamp to arrival, corrected for the offset
+        uint64_t pingsSent = 0;
+        uint64_t pongsReceived = 0;
+        uint64_t pingsLost = 0;
+    };
+
+private:
+    using SteadyClock = std::chrono::steady_clock;
+
+    struct Sample {
+        double rttMs;
+        double offsetMs;
+    };
+
+    struct OutstandingPing {
+        uint64_t sequence;
+        SteadyClock::time_point sent;
+    };
+
+    mutable std::mutex mutex;
+    Stats current;
+    std::deque<Sample> samples;
+    std::deque<OutstandingPing> outstanding;
+    uint64_t nextSequence;
+    bool peerAnswers;
+    std::atomic<int64_t> lastReceiveNs;
+    std::atomic<int64_t> offsetUs;
+
+    static int64_t WallClockUs();
+    double RetransmissionTimeoutMs() const;
+
+public:
+    LinkHealth();
+
+    // A new connection: pings in flight are forgotten; statistics are kept.
+    void Reset();
+
+    // Any inbound bytes prove the peer is alive.
+    void OnReceive();
+
+    // Returns the next "PING|..." line.
+    std::string MakePing();
+
+    // Handles "PONG|..."; returns false for malformed or stale pongs.
+    bool OnPong(std::string_view line);
+
+    // Answers the server's "PING|seq|t1".
+    static std::string MakePong(std::string_view ping);
+
+    // True once nothing has arrived for `timeoutMs`. Only applies after the
+    // server has answered a ping on this connection, so servers that don't
+    // know PING are never taken for dead.
+    bool IsDead(int timeoutMs) const;
+
+    // Our clock corrected to the server's, for stamping local messages.
+    int64_t ServerTimeMs() const;
+
+    // Feeds the end-to-end delay of a live message stamped by the server.
+    void OnMessageTimestamp(int64_t serverTimestampMs);
+
+    Stats stats() const;
+};
+
+#endif // LINK_HEALTH_HPP
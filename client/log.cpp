@@ -0,0 +1,344 @@
+#include "log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+    using namespace logging;
+
+    // Per thread; a network thread logging every line it reads fills this
+    // in well over a drain period only if the output can't keep up
+    const size_t kRingBytes = 256 * 1024;
+    const size_t kMaxLineBytes = 8 * 1024;
+    const auto kDrainInterval = std::chrono::milliseconds(50);
+
+    const char* const kLevelNames[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+    const char* const kCategoryNames[] = { "general", "network", "protocol", "transfer", "storage" };
+
+    // Constant-initialized, so they can be read even while statics are
+    // being destroyed
+    std::atomic<int> minimumLevel{ static_cast<int>(LogLevel::Info) };
+    std::atomic<uint32_t> enabledCategories{ ~0u };
+    std::atomic<bool> shutDown{ false };
+
+    struct RecordHeader {
+        uint32_t size; // Of the text that follows
+        LogLevel level;
+        LogCategory category;
+        int64_t timeUs;
+    };
+
+    // Single producer (the owning thread), single consumer (whoever holds
+    // the logger's drain lock). Head and tail count bytes ever written and
+    // read, so their difference is the fill level.
+    class Ring {
+    private:
+        std::unique_ptr<char[]> bytes;
+        std::atomic<uint64_t> head{ 0 };
+        std::atomic<uint64_t> tail{ 0 };
+
+        void CopyIn(uint64_t position, const void* data, size_t size) {
+            size_t offset = static_cast<size_t>(position % kRingBytes);
+            size_t first = std::min(size, kRingBytes - offset);
+            std::memcpy(bytes.get() + offset, data, first);
+            std::memcpy(bytes.get(), static_cast<const char*>(data) + first, size - first);
+        }
+
+        void CopyOut(uint64_t position, void* data, size_t size) const {
+            size_t offset = static_cast<size_t>(position % kRingBytes);
+            size_t first = std::min(size, kRingBytes - offset);
+            std::memcpy(data, bytes.get() + offset, first);
+            std::memcpy(static_cast<char*>(data) + first, bytes.get(), size - first);
+        }
+
+    public:
+        std::atomic<uint64_t> dropped{ 0 };
+        std::atomic<bool> retired{ false }; // The owning thread has exited
+
+        Ring() : bytes(new char[kRingBytes]) {}
+
+        // Returns false, writing nothing, if the record doesn't fit.
+        bool Push(const RecordHeader& header, const char* text) {
+            uint64_t position = head.load(std::memory_order_relaxed);
+            size_t needed = sizeof(header) + header.size;
+            if (kRingBytes - (position - tail.load(std::memory_order_acquire)) < needed) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            CopyIn(position, &header, sizeof(header));
+            CopyIn(position + sizeof(header), text, header.size);
+            head.store(position + needed, std::memory_order_release);
+            return true;
+        }
+
+        bool HalfFull() const {
+            return head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed) > kRingBytes / 2;
+        }
+
+        bool Empty() const {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+        }
+
+        template <typename Visit>
+        void Drain(Visit&& visit, std::string& text) {
+            uint64_t position = tail.load(std::memory_order_relaxed);
+            uint64_t end = head.load(std::memory_order_acquire);
+            while (position < end) {
+                RecordHeader header;
+                CopyOut(position, &header, sizeof(header));
+                text.resize(header.size);
+                CopyOut(position + sizeof(header), &text[0], header.size);
+                position += sizeof(header) + header.size;
+                visit(header, text);
+            }
+            tail.store(position, std::memory_order_release);
+        }
+    };
+
+    struct Record {
+        int64_t timeUs;
+        std::string line;
+    };
+
+    class Logger {
+    private:
+        std::mutex ringsMutex;
+        std::vector<std::shared_ptr<Ring>> rings;
+        std::mutex drainMutex;
+        std::FILE* output = stderr;
+        std::vector<Record> batch;
+        std::string text;
+        std::string out;
+        std::mutex wakeMutex;
+        std::condition_variable wake;
+        bool stopping = false;
+        std::thread drainThread;
+
+        void DrainLoop() {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            while (!stopping) {
+                wake.wait_for(lock, kDrainInterval);
+                lock.unlock();
+                Drain();
+                lock.lock();
+            }
+        }
+
+        void Format(const RecordHeader& header, const std::string& message, std::string& line) {
+            std::time_t seconds = static_cast<std::time_t>(header.timeUs / 1000000);
+            char stamp[32];
+            // Only the drain lock holder gets here, so localtime's shared
+            // buffer is safe
+            size_t length = std::strftime(stamp, sizeof(stamp), "%H:%M:%S", std::localtime(&seconds));
+            std::snprintf(stamp + length, sizeof(stamp) - length, ".%03d", static_cast<int>(header.timeUs / 1000 % 1000));
+
+            line.clear();
+            line += stamp;
+            line += ' ';
+            line += kLevelNames[static_cast<int>(header.level)];
+            line += ' ';
+            line += kCategoryNames[static_cast<int>(header.category)];
+            line += ": ";
+            line += message;
+            line += '\n';
+        }
+
+    public:
+        ~Logger() {
+            shutDown = true;
+            {
+                std::lock_guard<std::mutex> lock(wakeMutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            if (drainThread.joinable()) {
+                drainThread.join();
+            }
+            Drain();
+            if (output != stderr) {
+                std::fclose(output);
+            }
+        }
+
+        std::shared_ptr<Ring> AddRing() {
+            auto ring = std::make_shared<Ring>();
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.push_back(ring);
+            if (!drainThread.joinable()) {
+                drainThread = std::thread(&Logger::DrainLoop, this);
+            }
+            return ring;
+        }
+
+        void Wake() {
+            wake.notify_one();
+        }
+
+        bool SetOutputFile(const std::string& path) {
+            std::FILE* file = std::fopen(path.c_str(), "a");
+            if (!file) {
+                return false;
+            }
+            Drain();
+            std::lock_guard<std::mutex> lock(drainMutex);
+            if (output != stderr) {
+                std::fclose(output);
+            }
+            output = file;
+            return true;
+        }
+
+        // Writes out every ring. Lines from different threads are put back
+        // in time order within a batch.
+        void Drain() {
+            std::vector<std::shared_ptr<Ring>> current;
+            {
+                std::lock_guard<std::mutex> lock(ringsMutex);
+                // A ring whose thread is gone is dropped once read, below
+                current = rings;
+            }
+
+            std::lock_guard<std::mutex> lock(drainMutex);
+            batch.clear();
+            uint64_t dropped = 0;
+            for (const auto& ring : current) {
+                ring->Drain([this](const RecordHeader& header, const std::string& message) {
+                    batch.push_back({ header.timeUs, std::string() });
+                    Format(header, message, batch.back().line);
+                    }, text);
+                dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+            }
+            if (batch.empty() && dropped == 0) {
+                PruneRetired();
+                return;
+            }
+
+            std::stable_sort(batch.begin(), batch.end(), [](const Record& a, const Record& b) {
+                return a.timeUs < b.timeUs;
+                });
+            out.clear();
+            for (const Record& record : batch) {
+                out += record.line;
+            }
+            if (dropped > 0) {
+                out += "Logging fell behind, " + std::to_string(dropped) + " line(s) dropped\n";
+            }
+            std::fwrite(out.data(), 1, out.size(), output);
+            std::fflush(output);
+            PruneRetired();
+        }
+
+        void PruneRetired() {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<Ring>& ring) {
+                return ring->retired && ring->Empty();
+                }), rings.end());
+        }
+    };
+
+    Logger& Instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    struct ThreadRing {
+        std::shared_ptr<Ring> ring;
+        std::string scratch;
+
+        ~ThreadRing() {
+            if (ring) {
+                ring->retired = true;
+            }
+        }
+    };
+
+    ThreadRing& CurrentThread() {
+        thread_local ThreadRing current;
+        return current;
+    }
+
+    int64_t NowUs() {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+    }
+}
+
+namespace logging {
+    void SetLevel(LogLevel level) {
+        minimumLevel = static_cast<int>(level);
+    }
+
+    void SetCategoryEnabled(LogCategory category, bool enabled) {
+        uint32_t bit = 1u << static_cast<int>(category);
+        if (enabled) {
+            enabledCategories.fetch_or(bit);
+        }
+        else {
+            enabledCategories.fetch_and(~bit);
+        }
+    }
+
+    bool SetOutputFile(const std::string& path) {
+        return Instance().SetOutputFile(path);
+    }
+
+    bool ParseLevel(std::string_view name, LogLevel& level) {
+        static const std::pair<std::string_view, LogLevel> kNames[] = {
+            { "debug", LogLevel::Debug }, { "info", LogLevel::Info }, { "warning", LogLevel::Warning }, { "error", LogLevel::Error } };
+        for (const auto& entry : kNames) {
+            if (entry.first == name) {
+                level = entry.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Enabled(LogLevel level, LogCategory category) {
+        return static_cast<int>(level) >= minimumLevel.load(std::memory_order_relaxed)
+            && (enabledCategories.load(std::memory_order_relaxed) >> static_cast<int>(category) & 1)
+            && !shutDown.load(std::memory_order_relaxed);
+    }
+
+    void Flush() {
+        if (!shutDown) {
+            Instance().Drain();
+        }
+    }
+
+    Line::Line(LogLevel level, LogCategory category)
+        : text(CurrentThread().scratch), start(text.size()), level(level), category(category) {}
+
+    Line::~Line() {
+        // Lines built while this one was (from inside an argument) sit
+        // after `start` and have already been queued and removed
+        size_t size = std::min(text.size() - start, kMaxLineBytes);
+        ThreadRing& thread = CurrentThread();
+        if (!thread.ring) {
+            thread.ring = Instance().AddRing();
+        }
+
+        RecordHeader header{ static_cast<uint32_t>(size), level, category, NowUs() };
+        thread.ring->Push(header, text.data() + start);
+        text.resize(start);
+
+        if (level >= LogLevel::Warning || thread.ring->HalfFull()) {
+            Instance().Wake();
+        }
+    }
+
+    Line& Line::operator<<(double value) {
+        char digits[32];
+        int length = std::snprintf(digits, sizeof(digits), "%g", value);
+        text.append(digits, static_cast<size_t>(std::max(length, 0)));
+        return *this;
+    }
+}
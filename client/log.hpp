@@ -0,0 +1,88 @@
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Levels below this are compiled out, arguments and all. The default keeps
+// Info and up; build with -DLIMECHAT_LOG_LEVEL=0 to keep Debug lines too.
+#ifndef LIMECHAT_LOG_LEVEL
+#define LIMECHAT_LOG_LEVEL 1
+#endif
+
+enum class LogLevel : uint8_t { Debug, Info, Warning, Error };
+
+enum class LogCategory : uint8_t { General, Network, Protocol, Transfer, Storage, Count };
+
+// Diagnostics that never do I/O on the calling thread. Each thread formats
+// its lines into a lock-free ring of its own and one background thread
+// writes every ring out in batches. Arguments are only evaluated if the
+// line's level and category are enabled, and a full ring drops lines
+// (counted and reported) instead of blocking the caller.
+//
+//   LOG_WARNING(Network) << "Connect failed, Err #" << error;
+namespace logging {
+    void SetLevel(LogLevel level);
+    // Every category is enabled at start.
+    void SetCategoryEnabled(LogCategory category, bool enabled);
+    // Lines go to stderr unless sent to a file.
+    bool SetOutputFile(const std::string& path);
+    bool ParseLevel(std::string_view name, LogLevel& level);
+
+    bool Enabled(LogLevel level, LogCategory category);
+
+    // Returns once everything logged so far has been written.
+    void Flush();
+
+    // Formats one line into the thread's scratch buffer and queues it when
+    // it goes out of scope. Use through the LOG_ macros.
+    class Line {
+    private:
+        std::string& text;
+        size_t start;
+        LogLevel level;
+        LogCategory category;
+
+    public:
+        Line(LogLevel level, LogCategory category);
+        ~Line();
+
+        Line(const Line&) = delete;
+        Line& operator=(const Line&) = delete;
+
+        Line& operator<<(std::string_view value) {
+            text.append(value.data(), value.size());
+            return *this;
+        }
+        Line& operator<<(const char* value) { return *this << std::string_view(value ? value : "(null)"); }
+        Line& operator<<(const std::string& value) { return *this << std::string_view(value); }
+        Line& operator<<(char value) {
+            text += value;
+            return *this;
+        }
+        Line& operator<<(bool value) { return *this << (value ? "true" : "false"); }
+        Line& operator<<(double value);
+
+        template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+        Line& operator<<(T value) {
+            char digits[24];
+            auto result = std::to_chars(digits, digits + sizeof(digits), value);
+            text.append(digits, result.ptr);
+            return *this;
+        }
+    };
+}
+
+#define LIMECHAT_LOG(level, category) \
+    if (static_cast<int>(level) < LIMECHAT_LOG_LEVEL || !logging::Enabled(level, category)) {} \
+    else logging::Line(level, category)
+
+#define LOG_DEBUG(category) LIMECHAT_LOG(LogLevel::Debug, LogCategory::category)
+#define LOG_INFO(category) LIMECHAT_LOG(LogLevel::Info, LogCategory::category)
+#define LOG_WARNING(category) LIMECHAT_LOG(LogLevel::Warning, LogCategory::category)
+#define LOG_ERROR(category) LIMECHAT_LOG(LogLevel::Error, LogCategory::category)
+
+#endif // LOG_HPP
@@ -0,0 +1,101 @@
+#include "member_list.hpp"
+#include <algorithm>
+#include <cctype>
+
+bool MemberList::KeyLess::operator()(const Key& a, const Key& b) const {
+    if (a.status != b.status) {
+        return a.status < b.status;
+    }
+    size_t length = std::min(a.name.size(), b.name.size());
+    for (size_t i = 0; i < length; ++i) {
+        int left = std::tolower(static_cast<unsigned char>(a.name[i]));
+        int right = std::tolower(static_cast<unsigned char>(b.name[i]));
+        if (left != right) {
+            return left < right;
+        }
+    }
+    if (a.name.size() != b.name.size()) {
+        return a.name.size() < b.name.size();
+    }
+    // Names differing only in case still need an order
+    return a.name < b.name;
+}
+
+bool MemberList::Apply(std::string_view name, MemberStatus status) {
+    std::lock_guard<std::mutex> lock(mutex);
+    lookup.assign(name.data(), name.size());
+    auto it = statuses.find(lookup);
+    if (it == statuses.end()) {
+        if (status == MemberStatus::Offline) {
+            return false;
+        }
+        it = statuses.emplace(lookup, status).first;
+        order.Insert({ status, it->first });
+    }
+    else {
+        if (it->second == status) {
+            return false;
+        }
+        order.Erase({ it->second, it->first });
+        if (status == MemberStatus::Offline) {
+            statuses.erase(it);
+        }
+        else {
+            it->second = status;
+            order.Insert({ status, it->first });
+        }
+    }
+    version.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void MemberList::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    order.Clear();
+    statuses.clear();
+    version.fetch_add(1, std::memory_order_release);
+}
+
+size_t MemberList::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return order.size();
+}
+
+size_t MemberList::onlineCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return order.Rank({ MemberStatus::Away, std::string_view() });
+}
+
+void MemberList::Visit(size_t first, size_t count, const std::function<void(std::string_view name, MemberStatus status)>& visit) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    order.Visit(first, count, [&visit](const Key& key) {
+        visit(key.name, key.status);
+        });
+}
+
+bool MemberList::ParseStatus(std::string_view text, MemberStatus& status) {
+    if (text == "online") {
+        status = MemberStatus::Online;
+    }
+    else if (text == "away") {
+        status = MemberStatus::Away;
+    }
+    else if (text == "offline") {
+        status = MemberStatus::Offline;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+const char* MemberList::StatusName(MemberStatus status) {
+    switch (status) {
+    case MemberStatus::Online:
+        return "online";
+    case MemberStatus::Away:
+        return "away";
+    default:
+        return "offline";
+    }
+}
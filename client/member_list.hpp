@@ -0,0 +1,56 @@
+#ifndef MEMBER_LIST_HPP
+#define MEMBER_LIST_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "ranked_set.hpp"
+
+enum class MemberStatus : uint8_t { Online, Away, Offline };
+
+// Who is on the server, kept in display order (online before away, then by
+// name, ignoring case) as presence changes come in one at a time. A change
+// is O(log n), and so is finding the rows a list view shows, so a roster of
+// tens of thousands never has to be copied or sorted again.
+class MemberList {
+private:
+    struct Key {
+        MemberStatus status;
+        std::string_view name; // Into the key of `statuses`
+    };
+
+    struct KeyLess {
+        bool operator()(const Key& a, const Key& b) const;
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, MemberStatus> statuses;
+    RankedSet<Key, KeyLess> order;
+    std::string lookup;
+    std::atomic<uint64_t> version{ 0 };
+
+public:
+    // Offline takes the member out. Returns false if nothing changed.
+    bool Apply(std::string_view name, MemberStatus status);
+    void Clear();
+
+    size_t size() const;
+    // How many are online; everyone after them in display order is away.
+    size_t onlineCount() const;
+
+    // Calls `visit` for up to `count` members in display order, from
+    // position `first`.
+    void Visit(size_t first, size_t count, const std::function<void(std::string_view name, MemberStatus status)>& visit) const;
+
+    // Goes up on every change, so a view can tell when to fetch its rows again.
+    uint64_t getVersion() const { return version.load(std::memory_order_acquire); }
+
+    static bool ParseStatus(std::string_view text, MemberStatus& status);
+    static const char* StatusName(MemberStatus status);
+};
+
+#endif // MEMBER_LIST_HPP
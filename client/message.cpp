@@ -0,0 +1,161 @@
+#include "message.hpp"
+#include <chrono>
+#include <charconv>
+#include <cstring>
+
+namespace {
+    const size_t kHeaderSize = sizeof(uint64_t) + sizeof(int64_t) + 3 * sizeof(uint32_t);
+
+    // Splits off the text up to the next '|'.
+    bool NextField(std::string_view& rest, std::string_view& field) {
+        size_t end = rest.find('|');
+        if (end == std::string_view::npos) {
+            return false;
+        }
+        field = rest.substr(0, end);
+        rest.remove_prefix(end + 1);
+        return true;
+    }
+
+    template <typename T>
+    bool ParseNumber(std::string_view text, T& out) {
+        const char* last = text.data() + text.size();
+        auto result = std::from_chars(text.data(), last, out);
+        return !text.empty() && result.ec == std::errc() && result.ptr == last;
+    }
+}
+
+uint32_t UserTable::Intern(std::string_view name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+        return it->second;
+    }
+
+    // Deque elements never move, so the key can view the stored name
+    names.emplace_back(name);
+    uint32_t userId = static_cast<uint32_t>(names.size());
+    ids.emplace(names.back(), userId);
+    return userId;
+}
+
+std::string_view UserTable::Name(uint32_t userId) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (userId == 0 || userId > names.size()) {
+        return std::string_view();
+    }
+    return names[userId - 1];
+}
+
+size_t UserTable::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return names.size();
+}
+
+bool ParseMessageLine(std::string_view line, Message& out, std::string_view& user) {
+    std::string_view rest = line;
+    std::string_view tag, id, channel, timestamp;
+    if (!NextField(rest, tag) || tag != "MSG" || !NextField(rest, id) || !NextField(rest, channel)
+        || !NextField(rest, timestamp) || !NextField(rest, user)) {
+        return false;
+    }
+
+    Message message;
+    if (!ParseNumber(id, message.id) || !ParseNumber(channel, message.channel) || !ParseNumber(timestamp, message.timestampMs)) {
+        return false;
+    }
+
+    // The body is last, so it may itself contain '|'
+    message.body = rest;
+    out = message;
+    return true;
+}
+
+void EncodeMessage(const Message& message, std::string& out) {
+    out.resize(kHeaderSize + message.body.size());
+    char* dest = &out[0];
+    std::memcpy(dest, &message.id, sizeof(message.id));
+    dest += sizeof(message.id);
+    std::memcpy(dest, &message.timestampMs, sizeof(message.timestampMs));
+    dest += sizeof(message.timestampMs);
+    std::memcpy(dest, &message.channel, sizeof(message.channel));
+    dest += sizeof(message.channel);
+    std::memcpy(dest, &message.userId, sizeof(message.userId));
+    dest += sizeof(message.userId);
+    std::memcpy(dest, &message.flags, sizeof(message.flags));
+    dest += sizeof(message.flags);
+    if (!message.body.empty()) {
+        std::memcpy(dest, message.body.data(), message.body.size());
+    }
+}
+
+Message DecodeMessage(std::string_view stored) {
+    Message message;
+    if (stored.size() < kHeaderSize) {
+        return message;
+    }
+
+    const char* src = stored.data();
+    std::memcpy(&message.id, src, sizeof(message.id));
+    src += sizeof(message.id);
+    std::memcpy(&message.timestampMs, src, sizeof(message.timestampMs));
+    src += sizeof(message.timestampMs);
+    std::memcpy(&message.channel, src, sizeof(message.channel));
+    src += sizeof(message.channel);
+    std::memcpy(&message.userId, src, sizeof(message.userId));
+    src += sizeof(message.userId);
+    std::memcpy(&message.flags, src, sizeof(message.flags));
+    message.body = stored.substr(kHeaderSize);
+    return message;
+}
+
+std::string EscapeBody(std::string_view body) {
+    std::string escaped;
+    escaped.reserve(body.size());
+    for (char c : body) {
+        switch (c) {
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\r': escaped += "\\r"; break;
+        default: escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+bool UnescapeBody(std::string_view body, std::string& out) {
+    size_t backslash = body.find('\\');
+    if (backslash == std::string_view::npos) {
+        return false;
+    }
+
+    out.assign(body.data(), backslash);
+    for (size_t i = backslash; i < body.size(); ++i) {
+        char c = body[i];
+        if (c != '\\' || i + 1 == body.size()) {
+            out += c;
+            continue;
+        }
+        char next = body[++i];
+        if (next == 'n') {
+            out += '\n';
+        }
+        else if (next == 'r') {
+            out += '\r';
+        }
+        else if (next == '\\') {
+            out += '\\';
+        }
+        else {
+            // Not an escape this client knows; kept as written
+            out += c;
+            out += next;
+        }
+    }
+    return true;
+}
+
+int64_t CurrentTimeMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,61 @@
+#ifndef MESSAGE_HPP
+#define MESSAGE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+enum MessageFlags : uint32_t {
+    kMessageEdited = 1,
+    kMessageDeleted = 2,
+};
+
+// A chat message as parsed once at ingest. The body is a view into the
+// message store and is only valid while the store is locked.
+struct Message {
+    uint64_t id = 0;          // Server-assigned, 0 for local or legacy lines
+    uint32_t channel = 0;
+    int64_t timestampMs = 0;  // Unix epoch, milliseconds
+    uint32_t userId = 0;      // Index into a UserTable, 0 when unknown
+    uint32_t flags = 0;       // MessageFlags
+    std::string_view body;
+};
+
+// Gives every distinct username a small integer, so messages carry four
+// bytes instead of a copy of the name. IDs start at 1; 0 means no user.
+class UserTable {
+private:
+    mutable std::mutex mutex;
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, uint32_t> ids;
+
+public:
+    uint32_t Intern(std::string_view name);
+
+    // The view stays valid for the life of the table.
+    std::string_view Name(uint32_t userId) const;
+
+    size_t size() const;
+};
+
+// Parses the structured wire format "MSG|id|channel|epoch ms|user|body".
+// Returns false for anything else, which callers treat as a legacy line.
+bool ParseMessageLine(std::string_view line, Message& out, std::string_view& user);
+
+// Fixed-width header followed by the body; this is what the message store
+// keeps, so stored messages can be read back without parsing text.
+void EncodeMessage(const Message& message, std::string& out);
+Message DecodeMessage(std::string_view stored);
+
+// Message bodies travel as one line, so line breaks are sent as a backslash
+// followed by 'n' or 'r', and backslashes are doubled.
+std::string EscapeBody(std::string_view body);
+// Returns false, leaving `out` untouched, if there is nothing to unescape.
+bool UnescapeBody(std::string_view body, std::string& out);
+
+int64_t CurrentTimeMs();
+
+#endif // MESSAGE_HPP
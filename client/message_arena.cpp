@@ -0,0 +1,75 @@
+#include "message_arena.hpp"
+#include <algorithm>
+#include <cstring>
+
+MessageArena::MessageArena(size_t chunkSize, size_t maxSpareChunks)
+    : chunkSize(std::max<size_t>(chunkSize, 1)), maxSpareChunks(maxSpareChunks), reservedBytes(0) {}
+
+MessageArena::Chunk& MessageArena::ChunkFor(size_t size) {
+    if (!chunks.empty() && chunks.back().capacity - chunks.back().used >= size) {
+        return chunks.back();
+    }
+
+    // A lone chunk emptied by ReleaseOldest that is too small for this
+    // message goes, so no dead chunk is left at the front
+    if (!chunks.empty() && chunks.back().live == 0) {
+        Retire(chunks.back());
+        chunks.pop_back();
+    }
+
+    // Reuse a retired chunk when it is big enough; messages larger than a
+    // chunk get one of their own, which is freed rather than kept as spare.
+    if (!spare.empty() && spare.back().capacity >= size) {
+        chunks.push_back(std::move(spare.back()));
+        spare.pop_back();
+    }
+    else {
+        Chunk chunk;
+        chunk.capacity = std::max(chunkSize, size);
+        chunk.data.reset(new char[chunk.capacity]);
+        reservedBytes += chunk.capacity;
+        chunks.push_back(std::move(chunk));
+    }
+    return chunks.back();
+}
+
+std::string_view MessageArena::Store(std::string_view text) {
+    Chunk& chunk = ChunkFor(text.size());
+    char* dest = chunk.data.get() + chunk.used;
+    if (!text.empty()) {
+        std::memcpy(dest, text.data(), text.size());
+    }
+    chunk.used += text.size();
+    chunk.live++;
+    return std::string_view(dest, text.size());
+}
+
+void MessageArena::ReleaseOldest() {
+    if (chunks.empty() || chunks.front().live == 0) {
+        return;
+    }
+
+    Chunk& oldest = chunks.front();
+    if (--oldest.live > 0) {
+        return;
+    }
+
+    // Keep writing into the newest chunk instead of retiring it
+    if (chunks.size() == 1) {
+        oldest.used = 0;
+        return;
+    }
+
+    Retire(oldest);
+    chunks.pop_front();
+}
+
+void MessageArena::Retire(Chunk& chunk) {
+    if (chunk.capacity == chunkSize && spare.size() < maxSpareChunks) {
+        chunk.used = 0;
+        spare.push_back(std::move(chunk));
+    }
+    else {
+        reservedBytes -= chunk.capacity;
+    }
+}
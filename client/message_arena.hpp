@@ -0,0 +1,49 @@
+#ifndef MESSAGE_ARENA_HPP
+#define MESSAGE_ARENA_HPP
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only storage for message bodies. Text is copied into large chunks
+// and handed back as views, so storing a message costs no allocation once
+// the arena has warmed up. Messages must be released in the order they were
+// stored; a chunk is recycled as soon as everything in it has been released.
+class MessageArena {
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t capacity = 0;
+        size_t used = 0;
+        size_t live = 0;
+    };
+
+    size_t chunkSize;
+    size_t maxSpareChunks;
+    std::deque<Chunk> chunks;
+    std::vector<Chunk> spare;
+    size_t reservedBytes;
+
+    Chunk& ChunkFor(size_t size);
+    // Keeps an emptied chunk as spare or frees it; the caller removes it.
+    void Retire(Chunk& chunk);
+
+public:
+    explicit MessageArena(size_t chunkSize = 64 * 1024, size_t maxSpareChunks = 4);
+
+    MessageArena(const MessageArena&) = delete;
+    MessageArena& operator=(const MessageArena&) = delete;
+
+    // The view stays valid until it is released.
+    std::string_view Store(std::string_view text);
+
+    // Releases the oldest message still held.
+    void ReleaseOldest();
+
+    size_t chunkCount() const { return chunks.size(); }
+    size_t bytesReserved() const { return reservedBytes; }
+};
+
+#endif // MESSAGE_ARENA_HPP
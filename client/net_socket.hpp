@@ -0,0 +1,83 @@
+#ifndef NET_SOCKET_HPP
+#define NET_SOCKET_HPP
+
+// The few socket calls the client needs, spelled the Winsock way on every
+// platform.
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+
+inline int LastSocketError() { return WSAGetLastError(); }
+inline bool SocketWouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+inline bool ConnectInProgress() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+inline int PollSockets(WSAPOLLFD* fds, unsigned long count, int timeoutMs) { return WSAPoll(fds, count, timeoutMs); }
+typedef WSAPOLLFD PollFd;
+const int SEND_NO_SIGNAL = 0;
+
+inline bool SetNonBlocking(SOCKET socketHandle, bool nonBlocking) {
+    u_long mode = nonBlocking ? 1 : 0;
+    return ioctlsocket(socketHandle, FIONBIO, &mode) == 0;
+}
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef int SOCKET;
+typedef struct pollfd PollFd;
+const SOCKET INVALID_SOCKET = -1;
+const int SOCKET_ERROR = -1;
+const int SD_BOTH = SHUT_RDWR;
+#ifdef MSG_NOSIGNAL
+const int SEND_NO_SIGNAL = MSG_NOSIGNAL;
+#else
+const int SEND_NO_SIGNAL = 0;
+#endif
+
+inline int closesocket(SOCKET socketHandle) { return close(socketHandle); }
+inline int LastSocketError() { return errno; }
+inline bool SocketWouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+inline bool ConnectInProgress() { return errno == EINPROGRESS; }
+inline int PollSockets(PollFd* fds, unsigned long count, int timeoutMs) { return poll(fds, count, timeoutMs); }
+
+inline bool SetNonBlocking(SOCKET socketHandle, bool nonBlocking) {
+    int flags = fcntl(socketHandle, F_GETFL, 0);
+    if (flags < 0) {
+        return false;
+    }
+    flags = nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(socketHandle, F_SETFL, flags) == 0;
+}
+#endif
+
+// A peer that hangs up mid-write must show up as a failed send, not kill
+// the process. SEND_NO_SIGNAL covers plain send() on Linux; the rest
+// (macOS, SSL_write, sendfile) needs SIGPIPE ignored process-wide, which
+// both mains do first thing.
+inline void IgnoreBrokenPipes() {
+#ifndef _WIN32
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+}
+
+// Waits until the socket can be read (or written). Returns false on
+// timeout or error.
+inline bool WaitForSocket(SOCKET socketHandle, bool forWrite, int timeoutMs) {
+    PollFd fd{};
+    fd.fd = socketHandle;
+    fd.events = forWrite ? POLLOUT : POLLIN;
+    return PollSockets(&fd, 1, timeoutMs) > 0;
+}
+
+#endif // NET_SOCKET_HPP
@@ -0,0 +1,295 @@
+#include "network_loop.hpp"
+#include "lime_chat.hpp"
+#include <algorithm>
+#include <random>
+
+namespace {
+    const std::chrono::milliseconds kReconnectDelayMin(500);
+    const std::chrono::milliseconds kReconnectDelayMax(30000);
+    // Upper bound on a poll, so new connections and timers are picked up
+    const std::chrono::milliseconds kPollInterval(50);
+    const size_t kReceiveBufferSize = 64 * 1024;
+}
+
+NetworkLoop::NetworkLoop() : stopping(false), receiveBuffer(kReceiveBufferSize) {}
+
+NetworkLoop::~NetworkLoop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    connectWake.notify_all();
+    uploadWake.notify_all();
+
+    for (std::thread* thread : { &ioThread, &connectThread, &uploadThread }) {
+        if (thread->joinable()) {
+            thread->join();
+        }
+    }
+}
+
+NetworkLoop& NetworkLoop::Shared() {
+    static NetworkLoop loop;
+    return loop;
+}
+
+void NetworkLoop::StartThreads() {
+    if (!ioThread.joinable()) {
+        ioThread = std::thread(&NetworkLoop::IoLoop, this);
+        connectThread = std::thread(&NetworkLoop::ConnectLoop, this);
+        uploadThread = std::thread(&NetworkLoop::UploadLoop, this);
+    }
+}
+
+NetworkLoop::Entry* NetworkLoop::Find(LimeChat* session) {
+    auto it = std::find_if(entries.begin(), entries.end(), [session](const std::unique_ptr<Entry>& entry) {
+        return entry->session == session;
+        });
+    return it != entries.end() ? it->get() : nullptr;
+}
+
+void NetworkLoop::Add(LimeChat* session) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Find(session)) {
+        return;
+    }
+
+    auto entry = std::make_unique<Entry>();
+    entry->session = session;
+    entry->backoff = kReconnectDelayMin;
+    entry->nextAttempt = Clock::now();
+    entries.push_back(std::move(entry));
+    StartThreads();
+}
+
+void NetworkLoop::Remove(LimeChat* session) {
+    std::unique_lock<std::mutex> lock(mutex);
+    Entry* entry = Find(session);
+    if (!entry) {
+        return;
+    }
+
+    uploads.erase(std::remove_if(uploads.begin(), uploads.end(), [session](const UploadJob& job) {
+        return job.session == session;
+        }), uploads.end());
+    frameJobs.erase(std::remove(frameJobs.begin(), frameJobs.end(), session), frameJobs.end());
+    released.wait(lock, [entry] { return entry->users == 0; });
+
+    entries.erase(std::find_if(entries.begin(), entries.end(), [entry](const std::unique_ptr<Entry>& candidate) {
+        return candidate.get() == entry;
+        }));
+}
+
+size_t NetworkLoop::sessionCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+void NetworkLoop::QueueUpload(LimeChat* session, uint64_t transferId, uint64_t offset) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uploads.push_back({ session, transferId, offset });
+    }
+    uploadWake.notify_one();
+}
+
+void NetworkLoop::ClearUploads(LimeChat* session) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uploads.erase(std::remove_if(uploads.begin(), uploads.end(), [session](const UploadJob& job) {
+        return job.session == session;
+        }), uploads.end());
+}
+
+void NetworkLoop::QueueFrames(LimeChat* session) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (std::find(frameJobs.begin(), frameJobs.end(), session) != frameJobs.end()) {
+            return; // The queued job sends these too
+        }
+        frameJobs.push_back(session);
+    }
+    uploadWake.notify_one();
+}
+
+void NetworkLoop::ScheduleReconnect(Entry& entry, bool failedAttempt) {
+    // Exponential backoff with jitter, so clients dropped together don't all
+    // come back in the same instant. The first retry after a drop is immediate.
+    static std::mt19937 random(std::random_device{}());
+
+    entry.state = State::Offline;
+    if (!failedAttempt) {
+        entry.backoff = kReconnectDelayMin;
+        entry.nextAttempt = Clock::now();
+        return;
+    }
+
+    std::uniform_int_distribution<long long> jitter(entry.backoff.count() / 2, entry.backoff.count());
+    entry.nextAttempt = Clock::now() + std::chrono::milliseconds(jitter(random));
+    entry.backoff = std::min(entry.backoff * 2, kReconnectDelayMax);
+}
+
+void NetworkLoop::IoLoop() {
+    std::vector<PollFd> fds;
+    std::vector<Entry*> polled;
+    std::vector<Entry*> heartbeats;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        Clock::time_point now = Clock::now();
+        Clock::time_point wakeUp = now + kPollInterval;
+        bool buffered = false;
+        fds.clear();
+        polled.clear();
+        heartbeats.clear();
+
+        for (const auto& owned : entries) {
+            Entry& entry = *owned;
+            LimeChat* session = entry.session;
+
+            // Dropped by a failed send or the heartbeat rather than a read
+            if (entry.state == State::Online && !session->isConnected()) {
+                session->OnDisconnected();
+                ScheduleReconnect(entry, false);
+            }
+            if (entry.state == State::Offline && session->isRunning() && now >= entry.nextAttempt) {
+                entry.state = State::Connecting;
+                connectWake.notify_one();
+            }
+            if (entry.state != State::Online) {
+                continue;
+            }
+
+            int intervalMs = session->heartbeatIntervalMs();
+            if (intervalMs > 0) {
+                if (now >= entry.nextHeartbeat) {
+                    heartbeats.push_back(&entry);
+                    entry.nextHeartbeat = now + std::chrono::milliseconds(intervalMs);
+                }
+                wakeUp = std::min(wakeUp, entry.nextHeartbeat);
+            }
+
+            PollFd fd{};
+            fd.fd = session->PollHandle();
+            fd.events = POLLIN;
+            fds.push_back(fd);
+            polled.push_back(&entry);
+            entry.users++;
+            buffered = buffered || session->HasBufferedData();
+        }
+        for (Entry* entry : heartbeats) {
+            entry->users++;
+        }
+
+        // Sessions are used with the lock released, so they can queue
+        // uploads; Remove() waits for `users` to drop back to zero
+        lock.unlock();
+        for (Entry* entry : heartbeats) {
+            entry->session->Heartbeat();
+        }
+
+        if (fds.empty()) {
+            std::this_thread::sleep_until(wakeUp);
+        }
+        else {
+            auto waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(wakeUp - Clock::now()).count();
+            PollSockets(fds.data(), static_cast<unsigned long>(fds.size()), buffered ? 0 : static_cast<int>(std::max<long long>(0, waitMs)));
+        }
+
+        std::vector<bool> dropped(polled.size(), false);
+        for (size_t i = 0; i < polled.size(); ++i) {
+            LimeChat* session = polled[i]->session;
+            if ((fds[i].revents != 0 || session->HasBufferedData()) && session->isConnected()) {
+                dropped[i] = !session->ReadAvailable(receiveBuffer.data(), receiveBuffer.size());
+            }
+        }
+
+        lock.lock();
+        for (size_t i = 0; i < polled.size(); ++i) {
+            if (dropped[i]) {
+                polled[i]->session->OnDisconnected();
+                ScheduleReconnect(*polled[i], false);
+            }
+            polled[i]->users--;
+        }
+        for (Entry* entry : heartbeats) {
+            entry->users--;
+        }
+        released.notify_all();
+    }
+}
+
+void NetworkLoop::ConnectLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        auto it = std::find_if(entries.begin(), entries.end(), [](const std::unique_ptr<Entry>& entry) {
+            return entry->state == State::Connecting && !entry->connecting;
+            });
+        if (it == entries.end()) {
+            connectWake.wait(lock);
+            continue;
+        }
+
+        Entry& entry = **it;
+        entry.connecting = true;
+        entry.users++;
+        lock.unlock();
+
+        bool online = entry.session->isRunning() && entry.session->ConnectAndLogIn();
+
+        lock.lock();
+        entry.connecting = false;
+        entry.users--;
+        if (online) {
+            entry.state = State::Online;
+            entry.backoff = kReconnectDelayMin;
+            entry.nextHeartbeat = Clock::now() + std::chrono::milliseconds(entry.session->heartbeatIntervalMs());
+        }
+        else {
+            ScheduleReconnect(entry, true);
+        }
+        released.notify_all();
+    }
+}
+
+void NetworkLoop::UploadLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        if (frameJobs.empty() && uploads.empty()) {
+            uploadWake.wait(lock);
+            continue;
+        }
+
+        // Frames go first; a file sends one chunk and then waits its turn
+        // again, so one big attachment can't hold up the rest
+        bool frames = !frameJobs.empty();
+        UploadJob job{};
+        if (frames) {
+            job.session = frameJobs.front();
+            frameJobs.pop_front();
+        }
+        else {
+            job = uploads.front();
+            uploads.pop_front();
+        }
+        Entry* entry = Find(job.session);
+        if (!entry) {
+            continue;
+        }
+
+        entry->users++;
+        lock.unlock();
+        bool more = false;
+        if (frames) {
+            job.session->SendQueuedFrames();
+        }
+        else {
+            more = job.session->UploadChunk(job.transferId, job.offset);
+        }
+        lock.lock();
+        if (more) {
+            uploads.push_back(job);
+        }
+        entry->users--;
+        released.notify_all();
+    }
+}
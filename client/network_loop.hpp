@@ -0,0 +1,89 @@
+#ifndef NETWORK_LOOP_HPP
+#define NETWORK_LOOP_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class LimeChat;
+
+// Drives every chat session in the process from three threads, however
+// many sessions there are:
+//   - the I/O thread polls all connected sockets, reads into one shared
+//     buffer and runs the heartbeat timers;
+//   - the connect thread dials, handshakes and logs in, with backoff, so a
+//     slow server never holds up the others;
+//   - the upload thread sends the frames of long chat lines and streams
+//     attachments a chunk per job, so frames never wait behind a file.
+class NetworkLoop {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class State { Offline, Connecting, Online };
+
+    struct Entry {
+        LimeChat* session;
+        State state = State::Offline;
+        Clock::time_point nextAttempt;
+        std::chrono::milliseconds backoff;
+        Clock::time_point nextHeartbeat;
+        bool connecting = false;
+        int users = 0; // Loop threads using the session with the lock released
+    };
+
+    struct UploadJob {
+        LimeChat* session;
+        uint64_t transferId;
+        uint64_t offset;
+    };
+
+    std::vector<std::unique_ptr<Entry>> entries;
+    std::deque<UploadJob> uploads;
+    std::deque<LimeChat*> frameJobs; // Sessions with frames to send, served first
+    std::mutex mutex;
+    std::condition_variable connectWake;
+    std::condition_variable uploadWake;
+    std::condition_variable released;
+    bool stopping;
+    std::thread ioThread;
+    std::thread connectThread;
+    std::thread uploadThread;
+    std::vector<char> receiveBuffer;
+
+    void IoLoop();
+    void ConnectLoop();
+    void UploadLoop();
+    void StartThreads();
+    Entry* Find(LimeChat* session);
+    void ScheduleReconnect(Entry& entry, bool failedAttempt);
+
+public:
+    NetworkLoop();
+    ~NetworkLoop();
+
+    NetworkLoop(const NetworkLoop&) = delete;
+    NetworkLoop& operator=(const NetworkLoop&) = delete;
+
+    // The loop every session uses unless given another.
+    static NetworkLoop& Shared();
+
+    // The session is connected, kept connected and read from until Remove().
+    void Add(LimeChat* session);
+    // Returns once no loop thread is using the session any more.
+    void Remove(LimeChat* session);
+
+    void QueueUpload(LimeChat* session, uint64_t transferId, uint64_t offset);
+    // Drops queued resumes, which are asked for again after a reconnect.
+    void ClearUploads(LimeChat* session);
+    // Has the upload thread send the session's queued frames.
+    void QueueFrames(LimeChat* session);
+
+    size_t sessionCount();
+};
+
+#endif // NETWORK_LOOP_HPP
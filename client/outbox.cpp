@@ -0,0 +1,194 @@
+#include "outbox.hpp"
+#include "log.hpp"
+#include <filesystem>
+#include <random>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const char kEntryRecord = 'M';
+    const char kAckRecord = 'A';
+
+    // Forces what was written to the file out to the disk
+    bool SyncFile(const std::string& path) {
+#ifdef _WIN32
+        HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        bool synced = FlushFileBuffers(handle) != 0;
+        CloseHandle(handle);
+#else
+        int handle = open(path.c_str(), O_WRONLY);
+        if (handle < 0) {
+            return false;
+        }
+        bool synced = fsync(handle) == 0;
+        close(handle);
+#endif
+        return synced;
+    }
+}
+
+Outbox::Outbox(const std::string& journalPath)
+    : journalPath(journalPath), nextOrder(0), journaledAcks(0) {
+    // IDs only need to be unique per user: a random high half per session
+    // and a counter below it.
+    std::random_device seed;
+    nextId = (static_cast<uint64_t>(seed()) << 32) | 1;
+
+    Load();
+}
+
+void Outbox::Load() {
+    std::ifstream in(journalPath, std::ios::binary);
+    while (in) {
+        char type = 0;
+        uint64_t clientId = 0;
+        if (!in.read(&type, 1) || !in.read(reinterpret_cast<char*>(&clientId), sizeof(clientId))) {
+            break;
+        }
+
+        if (type == kEntryRecord) {
+            uint32_t length = 0;
+            std::string content;
+            if (!in.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+                break;
+            }
+            content.resize(length);
+            if (length > 0 && !in.read(&content[0], length)) {
+                break; // Torn write at the end of the journal
+            }
+            Insert(clientId, std::move(content));
+        }
+        else if (type == kAckRecord) {
+            auto it = orderById.find(clientId);
+            if (it != orderById.end()) {
+                pending.erase(it->second);
+                orderById.erase(it);
+            }
+        }
+        else {
+            LOG_WARNING(Storage) << "Outbox journal " << journalPath << " is corrupt, keeping what was read";
+            break;
+        }
+    }
+    in.close();
+
+    if (!pending.empty()) {
+        LOG_INFO(Storage) << pending.size() << " unsent message(s) waiting in the outbox";
+    }
+
+    // Start every session from a journal holding only what is still pending
+    Compact();
+}
+
+void Outbox::Compact() {
+    // The compacted copy only replaces the journal once it is on disk, so a
+    // crash part way through loses nothing
+    std::string tempPath = journalPath + ".tmp";
+    bool written;
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        for (const auto& entry : pending) {
+            WriteEntry(out, entry.second.clientId, entry.second.content);
+        }
+        out.close();
+        written = !out.fail();
+    }
+
+    journal.close();
+    std::error_code error;
+    if (written && SyncFile(tempPath)) {
+        std::filesystem::rename(tempPath, journalPath, error);
+    }
+    else {
+        error = std::make_error_code(std::errc::io_error);
+    }
+    if (error) {
+        LOG_WARNING(Storage) << "Can't compact outbox journal " << journalPath << ", keeping it as it is";
+        std::filesystem::remove(tempPath, error);
+    }
+    else {
+        journaledAcks = 0;
+    }
+
+    journal.open(journalPath, std::ios::out | std::ios::binary | std::ios::app);
+    if (!journal.is_open()) {
+        LOG_ERROR(Storage) << "Can't open outbox journal " << journalPath << ", unsent messages won't survive a restart";
+    }
+}
+
+void Outbox::Insert(uint64_t clientId, std::string content) {
+    if (orderById.count(clientId)) {
+        return;
+    }
+    orderById[clientId] = nextOrder;
+    pending[nextOrder++] = { clientId, std::move(content) };
+}
+
+void Outbox::WriteEntry(std::ostream& out, uint64_t clientId, const std::string& content) {
+    uint32_t length = static_cast<uint32_t>(content.size());
+    out.write(&kEntryRecord, 1);
+    out.write(reinterpret_cast<const char*>(&clientId), sizeof(clientId));
+    out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.write(content.data(), length);
+}
+
+void Outbox::WriteAck(uint64_t clientId) {
+    journal.write(&kAckRecord, 1);
+    journal.write(reinterpret_cast<const char*>(&clientId), sizeof(clientId));
+}
+
+uint64_t Outbox::Add(const std::string& content) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t clientId = nextId++;
+    Insert(clientId, content);
+
+    if (journal.is_open()) {
+        WriteEntry(journal, clientId, content);
+        journal.flush();
+    }
+    return clientId;
+}
+
+bool Outbox::Acknowledge(uint64_t clientId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = orderById.find(clientId);
+    if (it == orderById.end()) {
+        return false;
+    }
+    pending.erase(it->second);
+    orderById.erase(it);
+
+    if (journal.is_open()) {
+        WriteAck(clientId);
+        journal.flush();
+        journaledAcks++;
+
+        // Rewrite once acknowledged records dominate the journal
+        if (journaledAcks > 64 && journaledAcks > 2 * pending.size()) {
+            Compact();
+        }
+    }
+    return true;
+}
+
+std::vector<Outbox::Entry> Outbox::Pending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Entry> entries;
+    entries.reserve(pending.size());
+    for (const auto& entry : pending) {
+        entries.push_back(entry.second);
+    }
+    return entries;
+}
+
+size_t Outbox::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending.size();
+}
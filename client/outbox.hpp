@@ -0,0 +1,57 @@
+#ifndef OUTBOX_HPP
+#define OUTBOX_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Outgoing messages that the server has not acknowledged yet. Every message
+// gets a client ID and is journaled to disk before it is sent, so it
+// survives a dropped connection or a restart and is replayed until the
+// server answers "ACK|<id>". The server uses the ID to drop repeats.
+class Outbox {
+public:
+    struct Entry {
+        uint64_t clientId;
+        std::string content;
+    };
+
+private:
+    std::string journalPath;
+    std::fstream journal;
+    std::map<uint64_t, Entry> pending; // Keyed by the order they were added
+    std::unordered_map<uint64_t, uint64_t> orderById;
+    uint64_t nextOrder;
+    uint64_t nextId;
+    size_t journaledAcks;
+    mutable std::mutex mutex;
+
+    void Load();
+    void Compact();
+    void Insert(uint64_t clientId, std::string content);
+    void WriteEntry(std::ostream& out, uint64_t clientId, const std::string& content);
+    void WriteAck(uint64_t clientId);
+
+public:
+    explicit Outbox(const std::string& journalPath = "limechat_outbox");
+
+    Outbox(const Outbox&) = delete;
+    Outbox& operator=(const Outbox&) = delete;
+
+    // Journals the message and returns its client ID.
+    uint64_t Add(const std::string& content);
+
+    // Returns false if the ID was not pending, e.g. a repeated ACK.
+    bool Acknowledge(uint64_t clientId);
+
+    // Oldest first.
+    std::vector<Entry> Pending() const;
+
+    size_t size() const;
+};
+
+#endif // OUTBOX_HPP
@@ -0,0 +1,239 @@
+#ifndef RANKED_SET_HPP
+#define RANKED_SET_HPP
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Sorted set that can also find the element at a given position and the
+// position of a given element, all in O(log n): a treap whose nodes count
+// the size of their subtree. Nodes live in one vector and link by index,
+// so a set that churns reuses freed slots instead of allocating.
+template <typename Key, typename Less = std::less<Key>>
+class RankedSet {
+private:
+    static const uint32_t kNone = UINT32_MAX;
+
+    struct Node {
+        Key key;
+        uint32_t priority;
+        uint32_t size;
+        uint32_t left;
+        uint32_t right;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> freeNodes;
+    uint32_t root = kNone;
+    uint32_t seed = 0x9E3779B9u;
+    Less less;
+
+    uint32_t SizeOf(uint32_t node) const { return node == kNone ? 0 : nodes[node].size; }
+
+    void Update(uint32_t node) {
+        nodes[node].size = 1 + SizeOf(nodes[node].left) + SizeOf(nodes[node].right);
+    }
+
+    uint32_t NextPriority() {
+        // xorshift32; the treap only needs priorities that don't follow the keys
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    uint32_t Allocate(const Key& key) {
+        Node node{ key, NextPriority(), 1, kNone, kNone };
+        if (freeNodes.empty()) {
+            nodes.push_back(std::move(node));
+            return static_cast<uint32_t>(nodes.size() - 1);
+        }
+        uint32_t index = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[index] = std::move(node);
+        return index;
+    }
+
+    // Splits the subtree into the keys before `key` and the rest.
+    void Split(uint32_t node, const Key& key, uint32_t& before, uint32_t& rest) {
+        if (node == kNone) {
+            before = rest = kNone;
+            return;
+        }
+        if (less(nodes[node].key, key)) {
+            Split(nodes[node].right, key, nodes[node].right, rest);
+            before = node;
+        }
+        else {
+            Split(nodes[node].left, key, before, nodes[node].left);
+            rest = node;
+        }
+        Update(node);
+    }
+
+    // Every key in `before` sorts ahead of every key in `after`.
+    uint32_t Merge(uint32_t before, uint32_t after) {
+        if (before == kNone || after == kNone) {
+            return before == kNone ? after : before;
+        }
+        if (nodes[before].priority > nodes[after].priority) {
+            nodes[before].right = Merge(nodes[before].right, after);
+            Update(before);
+            return before;
+        }
+        nodes[after].left = Merge(before, nodes[after].left);
+        Update(after);
+        return after;
+    }
+
+    uint32_t InsertAt(uint32_t node, uint32_t fresh) {
+        if (node == kNone) {
+            return fresh;
+        }
+        if (nodes[fresh].priority > nodes[node].priority) {
+            Split(node, nodes[fresh].key, nodes[fresh].left, nodes[fresh].right);
+            Update(fresh);
+            return fresh;
+        }
+        if (less(nodes[fresh].key, nodes[node].key)) {
+            nodes[node].left = InsertAt(nodes[node].left, fresh);
+        }
+        else {
+            nodes[node].right = InsertAt(nodes[node].right, fresh);
+        }
+        Update(node);
+        return node;
+    }
+
+    uint32_t EraseAt(uint32_t node, const Key& key, bool& erased) {
+        if (node == kNone) {
+            return kNone;
+        }
+        if (less(key, nodes[node].key)) {
+            nodes[node].left = EraseAt(nodes[node].left, key, erased);
+        }
+        else if (less(nodes[node].key, key)) {
+            nodes[node].right = EraseAt(nodes[node].right, key, erased);
+        }
+        else {
+            erased = true;
+            uint32_t merged = Merge(nodes[node].left, nodes[node].right);
+            freeNodes.push_back(node);
+            return merged;
+        }
+        Update(node);
+        return node;
+    }
+
+public:
+    size_t size() const { return SizeOf(root); }
+    bool empty() const { return root == kNone; }
+
+    void Clear() {
+        nodes.clear();
+        freeNodes.clear();
+        root = kNone;
+    }
+
+    // Returns false, changing nothing, if the key is already there.
+    bool Insert(const Key& key) {
+        if (Contains(key)) {
+            return false;
+        }
+        uint32_t fresh = Allocate(key);
+        root = InsertAt(root, fresh);
+        return true;
+    }
+
+    bool Erase(const Key& key) {
+        bool erased = false;
+        root = EraseAt(root, key, erased);
+        return erased;
+    }
+
+    bool Contains(const Key& key) const {
+        uint32_t node = root;
+        while (node != kNone) {
+            if (less(key, nodes[node].key)) {
+                node = nodes[node].left;
+            }
+            else if (less(nodes[node].key, key)) {
+                node = nodes[node].right;
+            }
+            else {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // How many keys sort before `key`, whether or not it is in the set.
+    size_t Rank(const Key& key) const {
+        size_t rank = 0;
+        uint32_t node = root;
+        while (node != kNone) {
+            if (less(nodes[node].key, key)) {
+                rank += SizeOf(nodes[node].left) + 1;
+                node = nodes[node].right;
+            }
+            else {
+                node = nodes[node].left;
+            }
+        }
+        return rank;
+    }
+
+    // `rank` must be below size().
+    const Key& At(size_t rank) const {
+        uint32_t node = root;
+        for (;;) {
+            size_t left = SizeOf(nodes[node].left);
+            if (rank < left) {
+                node = nodes[node].left;
+            }
+            else if (rank == left) {
+                return nodes[node].key;
+            }
+            else {
+                rank -= left + 1;
+                node = nodes[node].right;
+            }
+        }
+    }
+
+    // Calls `visit` for up to `count` keys in order, starting at position
+    // `first`: O(log n + count).
+    template <typename Visitor>
+    void Visit(size_t first, size_t count, Visitor&& visit) const {
+        // The path down to `first`, holding the nodes still to come after it
+        std::vector<uint32_t> pending;
+        uint32_t node = root;
+        while (node != kNone) {
+            size_t left = SizeOf(nodes[node].left);
+            if (first < left) {
+                pending.push_back(node);
+                node = nodes[node].left;
+            }
+            else if (first == left) {
+                pending.push_back(node);
+                break;
+            }
+            else {
+                first -= left + 1;
+                node = nodes[node].right;
+            }
+        }
+
+        while (count > 0 && !pending.empty()) {
+            node = pending.back();
+            pending.pop_back();
+            visit(nodes[node].key);
+            count--;
+            for (node = nodes[node].right; node != kNone; node = nodes[node].left) {
+                pending.push_back(node);
+            }
+        }
+    }
+};
+
+#endif // RANKED_SET_HPP
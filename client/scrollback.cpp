@@ -0,0 +1,158 @@
+#include "scrollback.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <cstring>
+
+Scrollback::Scrollback(const RetentionPolicy& policy)
+    : policy(policy), hotHead(0), hotCount(0), hotBytes(0), spilledCount(0), spillAvailable(false) {
+    // Spill files only live for the session; start from a clean slate.
+    const auto mode = std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc;
+    spillData.open(policy.spillPath + ".dat", mode);
+    spillIndex.open(policy.spillPath + ".idx", mode);
+    spillAvailable = spillData.is_open() && spillIndex.is_open();
+
+    if (!spillAvailable) {
+        LOG_ERROR(Storage) << "Can't open scrollback spill file " << policy.spillPath
+            << ", old messages will be dropped";
+    }
+}
+
+Scrollback::~Scrollback() {
+    spillData.close();
+    spillIndex.close();
+}
+
+size_t Scrollback::Append(std::string_view message) {
+    // The ring has a power-of-two size so indexing is a mask; it only grows
+    // while the history is shorter than the retention limit.
+    if (hotCount == hot.size()) {
+        std::vector<std::string_view> grown(std::max<size_t>(hot.size() * 2, 64));
+        for (size_t i = 0; i < hotCount; ++i) {
+            grown[i] = HotAt(i);
+        }
+        hot.swap(grown);
+        hotHead = 0;
+    }
+
+    HotAt(hotCount) = arena.Store(message);
+    hotCount++;
+    hotBytes += message.size();
+
+    while (hotCount > 0 && (hotCount > policy.maxMessages || hotBytes > policy.maxBytes)) {
+        Evict();
+    }
+
+    return size() - 1;
+}
+
+void Scrollback::Replace(size_t index, std::string_view message) {
+    if (index >= size()) {
+        return;
+    }
+    if (index < spilledCount) {
+        replaced[index].assign(message.data(), message.size());
+        return;
+    }
+
+    std::string_view& slot = HotAt(index - spilledCount);
+    hotBytes = hotBytes - slot.size() + message.size();
+    auto it = replaced.find(index);
+    if (it == replaced.end() && message.size() <= slot.size()) {
+        // The arena's bytes are the ring's own; overwrite them
+        char* dest = const_cast<char*>(slot.data());
+        if (!message.empty()) {
+            std::memmove(dest, message.data(), message.size());
+        }
+        slot = std::string_view(dest, message.size());
+        return;
+    }
+
+    if (it == replaced.end()) {
+        it = replaced.emplace(index, std::string()).first;
+    }
+    it->second.assign(message.data(), message.size());
+    slot = it->second;
+}
+
+void Scrollback::Evict() {
+    std::string_view oldest = HotAt(0);
+
+    if (spillAvailable) {
+        spillData.seekp(0, std::ios::end);
+        uint64_t offset = static_cast<uint64_t>(spillData.tellp());
+        uint32_t length = static_cast<uint32_t>(oldest.size());
+        spillData.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        spillData.write(oldest.data(), length);
+
+        spillIndex.seekp(0, std::ios::end);
+        spillIndex.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+
+        if (!spillData || !spillIndex) {
+            LOG_ERROR(Storage) << "Scrollback spill write failed, old messages will be dropped";
+            spillAvailable = false;
+        }
+    }
+
+    hotBytes -= oldest.size();
+    arena.ReleaseOldest();
+    if (!replaced.empty()) {
+        replaced.erase(spilledCount); // Spilled with its replacement
+    }
+    hotHead = (hotHead + 1) & (hot.size() - 1);
+    hotCount--;
+    spilledCount++;
+}
+
+bool Scrollback::ReadSpilled(size_t index, std::string& out) {
+    if (!spillAvailable) {
+        return false;
+    }
+
+    uint64_t offset = 0;
+    spillIndex.seekg(static_cast<std::streamoff>(index * sizeof(offset)));
+    spillIndex.read(reinterpret_cast<char*>(&offset), sizeof(offset));
+
+    uint32_t length = 0;
+    spillData.seekg(static_cast<std::streamoff>(offset));
+    spillData.read(reinterpret_cast<char*>(&length), sizeof(length));
+    out.resize(length);
+    spillData.read(&out[0], length);
+
+    if (!spillIndex || !spillData) {
+        spillIndex.clear();
+        spillData.clear();
+        return false;
+    }
+    return true;
+}
+
+std::string_view Scrollback::At(size_t index) {
+    if (index >= size()) {
+        return std::string_view();
+    }
+    if (index >= spilledCount) {
+        return HotAt(index - spilledCount);
+    }
+    if (!replaced.empty()) {
+        auto it = replaced.find(index);
+        if (it != replaced.end()) {
+            return it->second;
+        }
+    }
+    if (!ReadSpilled(index, spillScratch)) {
+        spillScratch.clear();
+    }
+    return spillScratch;
+}
+
+std::vector<std::string> Scrollback::Get(size_t first, size_t count) {
+    std::vector<std::string> result;
+    size_t last = first + std::min(count, size() - std::min(first, size()));
+    result.reserve(last - first);
+
+    for (size_t i = first; i < last; ++i) {
+        result.emplace_back(At(i));
+    }
+
+    return result;
+}
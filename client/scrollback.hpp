@@ -0,0 +1,64 @@
+#ifndef SCROLLBACK_HPP
+#define SCROLLBACK_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "message_arena.hpp"
+
+// How much chat history stays resident. Whichever limit is hit first evicts
+// the oldest message to the spill file, from where it can be paged back.
+struct RetentionPolicy {
+    size_t maxMessages = 2000;
+    size_t maxBytes = 4 * 1024 * 1024;
+    std::string spillPath = "limechat_scrollback";
+};
+
+// Append-only message history: a hot ring of the newest messages in memory
+// and everything older in a length-prefixed data file plus a fixed-width
+// offset index, so message i is two seeks away no matter how old it is.
+// Resident bodies live in a MessageArena; the ring only holds views into it.
+// Replaced messages are patched where they are when they don't grow, and
+// otherwise kept on the side, ahead of what the arena or spill file holds.
+class Scrollback {
+private:
+    RetentionPolicy policy;
+    MessageArena arena;
+    std::vector<std::string_view> hot;
+    size_t hotHead;
+    size_t hotCount;
+    size_t hotBytes;
+    size_t spilledCount;
+    std::fstream spillData;
+    std::fstream spillIndex;
+    bool spillAvailable;
+    std::string spillScratch;
+    std::map<size_t, std::string> replaced;
+
+    void Evict();
+    bool ReadSpilled(size_t index, std::string& out);
+    std::string_view& HotAt(size_t offset) { return hot[(hotHead + offset) & (hot.size() - 1)]; }
+
+public:
+    explicit Scrollback(const RetentionPolicy& policy = RetentionPolicy());
+    ~Scrollback();
+
+    size_t Append(std::string_view message);
+    // Message `index` reads back as `message` from now on.
+    void Replace(size_t index, std::string_view message);
+    std::vector<std::string> Get(size_t first, size_t count);
+
+    // Views into resident messages, or into a scratch buffer for spilled
+    // ones; either is only valid until the next call on this Scrollback.
+    std::string_view At(size_t index);
+
+    size_t size() const { return spilledCount + hotCount; }
+    size_t residentBegin() const { return spilledCount; }
+    size_t residentBytes() const { return hotBytes; }
+    const RetentionPolicy& getPolicy() const { return policy; }
+};
+
+#endif // SCROLLBACK_HPP
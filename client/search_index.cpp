@@ -0,0 +1,199 @@
+#include "search_index.hpp"
+#include <algorithm>
+#include <iterator>
+#include <unordered_set>
+
+namespace {
+    const size_t kMaxTokenLength = 64;
+
+    bool IsWordByte(unsigned char c) {
+        // Bytes of non-ASCII characters count as word characters, so words in
+        // other scripts are indexed whole, just without case folding.
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+    }
+
+    void AppendVarint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    // Calls `visit` with each lowercased token, built up in `current`.
+    template <typename Visit>
+    void ForEachToken(std::string_view text, std::string& current, Visit&& visit) {
+        current.clear();
+        for (unsigned char c : text) {
+            if (IsWordByte(c)) {
+                if (current.size() < kMaxTokenLength) {
+                    current.push_back(c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : static_cast<char>(c));
+                }
+            }
+            else if (!current.empty()) {
+                visit(current);
+                current.clear();
+            }
+        }
+        if (!current.empty()) {
+            visit(current);
+        }
+    }
+}
+
+SearchIndex::SearchIndex() : indexedMessages(0) {}
+
+std::vector<std::string> SearchIndex::Tokenize(std::string_view text) {
+    std::vector<std::string> tokens;
+    std::string current;
+    ForEachToken(text, current, [&tokens](const std::string& token) {
+        tokens.push_back(token);
+        });
+    return tokens;
+}
+
+void SearchIndex::Add(uint64_t messageId, std::string_view text) {
+    ForEachToken(text, tokenScratch, [this, messageId](const std::string& token) {
+        auto it = terms.find(token);
+        if (it == terms.end()) {
+            it = terms.emplace(token, Postings()).first;
+        }
+
+        Postings& postings = it->second;
+        if (postings.count > 0 && postings.lastId == messageId) {
+            return; // Token repeated within the same message
+        }
+        AppendVarint(postings.deltas, messageId - postings.lastId);
+        postings.lastId = messageId;
+        postings.count++;
+        });
+    indexedMessages++;
+}
+
+void SearchIndex::Decode(const Postings& postings, std::vector<uint64_t>& out) {
+    uint64_t id = 0;
+    uint64_t delta = 0;
+    int shift = 0;
+
+    out.reserve(out.size() + postings.count);
+    for (char byte : postings.deltas) {
+        unsigned char c = static_cast<unsigned char>(byte);
+        delta |= static_cast<uint64_t>(c & 0x7F) << shift;
+        if (c & 0x80) {
+            shift += 7;
+            continue;
+        }
+        id += delta;
+        out.push_back(id);
+        delta = 0;
+        shift = 0;
+    }
+}
+
+std::vector<uint64_t> SearchIndex::Lookup(const Term& term) const {
+    std::vector<uint64_t> ids;
+
+    if (!term.prefix) {
+        auto it = terms.find(term.text);
+        if (it != terms.end()) {
+            Decode(it->second, ids);
+        }
+        return ids;
+    }
+
+    // The dictionary is sorted, so every word with this prefix is one contiguous range
+    size_t merged = 0;
+    for (auto it = terms.lower_bound(term.text); it != terms.end() && it->first.compare(0, term.text.size(), term.text) == 0; ++it) {
+        Decode(it->second, ids);
+        merged++;
+    }
+    if (merged > 1) {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+    return ids;
+}
+
+std::vector<SearchIndex::Term> SearchIndex::ParseQuery(const std::string& query, std::vector<std::vector<std::string>>& phrases) {
+    std::vector<Term> parsed;
+    size_t i = 0;
+
+    while (i < query.size()) {
+        if (query[i] == '"') {
+            size_t end = query.find('"', i + 1);
+            if (end == std::string::npos) {
+                end = query.size();
+            }
+            std::vector<std::string> phrase = Tokenize(query.substr(i + 1, end - i - 1));
+            for (const auto& token : phrase) {
+                parsed.push_back({ token, false });
+            }
+            if (phrase.size() > 1) {
+                phrases.push_back(std::move(phrase));
+            }
+            i = end + 1;
+            continue;
+        }
+
+        size_t end = query.find_first_of(" \t\"", i);
+        if (end == std::string::npos) {
+            end = query.size();
+        }
+        std::string word = query.substr(i, end - i);
+        bool prefix = !word.empty() && word.back() == '*';
+        std::vector<std::string> tokens = Tokenize(word);
+        for (size_t t = 0; t < tokens.size(); ++t) {
+            parsed.push_back({ tokens[t], prefix && t + 1 == tokens.size() });
+        }
+        i = end == query.size() || query[end] == '"' ? end : end + 1;
+    }
+
+    return parsed;
+}
+
+bool SearchIndex::ContainsPhrase(const std::vector<std::string>& tokens, const std::vector<std::string>& phrase) {
+    return std::search(tokens.begin(), tokens.end(), phrase.begin(), phrase.end()) != tokens.end();
+}
+
+std::vector<uint64_t> SearchIndex::Find(const std::string& query, size_t limit, const TextLookup& lookup) const {
+    std::vector<std::vector<std::string>> phrases;
+    std::vector<Term> queryTerms = ParseQuery(query, phrases);
+    if (queryTerms.empty() || limit == 0) {
+        return {};
+    }
+
+    std::vector<std::vector<uint64_t>> lists;
+    for (const auto& term : queryTerms) {
+        lists.push_back(Lookup(term));
+        if (lists.back().empty()) {
+            return {};
+        }
+    }
+
+    // Intersect starting from the rarest term to keep the working set small
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+        return a.size() < b.size();
+        });
+    std::vector<uint64_t> candidates = std::move(lists.front());
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+        std::vector<uint64_t> next;
+        std::set_intersection(candidates.begin(), candidates.end(), lists[i].begin(), lists[i].end(), std::back_inserter(next));
+        candidates.swap(next);
+    }
+
+    std::vector<uint64_t> results;
+    for (auto it = candidates.rbegin(); it != candidates.rend() && results.size() < limit; ++it) {
+        if (!phrases.empty()) {
+            std::vector<std::string> tokens = Tokenize(lookup ? lookup(*it) : std::string());
+            bool matches = std::all_of(phrases.begin(), phrases.end(), [&tokens](const std::vector<std::string>& phrase) {
+                return ContainsPhrase(tokens, phrase);
+                });
+            if (!matches) {
+                continue;
+            }
+        }
+        results.push_back(*it);
+    }
+
+    return results;
+}
@@ -0,0 +1,56 @@
+#ifndef SEARCH_INDEX_HPP
+#define SEARCH_INDEX_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Inverted index over chat history: every token maps to the IDs of the
+// messages containing it. IDs only ever grow, so each posting list is
+// stored as varint-encoded deltas and updated by appending.
+class SearchIndex {
+private:
+    struct Postings {
+        std::string deltas;
+        uint64_t lastId = 0;
+        uint32_t count = 0;
+    };
+
+    struct Term {
+        std::string text;
+        bool prefix;
+    };
+
+    std::map<std::string, Postings> terms;
+    size_t indexedMessages;
+    std::string tokenScratch;
+
+    static void Decode(const Postings& postings, std::vector<uint64_t>& out);
+    std::vector<uint64_t> Lookup(const Term& term) const;
+    static std::vector<Term> ParseQuery(const std::string& query, std::vector<std::vector<std::string>>& phrases);
+    static bool ContainsPhrase(const std::vector<std::string>& tokens, const std::vector<std::string>& phrase);
+
+public:
+    // Used to check phrase matches against the original text.
+    using TextLookup = std::function<std::string(uint64_t messageId)>;
+
+    SearchIndex();
+
+    static std::vector<std::string> Tokenize(std::string_view text);
+
+    // IDs must be added in increasing order. Only words seen for the first
+    // time allocate.
+    void Add(uint64_t messageId, std::string_view text);
+
+    // Words must all appear; a trailing '*' makes a word a prefix and
+    // "quoted words" must appear next to each other. Newest matches first.
+    std::vector<uint64_t> Find(const std::string& query, size_t limit, const TextLookup& lookup) const;
+
+    size_t size() const { return indexedMessages; }
+    size_t termCount() const { return terms.size(); }
+};
+
+#endif // SEARCH_INDEX_HPP
@@ -0,0 +1,104 @@
+#include "session_config.hpp"
+#include "log.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+void SessionConfig::AssignStatePaths(const std::string& suffix) {
+    statePrefix = "limechat_" + (username.empty() ? std::string() : username + "@") + host + "_" + std::to_string(port) + suffix;
+    retention.spillPath = statePrefix + "_scrollback";
+    transport.sessionCachePath = statePrefix + "_tls_session";
+}
+
+bool ParseSessionSpec(const std::string& spec, SessionConfig& config) {
+    size_t at = spec.rfind('@');
+    std::string account = at == std::string::npos ? std::string() : spec.substr(0, at);
+    std::string address = at == std::string::npos ? spec : spec.substr(at + 1);
+
+    if (!account.empty()) {
+        size_t colon = account.find(':');
+        config.username = account.substr(0, colon);
+        if (colon != std::string::npos) {
+            config.password = account.substr(colon + 1);
+        }
+    }
+
+    size_t colon = address.rfind(':');
+    config.host = address.substr(0, colon);
+    if (colon != std::string::npos) {
+        config.port = std::atoi(address.c_str() + colon + 1);
+    }
+    if (config.host.empty() || config.port <= 0 || config.port > 65535) {
+        LOG_ERROR(General) << "Invalid session " << spec << ", expected user[:password]@host[:port]";
+        return false;
+    }
+
+    if (config.name.empty()) {
+        config.name = config.username.empty() ? config.host : config.username + "@" + config.host;
+    }
+    config.AssignStatePaths();
+    return true;
+}
+
+bool LoadSessionsFile(const std::string& path, const SessionConfig& defaults, std::vector<SessionConfig>& sessions) {
+    std::ifstream file(path);
+    if (!file) {
+        LOG_ERROR(General) << "Could not open sessions file " << path;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::vector<std::string> words;
+        std::string word;
+        while (fields >> word) {
+            words.push_back(word);
+        }
+        if (words.empty() || words[0][0] == '#') {
+            continue;
+        }
+
+        SessionConfig config = defaults;
+        if (words.back() == "tls") {
+            config.transport.useTls = true;
+            words.pop_back();
+        }
+        if (words.size() < 2 || words.size() > 5) {
+            LOG_ERROR(General) << path << ":" << lineNumber << ": expected name host [port [user [password]]] [tls]";
+            return false;
+        }
+
+        config.name = words[0];
+        config.host = words[1];
+        if (words.size() > 2) {
+            config.port = std::atoi(words[2].c_str());
+        }
+        if (words.size() > 3) {
+            config.username = words[3];
+        }
+        if (words.size() > 4) {
+            config.password = words[4];
+        }
+        if (config.port <= 0 || config.port > 65535) {
+            LOG_ERROR(General) << path << ":" << lineNumber << ": invalid port " << words[2];
+            return false;
+        }
+
+        config.AssignStatePaths();
+        sessions.push_back(config);
+    }
+    return true;
+}
+
+void MakeStatePathsUnique(std::vector<SessionConfig>& sessions) {
+    std::set<std::string> taken;
+    for (SessionConfig& session : sessions) {
+        for (int copy = 2; !taken.insert(session.statePrefix).second; ++copy) {
+            session.AssignStatePaths("_" + std::to_string(copy));
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef SESSION_CONFIG_HPP
+#define SESSION_CONFIG_HPP
+
+#include <string>
+#include <vector>
+#include "scrollback.hpp"
+#include "transport.hpp"
+
+// One account on one server, as given on the command line or in a sessions
+// file. Every session keeps its state files under its own prefix, so several
+// can run side by side without sharing a scrollback, outbox or TLS ticket.
+struct SessionConfig {
+    std::string name;
+    std::string host;
+    int port = 54000;
+    std::string username;
+    std::string password;
+    TransportOptions transport;
+    RetentionPolicy retention;
+
+    // What the session's state files are named after. The default keeps the
+    // single-server file names; AssignStatePaths gives each configured
+    // session its own.
+    std::string statePrefix = "limechat";
+    // Sets statePrefix to "limechat_[<user>@]<host>_<port>" followed by
+    // `suffix` and points the per-session paths at it
+    void AssignStatePaths(const std::string& suffix = std::string());
+    bool hasCredentials() const { return !username.empty() && !password.empty(); }
+};
+
+// Parses "user[:password]@host[:port]"; fields not given keep the values
+// already in `config`, which supplies the shared defaults.
+bool ParseSessionSpec(const std::string& spec, SessionConfig& config);
+
+// Reads sessions from a file with a line per session:
+//   name host [port [user [password]]] [tls]
+// Blank lines and lines starting with '#' are skipped. Each session starts
+// from `defaults`.
+bool LoadSessionsFile(const std::string& path, const SessionConfig& defaults, std::vector<SessionConfig>& sessions);
+
+// Numbers the state files of sessions that would otherwise share them, e.g.
+// the same account on the same server given twice.
+void MakeStatePathsUnique(std::vector<SessionConfig>& sessions);
+
+#endif // SESSION_CONFIG_HPP
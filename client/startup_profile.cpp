@@ -0,0 +1,21 @@
+#include "startup_profile.hpp"
+#include <iomanip>
+#include <iostream>
+
+StartupProfile::StartupProfile() : start(std::chrono::steady_clock::now()) {}
+
+double StartupProfile::Mark(const std::string& phase) {
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(mutex);
+    phases.emplace_back(phase, elapsed);
+    return elapsed;
+}
+
+void StartupProfile::Report() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::cout << "Startup:";
+    for (const auto& phase : phases) {
+        std::cout << " " << phase.first << " " << std::fixed << std::setprecision(1) << phase.second << " ms;";
+    }
+    std::cout << std::endl;
+}
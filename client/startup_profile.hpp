@@ -0,0 +1,26 @@
+#ifndef STARTUP_PROFILE_HPP
+#define STARTUP_PROFILE_HPP
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records how long after launch each startup phase finished. Phases may be
+// marked from any thread; the report lists them in the order they happened.
+class StartupProfile {
+private:
+    std::chrono::steady_clock::time_point start;
+    std::vector<std::pair<std::string, double>> phases;
+    mutable std::mutex mutex;
+
+public:
+    StartupProfile();
+
+    // Returns the milliseconds since launch.
+    double Mark(const std::string& phase);
+
+    void Report() const;
+};
+
+#endif // STARTUP_PROFILE_HPP
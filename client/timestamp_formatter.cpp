@@ -0,0 +1,20 @@
+#include "timestamp_formatter.hpp"
+#include <ctime>
+
+TimestampFormatter::TimestampFormatter() : cachedSecond(-1), buffer{}, length(0) {}
+
+std::string_view TimestampFormatter::Format(int64_t timestampMs) {
+    int64_t second = timestampMs >= 0 ? timestampMs / 1000 : (timestampMs - 999) / 1000;
+    if (second != cachedSecond || length == 0) {
+        std::time_t time = static_cast<std::time_t>(second);
+        std::tm localTime{};
+#ifdef _WIN32
+        localtime_s(&localTime, &time);
+#else
+        localtime_r(&time, &localTime);
+#endif
+        length = std::strftime(buffer, sizeof(buffer), "[%Y-%m-%d %H:%M:%S]", &localTime);
+        cachedSecond = second;
+    }
+    return std::string_view(buffer, length);
+}
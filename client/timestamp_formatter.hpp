@@ -0,0 +1,23 @@
+#ifndef TIMESTAMP_FORMATTER_HPP
+#define TIMESTAMP_FORMATTER_HPP
+
+#include <cstdint>
+#include <string_view>
+
+// Formats epoch-ms timestamps as "[YYYY-MM-DD HH:MM:SS]" in local time.
+// Messages arrive in bursts within the same second, so the last result is
+// kept and only rebuilt when the second changes.
+class TimestampFormatter {
+private:
+    int64_t cachedSecond;
+    char buffer[32];
+    size_t length;
+
+public:
+    TimestampFormatter();
+
+    // The view is valid until the next call.
+    std::string_view Format(int64_t timestampMs);
+};
+
+#endif // TIMESTAMP_FORMATTER_HPP
@@ -0,0 +1,284 @@
+#ifdef LIMECHAT_WITH_TLS
+
+#include "tls_transport.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <vector>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "libssl.lib")
+#pragma comment(lib, "libcrypto.lib")
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+    // Receive() polls in slices so a Shutdown() from another thread is
+    // noticed even if the socket itself stays quiet
+    const int kPollSliceMs = 250;
+}
+
+TlsTransport::TlsTransport(const TransportOptions& options)
+    : options(options), context(nullptr), ssl(nullptr), shuttingDown(false), kernelSend(false) {}
+
+TlsTransport::~TlsTransport() {
+    if (ssl) {
+        SSL_free(ssl);
+    }
+    if (context) {
+        SSL_CTX_free(context);
+    }
+}
+
+void TlsTransport::PrintErrors(const char* context) {
+    // The queue is emptied even when the line isn't logged
+    std::string errors = context;
+    unsigned long error;
+    while ((error = ERR_get_error()) != 0) {
+        char text[256];
+        ERR_error_string_n(error, text, sizeof(text));
+        errors += ": ";
+        errors += text;
+    }
+    LOG_ERROR(Network) << errors;
+}
+
+bool TlsTransport::Connect(const std::string& host, int port) {
+    sessionKey = host + ":" + std::to_string(port);
+
+    context = SSL_CTX_new(TLS_client_method());
+    if (!context) {
+        PrintErrors("Can't create TLS context");
+        return false;
+    }
+    SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+    SSL_CTX_set_verify(context, SSL_VERIFY_PEER, nullptr);
+    SSL_CTX_set_default_verify_paths(context);
+    if (!options.caFile.empty() && SSL_CTX_load_verify_locations(context, options.caFile.c_str(), nullptr) != 1) {
+        PrintErrors("Can't load CA file");
+        return false;
+    }
+
+    // Tickets are handed to OnNewSession and kept on disk rather than in
+    // OpenSSL's in-memory cache, which would not outlive the process. Under
+    // TLS 1.3 they arrive after the handshake, during the first reads.
+    SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(context, &TlsTransport::OnNewSession);
+
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    SSL_CTX_set_options(context, SSL_OP_ENABLE_KTLS);
+#endif
+
+    if (!tcp.Connect(host, port)) {
+        return false;
+    }
+
+    ssl = SSL_new(context);
+    SSL_set_app_data(ssl, this);
+    SSL_set_fd(ssl, static_cast<int>(tcp.handle()));
+    SSL_set_tlsext_host_name(ssl, host.c_str());
+    SSL_set1_host(ssl, host.c_str());
+
+    SSL_SESSION* saved = LoadSession();
+    if (saved) {
+        SSL_set_session(ssl, saved);
+        SSL_SESSION_free(saved);
+    }
+
+    // The handshake runs blocking; the socket only turns non-blocking after
+    if (SSL_connect(ssl) != 1) {
+        PrintErrors("TLS handshake failed");
+        return false;
+    }
+
+    bool kernelReceive = false;
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    kernelSend = BIO_get_ktls_send(SSL_get_wbio(ssl)) != 0;
+    kernelReceive = BIO_get_ktls_recv(SSL_get_rbio(ssl)) != 0;
+#endif
+    LOG_INFO(Network) << "TLS connected (" << SSL_get_version(ssl) << ", " << SSL_get_cipher(ssl)
+        << (SSL_session_reused(ssl) ? ", resumed" : ", full handshake")
+        << ", kTLS send " << (kernelSend ? "on" : "off") << ", receive " << (kernelReceive ? "on" : "off") << ")";
+
+    SetNonBlocking(tcp.handle(), true);
+    return true;
+}
+
+int TlsTransport::Receive(char* buffer, size_t size) {
+    int length = static_cast<int>(std::min<size_t>(size, std::numeric_limits<int>::max()));
+
+    while (!shuttingDown) {
+        int result;
+        int error;
+        {
+            std::lock_guard<std::mutex> lock(sslMutex);
+            ERR_clear_error();
+            result = SSL_read(ssl, buffer, length);
+            error = SSL_get_error(ssl, result);
+        }
+
+        if (result > 0) {
+            return result;
+        }
+        if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+            WaitForSocket(tcp.handle(), error == SSL_ERROR_WANT_WRITE, kPollSliceMs);
+            continue;
+        }
+        if (error == SSL_ERROR_ZERO_RETURN) {
+            return 0;
+        }
+        if (error == SSL_ERROR_SYSCALL && ERR_peek_error() == 0) {
+            return 0; // Closed without close_notify
+        }
+        PrintErrors("TLS read failed");
+        return -1;
+    }
+    return -1;
+}
+
+int TlsTransport::TryReceive(char* buffer, size_t size) {
+    int length = static_cast<int>(std::min<size_t>(size, std::numeric_limits<int>::max()));
+
+    std::lock_guard<std::mutex> lock(sslMutex);
+    ERR_clear_error();
+    int result = SSL_read(ssl, buffer, length);
+    if (result > 0) {
+        return result;
+    }
+
+    int error = SSL_get_error(ssl, result);
+    if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+        return kWouldBlock;
+    }
+    if (error == SSL_ERROR_ZERO_RETURN || (error == SSL_ERROR_SYSCALL && ERR_peek_error() == 0)) {
+        return 0;
+    }
+    PrintErrors("TLS read failed");
+    return -1;
+}
+
+bool TlsTransport::HasBufferedData() {
+    std::lock_guard<std::mutex> lock(sslMutex);
+    return ssl && SSL_pending(ssl) > 0;
+}
+
+bool TlsTransport::SendAll(const char* data, size_t size) {
+    std::lock_guard<std::mutex> lock(sslMutex);
+
+    size_t sent = 0;
+    while (sent < size && !shuttingDown) {
+        int length = static_cast<int>(std::min<size_t>(size - sent, std::numeric_limits<int>::max()));
+        ERR_clear_error();
+        int result = SSL_write(ssl, data + sent, length);
+        if (result > 0) {
+            sent += static_cast<size_t>(result);
+            continue;
+        }
+
+        int error = SSL_get_error(ssl, result);
+        if (error == SSL_ERROR_WANT_WRITE || error == SSL_ERROR_WANT_READ) {
+            WaitForSocket(tcp.handle(), error == SSL_ERROR_WANT_WRITE, kPollSliceMs);
+            continue;
+        }
+        PrintErrors("TLS write failed");
+        return false;
+    }
+    return sent == size;
+}
+
+bool TlsTransport::SendFile(const AttachmentFile& file, uint64_t offset, size_t length) {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    // With kTLS the kernel encrypts, so the file can go out with sendfile
+    // like on a plain socket
+    if (kernelSend) {
+        std::lock_guard<std::mutex> lock(sslMutex);
+        off_t position = static_cast<off_t>(offset);
+        while (length > 0 && !shuttingDown) {
+            ERR_clear_error();
+            ossl_ssize_t result = SSL_sendfile(ssl, file.handle(), position, length, 0);
+            if (result > 0) {
+                position += result;
+                length -= static_cast<size_t>(result);
+                continue;
+            }
+
+            int error = SSL_get_error(ssl, static_cast<int>(result));
+            if (error == SSL_ERROR_WANT_WRITE) {
+                WaitForSocket(tcp.handle(), true, kPollSliceMs);
+                continue;
+            }
+            PrintErrors("TLS sendfile failed");
+            return false;
+        }
+        return length == 0;
+    }
+#endif
+    return Transport::SendFile(file, offset, length);
+}
+
+void TlsTransport::Shutdown() {
+    shuttingDown = true;
+    tcp.Shutdown();
+}
+
+int TlsTransport::OnNewSession(SSL* ssl, SSL_SESSION* session) {
+    const TlsTransport* transport = static_cast<const TlsTransport*>(SSL_get_app_data(ssl));
+    if (transport) {
+        transport->SaveSession(session);
+    }
+    return 0; // We keep no reference to the session
+}
+
+SSL_SESSION* TlsTransport::LoadSession() const {
+    std::ifstream in(options.sessionCachePath, std::ios::binary);
+    if (!in) {
+        return nullptr;
+    }
+
+    // The cache holds one ticket, for the server it was issued by
+    std::string key;
+    std::getline(in, key);
+    if (key != sessionKey) {
+        return nullptr;
+    }
+
+    std::vector<unsigned char> encoded((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const unsigned char* cursor = encoded.data();
+    SSL_SESSION* session = d2i_SSL_SESSION(nullptr, &cursor, static_cast<long>(encoded.size()));
+    if (session && !SSL_SESSION_is_resumable(session)) {
+        SSL_SESSION_free(session);
+        return nullptr;
+    }
+    return session;
+}
+
+void TlsTransport::SaveSession(SSL_SESSION* session) const {
+    if (!session || options.sessionCachePath.empty()) {
+        return;
+    }
+
+    int length = i2d_SSL_SESSION(session, nullptr);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<unsigned char> encoded(static_cast<size_t>(length));
+    unsigned char* cursor = encoded.data();
+    i2d_SSL_SESSION(session, &cursor);
+
+    std::ofstream out(options.sessionCachePath, std::ios::binary | std::ios::trunc);
+    out << sessionKey << '\n';
+    out.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+    if (!out) {
+        LOG_ERROR(Storage) << "Can't write TLS session cache " << options.sessionCachePath;
+    }
+#ifndef _WIN32
+    // The ticket's resumption secret should be readable by this user only
+    chmod(options.sessionCachePath.c_str(), S_IRUSR | S_IWUSR);
+#endif
+}
+
+#endif // LIMECHAT_WITH_TLS
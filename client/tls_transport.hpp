@@ -0,0 +1,46 @@
+#ifndef TLS_TRANSPORT_HPP
+#define TLS_TRANSPORT_HPP
+
+#ifdef LIMECHAT_WITH_TLS
+
+#include <mutex>
+#include <openssl/ssl.h>
+#include "transport.hpp"
+
+// TLS over TcpTransport using the system OpenSSL. The last session ticket
+// is saved to disk, so a reconnect (even after a restart) resumes the
+// session instead of running a full handshake. On Linux the record layer is
+// handed to the kernel (kTLS) when both OpenSSL and the kernel support it.
+class TlsTransport : public Transport {
+private:
+    TransportOptions options;
+    TcpTransport tcp;
+    SSL_CTX* context;
+    SSL* ssl;
+    std::string sessionKey;
+    std::mutex sslMutex; // SSL objects can't be read and written concurrently
+    std::atomic<bool> shuttingDown;
+    bool kernelSend;
+
+    SSL_SESSION* LoadSession() const;
+    void SaveSession(SSL_SESSION* session) const;
+    static int OnNewSession(SSL* ssl, SSL_SESSION* session);
+    static void PrintErrors(const char* context);
+
+public:
+    explicit TlsTransport(const TransportOptions& options);
+    ~TlsTransport() override;
+
+    bool Connect(const std::string& host, int port) override;
+    int Receive(char* buffer, size_t size) override;
+    int TryReceive(char* buffer, size_t size) override;
+    SOCKET PollHandle() const override { return tcp.handle(); }
+    bool HasBufferedData() override;
+    bool SendAll(const char* data, size_t size) override;
+    bool SendFile(const AttachmentFile& file, uint64_t offset, size_t length) override;
+    void Shutdown() override;
+};
+
+#endif // LIMECHAT_WITH_TLS
+
+#endif // TLS_TRANSPORT_HPP
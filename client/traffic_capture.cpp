@@ -0,0 +1,98 @@
+#include "traffic_capture.hpp"
+#include "log.hpp"
+#include <cstring>
+
+namespace {
+    const char kMagic[8] = { 'L', 'I', 'M', 'E', 'C', 'A', 'P', '1' };
+
+    void WriteVarint(std::ofstream& out, uint64_t value) {
+        char bytes[10];
+        size_t length = 0;
+        while (value >= 0x80) {
+            bytes[length++] = static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        bytes[length++] = static_cast<char>(value);
+        out.write(bytes, length);
+    }
+}
+
+CaptureWriter::CaptureWriter() : first(true) {}
+
+bool CaptureWriter::Open(const std::string& path) {
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        LOG_ERROR(Storage) << "Can't open capture file " << path;
+        return false;
+    }
+    file.write(kMagic, sizeof(kMagic));
+    first = true;
+    return true;
+}
+
+void CaptureWriter::Record(const char* data, size_t size) {
+    if (!file.is_open()) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    uint64_t deltaUs = first ? 0 : static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - lastChunk).count());
+    lastChunk = now;
+    first = false;
+
+    WriteVarint(file, deltaUs);
+    WriteVarint(file, size);
+    file.write(data, size);
+}
+
+void CaptureWriter::Close() {
+    file.close();
+}
+
+CaptureReader::CaptureReader() : offsetUs(0), first(true) {}
+
+bool CaptureReader::Open(const std::string& path) {
+    file.open(path, std::ios::binary);
+    char magic[sizeof(kMagic)] = {};
+    if (!file.is_open() || !file.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        LOG_ERROR(Storage) << "Can't read capture file " << path;
+        file.close();
+        return false;
+    }
+    offsetUs = 0;
+    first = true;
+    return true;
+}
+
+bool CaptureReader::ReadVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        char byte;
+        if (!file.get(byte)) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(byte) & 0x7F) << shift;
+        if ((static_cast<unsigned char>(byte) & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CaptureReader::Next(Chunk& chunk) {
+    uint64_t deltaUs = 0;
+    uint64_t length = 0;
+    if (!file.is_open() || !ReadVarint(deltaUs) || !ReadVarint(length)) {
+        return false;
+    }
+
+    offsetUs = first ? 0 : offsetUs + deltaUs;
+    first = false;
+
+    chunk.offsetUs = offsetUs;
+    chunk.bytes.resize(length);
+    if (length > 0 && !file.read(&chunk.bytes[0], length)) {
+        return false; // Recording was cut off mid-chunk
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef TRAFFIC_CAPTURE_HPP
+#define TRAFFIC_CAPTURE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Capture files hold inbound bytes exactly as recv() returned them, each
+// chunk with the time since the previous one:
+//   "LIMECAP1" then per chunk: varint delta µs, varint length, bytes.
+
+class CaptureWriter {
+private:
+    std::ofstream file;
+    std::chrono::steady_clock::time_point lastChunk;
+    bool first;
+
+public:
+    CaptureWriter();
+
+    bool Open(const std::string& path);
+    bool isOpen() const { return file.is_open(); }
+
+    void Record(const char* data, size_t size);
+    void Close();
+};
+
+class CaptureReader {
+public:
+    struct Chunk {
+        uint64_t offsetUs; // Since the first chunk
+        std::string bytes;
+    };
+
+private:
+    std::ifstream file;
+    uint64_t offsetUs;
+    bool first;
+
+    bool ReadVarint(uint64_t& value);
+
+public:
+    CaptureReader();
+
+    bool Open(const std::string& path);
+
+    // Returns false at the end of the recording.
+    bool Next(Chunk& chunk);
+};
+
+#endif // TRAFFIC_CAPTURE_HPP
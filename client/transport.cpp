@@ -0,0 +1,215 @@
+#include "transport.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <limits>
+#ifdef _WIN32
+#include <mswsock.h>
+#pragma comment(lib, "mswsock.lib")
+#elif defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+#ifdef LIMECHAT_WITH_TLS
+#include "tls_transport.hpp"
+#endif
+
+namespace {
+    // A host that never answers gives up after this rather than the
+    // system's minutes-long default. The wait goes in slices so a
+    // Shutdown() from another thread cuts it short.
+    const int kConnectTimeoutMs = 10000;
+    const int kConnectSliceMs = 250;
+}
+
+bool Transport::SendFile(const AttachmentFile& file, uint64_t offset, size_t length) {
+    MappedRegion region;
+    return region.Map(file, offset, length) && SendAll(region.data(), region.size());
+}
+
+TcpTransport::TcpTransport() : socketHandle(INVALID_SOCKET), shuttingDown(false) {}
+
+TcpTransport::~TcpTransport() {
+    SOCKET handle = socketHandle.exchange(INVALID_SOCKET);
+    if (handle != INVALID_SOCKET) {
+        closesocket(handle);
+    }
+}
+
+bool TcpTransport::Connect(const std::string& host, int port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    addrinfo* addresses = nullptr;
+    int result = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses);
+    if (result != 0) {
+        LOG_ERROR(Network) << "Can't resolve " << host << ", Err #" << result;
+        return false;
+    }
+
+    SOCKET handle = INVALID_SOCKET;
+    int error = 0;
+    for (addrinfo* address = addresses; address && !shuttingDown; address = address->ai_next) {
+        handle = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (handle == INVALID_SOCKET) {
+            error = LastSocketError();
+            continue;
+        }
+        if (ConnectTo(handle, address, error)) {
+            break;
+        }
+        closesocket(handle);
+        handle = INVALID_SOCKET;
+    }
+    freeaddrinfo(addresses);
+
+    if (handle == INVALID_SOCKET) {
+        // A timeout or a Shutdown() has already said why
+        if (!shuttingDown && error != 0) {
+            LOG_ERROR(Network) << "Connect failed, Err #" << error;
+        }
+        return false;
+    }
+
+    // Chat lines are small and latency matters more than packet count
+    int noDelay = 1;
+    setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+    socketHandle = handle;
+    return true;
+}
+
+bool TcpTransport::ConnectTo(SOCKET handle, const addrinfo* address, int& error) {
+    // Non-blocking only for the connect; sends rely on the socket blocking
+    if (!SetNonBlocking(handle, true)) {
+        error = LastSocketError();
+        return false;
+    }
+    if (connect(handle, address->ai_addr, static_cast<int>(address->ai_addrlen)) == SOCKET_ERROR) {
+        if (!ConnectInProgress()) {
+            error = LastSocketError();
+            return false;
+        }
+        bool ready = false;
+        for (int waited = 0; !ready && !shuttingDown && waited < kConnectTimeoutMs; waited += kConnectSliceMs) {
+            ready = WaitForSocket(handle, true, kConnectSliceMs);
+        }
+        if (!ready) {
+            error = 0;
+            if (!shuttingDown) {
+                LOG_WARNING(Network) << "No answer from the server in " << kConnectTimeoutMs << " ms";
+            }
+            return false;
+        }
+        socklen_t errorSize = sizeof(error);
+        if (getsockopt(handle, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &errorSize) == SOCKET_ERROR) {
+            error = LastSocketError();
+            return false;
+        }
+        if (error != 0) {
+            return false;
+        }
+    }
+    if (!SetNonBlocking(handle, false)) {
+        error = LastSocketError();
+        return false;
+    }
+    return true;
+}
+
+int TcpTransport::Receive(char* buffer, size_t size) {
+    int length = static_cast<int>(std::min<size_t>(size, std::numeric_limits<int>::max()));
+    return recv(socketHandle, buffer, length, 0);
+}
+
+int TcpTransport::TryReceive(char* buffer, size_t size) {
+    // The socket stays blocking for sends; a zero-timeout poll keeps this
+    // read from waiting
+    if (!WaitForSocket(socketHandle, false, 0)) {
+        return kWouldBlock;
+    }
+    return Receive(buffer, size);
+}
+
+bool TcpTransport::SendAll(const char* data, size_t size) {
+    size_t sent = 0;
+    while (sent < size) {
+        int length = static_cast<int>(std::min<size_t>(size - sent, std::numeric_limits<int>::max()));
+        int result = send(socketHandle, data + sent, length, SEND_NO_SIGNAL);
+        if (result == SOCKET_ERROR) {
+            LOG_ERROR(Network) << "send() failed, Err #" << LastSocketError();
+            return false;
+        }
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+bool TcpTransport::SendFile(const AttachmentFile& file, uint64_t offset, size_t length) {
+#ifdef _WIN32
+    // The file position is where TransmitFile starts reading
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(offset);
+    if (!SetFilePointerEx(file.handle(), position, nullptr, FILE_BEGIN)
+        || !TransmitFile(socketHandle, file.handle(), static_cast<DWORD>(length), 0, nullptr, nullptr, 0)) {
+        LOG_ERROR(Network) << "TransmitFile() failed, Err #" << LastSocketError();
+        return false;
+    }
+    return true;
+#elif defined(__linux__)
+    // The kernel copies from the page cache straight into the socket
+    off_t position = static_cast<off_t>(offset);
+    while (length > 0) {
+        ssize_t result = sendfile(socketHandle, file.handle(), &position, length);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            LOG_ERROR(Network) << "sendfile() failed, Err #" << LastSocketError();
+            return false;
+        }
+        length -= static_cast<size_t>(result);
+    }
+    return true;
+#else
+    return Transport::SendFile(file, offset, length);
+#endif
+}
+
+void TcpTransport::Shutdown() {
+    shuttingDown = true;
+    SOCKET handle = socketHandle;
+    if (handle != INVALID_SOCKET) {
+        shutdown(handle, SD_BOTH);
+    }
+}
+
+std::unique_ptr<Transport> CreateTransport(const TransportOptions& options) {
+    if (!options.useTls) {
+        return std::make_unique<TcpTransport>();
+    }
+#ifdef LIMECHAT_WITH_TLS
+    return std::make_unique<TlsTransport>(options);
+#else
+    LOG_ERROR(Network) << "TLS was requested but this build has no TLS support (LIMECHAT_WITH_TLS)";
+    return nullptr;
+#endif
+}
+
+bool InitializeSockets() {
+#ifdef _WIN32
+    WSADATA wsData;
+    int wsResult = WSAStartup(MAKEWORD(2, 2), &wsData);
+    if (wsResult != 0) {
+        LOG_ERROR(Network) << "Can't start Winsock, Err #" << wsResult;
+        return false;
+    }
+#endif
+    return true;
+}
+
+void CleanupSockets() {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
@@ -0,0 +1,89 @@
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include "attachment_file.hpp"
+#include "net_socket.hpp"
+
+struct TransportOptions {
+    bool useTls = false;
+    // Extra CA bundle to trust, e.g. a test server's self-signed certificate
+    std::string caFile;
+    // Where the last TLS session ticket is kept between runs
+    std::string sessionCachePath = "limechat_tls_session";
+    // Pings measure latency and clock offset; a server that has answered
+    // them and then stays silent for the timeout is treated as gone.
+    // An interval of 0 turns pings off.
+    int heartbeatIntervalMs = 5000;
+    int heartbeatTimeoutMs = 20000;
+};
+
+// A byte stream to the server. Receive() is called from one thread while
+// SendAll() and Shutdown() may be called from others.
+class Transport {
+public:
+    static const int kWouldBlock = -2;
+
+    virtual ~Transport() {}
+
+    virtual bool Connect(const std::string& host, int port) = 0;
+
+    // Blocks until data arrives. Returns the byte count, 0 when the peer
+    // closed the connection and a negative value on error.
+    virtual int Receive(char* buffer, size_t size) = 0;
+
+    // Like Receive() but returns kWouldBlock instead of waiting, for event
+    // loops that poll many connections.
+    virtual int TryReceive(char* buffer, size_t size) = 0;
+
+    // The socket to poll for readability, and whether bytes are already
+    // buffered above it (then polling would wait for nothing).
+    virtual SOCKET PollHandle() const = 0;
+    virtual bool HasBufferedData() { return false; }
+
+    // Sends every byte or returns false.
+    virtual bool SendAll(const char* data, size_t size) = 0;
+
+    // Sends `length` bytes of the file from `offset`. The default maps that
+    // part of the file and sends from the mapping; transports that can hand
+    // the file to the kernel do that instead.
+    virtual bool SendFile(const AttachmentFile& file, uint64_t offset, size_t length);
+
+    // Ends the connection and wakes a blocked Receive(), or makes a
+    // Connect() in progress give up.
+    virtual void Shutdown() = 0;
+};
+
+class TcpTransport : public Transport {
+private:
+    std::atomic<SOCKET> socketHandle;
+    std::atomic<bool> shuttingDown;
+
+    bool ConnectTo(SOCKET handle, const addrinfo* address, int& error);
+
+public:
+    TcpTransport();
+    ~TcpTransport() override;
+
+    bool Connect(const std::string& host, int port) override;
+    int Receive(char* buffer, size_t size) override;
+    int TryReceive(char* buffer, size_t size) override;
+    SOCKET PollHandle() const override { return socketHandle; }
+    bool SendAll(const char* data, size_t size) override;
+    bool SendFile(const AttachmentFile& file, uint64_t offset, size_t length) override;
+    void Shutdown() override;
+
+    SOCKET handle() const { return socketHandle; }
+};
+
+// Returns nullptr if TLS was asked for but the client was built without it.
+std::unique_ptr<Transport> CreateTransport(const TransportOptions& options);
+
+// Process-wide socket library setup (Winsock); a no-op elsewhere.
+bool InitializeSockets();
+void CleanupSockets();
+
+#endif // TRANSPORT_HPP
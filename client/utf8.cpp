@@ -0,0 +1,392 @@
+#include "utf8.hpp"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define UTF8_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(UTF8_X86) && (defined(__GNUC__) || defined(__clang__))
+#define UTF8_TARGET_SSE2 __attribute__((target("sse2")))
+#define UTF8_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define UTF8_TARGET_SSE2
+#define UTF8_TARGET_AVX2
+#endif
+
+namespace {
+    enum class Isa { Scalar, Sse2, Avx2 };
+
+    Isa DetectIsa() {
+#if defined(UTF8_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+        __cpuid(info, 1);
+        bool sse2 = (info[3] & (1 << 26)) != 0;
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5)) {
+                return Isa::Avx2;
+            }
+        }
+        return sse2 ? Isa::Sse2 : Isa::Scalar;
+#elif defined(UTF8_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return Isa::Avx2;
+        }
+        return __builtin_cpu_supports("sse2") ? Isa::Sse2 : Isa::Scalar;
+#else
+        return Isa::Scalar;
+#endif
+    }
+
+    Isa ActiveIsa() {
+        static const Isa isa = DetectIsa();
+        return isa;
+    }
+
+    // Length of the well-formed sequence starting at `s`, or 0 if it is not one.
+    size_t SequenceLength(const unsigned char* s, size_t remaining) {
+        unsigned char c = s[0];
+        if (c < 0x80) {
+            return 1;
+        }
+        if (c < 0xC2) {
+            return 0;
+        }
+        if (c < 0xE0) {
+            return remaining >= 2 && (s[1] & 0xC0) == 0x80 ? 2 : 0;
+        }
+        if (c < 0xF0) {
+            if (remaining < 3 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80) {
+                return 0;
+            }
+            if ((c == 0xE0 && s[1] < 0xA0) || (c == 0xED && s[1] > 0x9F)) {
+                return 0; // overlong or surrogate
+            }
+            return 3;
+        }
+        if (c < 0xF5) {
+            if (remaining < 4 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80 || (s[3] & 0xC0) != 0x80) {
+                return 0;
+            }
+            if ((c == 0xF0 && s[1] < 0x90) || (c == 0xF4 && s[1] > 0x8F)) {
+                return 0; // overlong or above U+10FFFF
+            }
+            return 4;
+        }
+        return 0;
+    }
+
+    size_t DecodeSequence(const unsigned char* s, size_t remaining, uint32_t& codepoint) {
+        switch (SequenceLength(s, remaining)) {
+        case 1:
+            codepoint = s[0];
+            return 1;
+        case 2:
+            codepoint = ((s[0] & 0x1Fu) << 6) | (s[1] & 0x3Fu);
+            return 2;
+        case 3:
+            codepoint = ((s[0] & 0x0Fu) << 12) | ((s[1] & 0x3Fu) << 6) | (s[2] & 0x3Fu);
+            return 3;
+        case 4:
+            codepoint = ((s[0] & 0x07u) << 18) | ((s[1] & 0x3Fu) << 12) | ((s[2] & 0x3Fu) << 6) | (s[3] & 0x3Fu);
+            return 4;
+        default:
+            codepoint = 0xFFFD;
+            return 1;
+        }
+    }
+
+    bool ValidateScalar(const unsigned char* s, size_t i, size_t size) {
+        while (i < size) {
+            size_t length = SequenceLength(s + i, size - i);
+            if (length == 0) {
+                return false;
+            }
+            i += length;
+        }
+        return true;
+    }
+
+    size_t DecodeScalar(const unsigned char* s, size_t i, size_t size, uint32_t* out, size_t count) {
+        while (i < size) {
+            i += DecodeSequence(s + i, size - i, out[count++]);
+        }
+        return count;
+    }
+
+#if defined(UTF8_X86)
+    // SSE2 has no byte shuffle, so it only skips ASCII runs 16 bytes at a
+    // time and checks multi-byte sequences one by one.
+    UTF8_TARGET_SSE2 bool ValidateSse2(const unsigned char* s, size_t size) {
+        size_t i = 0;
+        while (i + 16 <= size) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            if (_mm_movemask_epi8(block) == 0) {
+                i += 16;
+                continue;
+            }
+            size_t blockEnd = i + 16;
+            while (i < blockEnd) {
+                size_t length = SequenceLength(s + i, size - i);
+                if (length == 0) {
+                    return false;
+                }
+                i += length;
+            }
+        }
+        return ValidateScalar(s, i, size);
+    }
+
+    UTF8_TARGET_SSE2 size_t DecodeSse2(const unsigned char* s, size_t size, uint32_t* out) {
+        size_t i = 0;
+        size_t count = 0;
+        const __m128i zero = _mm_setzero_si128();
+        while (i + 16 <= size) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            if (_mm_movemask_epi8(block) == 0) {
+                __m128i low = _mm_unpacklo_epi8(block, zero);
+                __m128i high = _mm_unpackhi_epi8(block, zero);
+                __m128i* dst = reinterpret_cast<__m128i*>(out + count);
+                _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(low, zero));
+                _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(low, zero));
+                _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(high, zero));
+                _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(high, zero));
+                i += 16;
+                count += 16;
+                continue;
+            }
+            size_t blockEnd = i + 16;
+            while (i < blockEnd) {
+                i += DecodeSequence(s + i, size - i, out[count++]);
+            }
+        }
+        return DecodeScalar(s, i, size, out, count);
+    }
+
+    // Full vectorized validation after Keiser & Lemire, "Validating UTF-8 In
+    // Less Than One Instruction Per Byte": three nibble lookups classify
+    // every byte pair, and the 3rd/4th byte continuations are checked by
+    // looking two and three bytes back.
+    const uint8_t TOO_SHORT = 1 << 0;
+    const uint8_t TOO_LONG = 1 << 1;
+    const uint8_t OVERLONG_3 = 1 << 2;
+    const uint8_t TOO_LARGE = 1 << 3;
+    const uint8_t SURROGATE = 1 << 4;
+    const uint8_t OVERLONG_2 = 1 << 5;
+    const uint8_t TOO_LARGE_1000 = 1 << 6;
+    const uint8_t OVERLONG_4 = 1 << 6;
+    const uint8_t TWO_CONTS = 1 << 7;
+    const uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+    UTF8_TARGET_AVX2 inline __m256i Table16(uint8_t t0, uint8_t t1, uint8_t t2, uint8_t t3, uint8_t t4, uint8_t t5, uint8_t t6, uint8_t t7,
+        uint8_t t8, uint8_t t9, uint8_t t10, uint8_t t11, uint8_t t12, uint8_t t13, uint8_t t14, uint8_t t15) {
+        return _mm256_setr_epi8(
+            t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12, t13, t14, t15,
+            t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12, t13, t14, t15);
+    }
+
+    UTF8_TARGET_AVX2 inline __m256i HighNibble(__m256i v) {
+        return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+    }
+
+    // Bytes of `input` shifted right by N, pulling the last N bytes of `previous` in front.
+    template <int N>
+    UTF8_TARGET_AVX2 inline __m256i Prev(__m256i input, __m256i previous) {
+        return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - N);
+    }
+
+    UTF8_TARGET_AVX2 __m256i CheckBlock(__m256i input, __m256i previous) {
+        __m256i prev1 = Prev<1>(input, previous);
+
+        __m256i byte1High = _mm256_shuffle_epi8(Table16(
+            TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+            TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+            TOO_SHORT | OVERLONG_2,
+            TOO_SHORT,
+            TOO_SHORT | OVERLONG_3 | SURROGATE,
+            TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4), HighNibble(prev1));
+
+        const uint8_t large = CARRY | TOO_LARGE | TOO_LARGE_1000;
+        __m256i byte1Low = _mm256_shuffle_epi8(Table16(
+            CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+            CARRY | OVERLONG_2,
+            CARRY, CARRY,
+            CARRY | TOO_LARGE,
+            large, large, large, large, large, large, large, large,
+            large | SURROGATE,
+            large, large), _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)));
+
+        const uint8_t cont = TOO_LONG | OVERLONG_2 | TWO_CONTS;
+        __m256i byte2High = _mm256_shuffle_epi8(Table16(
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+            cont | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+            cont | OVERLONG_3 | TOO_LARGE,
+            cont | SURROGATE | TOO_LARGE,
+            cont | SURROGATE | TOO_LARGE,
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT), HighNibble(input));
+
+        __m256i special = _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+
+        // Bytes that must be the 3rd or 4th of a sequence need a continuation flag of 0x80
+        __m256i isThird = _mm256_subs_epu8(Prev<2>(input, previous), _mm256_set1_epi8(static_cast<char>(0xE0 - 1)));
+        __m256i isFourth = _mm256_subs_epu8(Prev<3>(input, previous), _mm256_set1_epi8(static_cast<char>(0xF0 - 1)));
+        __m256i must23 = _mm256_cmpgt_epi8(_mm256_or_si256(isThird, isFourth), _mm256_setzero_si256());
+        __m256i must23Flag = _mm256_and_si256(must23, _mm256_set1_epi8(static_cast<char>(0x80)));
+
+        return _mm256_xor_si256(must23Flag, special);
+    }
+
+    // Non-zero if the block ends inside a multi-byte sequence.
+    UTF8_TARGET_AVX2 __m256i IncompleteAtEnd(__m256i input) {
+        const __m256i maxValue = _mm256_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+        return _mm256_subs_epu8(input, maxValue);
+    }
+
+    UTF8_TARGET_AVX2 bool ValidateAvx2(const unsigned char* s, size_t size) {
+        __m256i error = _mm256_setzero_si256();
+        __m256i previous = _mm256_setzero_si256();
+        __m256i prevIncomplete = _mm256_setzero_si256();
+
+        size_t i = 0;
+        alignas(32) unsigned char tail[32];
+        while (i < size) {
+            __m256i input;
+            if (i + 32 <= size) {
+                input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            }
+            else {
+                // Zero padding is ASCII, so a sequence cut by the end still shows up as too short
+                for (size_t k = 0; k < 32; ++k) {
+                    tail[k] = i + k < size ? s[i + k] : 0;
+                }
+                input = _mm256_load_si256(reinterpret_cast<const __m256i*>(tail));
+            }
+
+            if (_mm256_movemask_epi8(input) == 0) {
+                error = _mm256_or_si256(error, prevIncomplete);
+                prevIncomplete = _mm256_setzero_si256();
+            }
+            else {
+                error = _mm256_or_si256(error, CheckBlock(input, previous));
+                prevIncomplete = IncompleteAtEnd(input);
+            }
+            previous = input;
+            i += 32;
+        }
+        error = _mm256_or_si256(error, prevIncomplete);
+
+        return _mm256_testz_si256(error, error) != 0;
+    }
+
+    UTF8_TARGET_AVX2 size_t DecodeAvx2(const unsigned char* s, size_t size, uint32_t* out) {
+        size_t i = 0;
+        size_t count = 0;
+        while (i + 32 <= size) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            if (_mm256_movemask_epi8(block) == 0) {
+                __m256i* dst = reinterpret_cast<__m256i*>(out + count);
+                for (int k = 0; k < 4; ++k) {
+                    __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(s + i + 8 * k));
+                    _mm256_storeu_si256(dst + k, _mm256_cvtepu8_epi32(bytes));
+                }
+                i += 32;
+                count += 32;
+                continue;
+            }
+            size_t blockEnd = i + 32;
+            while (i < blockEnd) {
+                i += DecodeSequence(s + i, size - i, out[count++]);
+            }
+        }
+        return DecodeScalar(s, i, size, out, count);
+    }
+#endif
+}
+
+namespace utf8 {
+    bool IsValid(const char* data, size_t size) {
+        const unsigned char* s = reinterpret_cast<const unsigned char*>(data);
+#if defined(UTF8_X86)
+        switch (ActiveIsa()) {
+        case Isa::Avx2:
+            return ValidateAvx2(s, size);
+        case Isa::Sse2:
+            return ValidateSse2(s, size);
+        default:
+            break;
+        }
+#endif
+        return ValidateScalar(s, 0, size);
+    }
+
+    void Sanitize(std::string& text) {
+        if (IsValid(text.data(), text.size())) {
+            return;
+        }
+
+        const unsigned char* s = reinterpret_cast<const unsigned char*>(text.data());
+        std::string repaired;
+        repaired.reserve(text.size() + 8);
+        size_t i = 0;
+        while (i < text.size()) {
+            size_t length = SequenceLength(s + i, text.size() - i);
+            if (length == 0) {
+                repaired += "\xEF\xBF\xBD";
+                i++;
+            }
+            else {
+                repaired.append(text, i, length);
+                i += length;
+            }
+        }
+        text.swap(repaired);
+    }
+
+    size_t IncompleteTail(const char* data, size_t size) {
+        const unsigned char* s = reinterpret_cast<const unsigned char*>(data);
+        for (size_t k = 1; k <= 3 && k <= size; ++k) {
+            unsigned char c = s[size - k];
+            if ((c & 0xC0) == 0x80) {
+                continue;
+            }
+            if (c < 0xC0) {
+                return 0;
+            }
+            size_t expected = c >= 0xF0 ? 4 : (c >= 0xE0 ? 3 : 2);
+            return expected > k ? k : 0;
+        }
+        return 0;
+    }
+
+    size_t Decode(const char* data, size_t size, uint32_t* out) {
+        const unsigned char* s = reinterpret_cast<const unsigned char*>(data);
+#if defined(UTF8_X86)
+        switch (ActiveIsa()) {
+        case Isa::Avx2:
+            return DecodeAvx2(s, size, out);
+        case Isa::Sse2:
+            return DecodeSse2(s, size, out);
+        default:
+            break;
+        }
+#endif
+        return DecodeScalar(s, 0, size, out, 0);
+    }
+
+    std::basic_string<uint32_t> Decode(const std::string& text) {
+        std::basic_string<uint32_t> decoded(text.size(), 0);
+        decoded.resize(Decode(text.data(), text.size(), &decoded[0]));
+        return decoded;
+    }
+}
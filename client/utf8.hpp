@@ -0,0 +1,29 @@
+#ifndef UTF8_HPP
+#define UTF8_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// UTF-8 helpers for text coming off the wire. Validation and decoding use
+// AVX2 or SSE2 when the CPU has them (picked once at runtime) and fall back
+// to a scalar loop otherwise.
+namespace utf8 {
+    bool IsValid(const char* data, size_t size);
+
+    // Replaces every invalid sequence with U+FFFD. Valid input, which is
+    // the common case, is only scanned and never copied.
+    void Sanitize(std::string& text);
+
+    // Number of bytes at the end of `data` that start a multi-byte sequence
+    // but are cut short. They should be held back until more data arrives.
+    size_t IncompleteTail(const char* data, size_t size);
+
+    // Decodes valid UTF-8 into `out`, which must have room for `size`
+    // codepoints. Returns the number of codepoints written.
+    size_t Decode(const char* data, size_t size, uint32_t* out);
+
+    std::basic_string<uint32_t> Decode(const std::string& text);
+}
+
+#endif // UTF8_HPP
@@ -1,11 +1,116 @@
 #include "client/lime_chat.hpp"
 #include "client/lime_gui.hpp"
+#include "client/log.hpp"
+#include "client/session_config.hpp"
+#include <cstdlib>
+#include <cstring>
 
-int main() {
-    std::string serverIp = "192.168.1.169";
-    int serverPort = 54000;
+int main(int argc, char** argv) {
+    IgnoreBrokenPipes();
 
-    LimeGUI limeGUI(serverIp, serverPort);
+    SessionConfig defaults;
+    defaults.host = "192.168.1.169";
+    TransportOptions& transport = defaults.transport;
+    std::vector<std::string> sessionSpecs;
+    std::string sessionsPath;
+    std::string capturePath;
+    std::string replayPath;
+    double replaySpeed = 1.0;
+
+    // lime_chat [--tls] [--ca-file cert.pem] [--capture file]
+    //           [--replay file [--replay-speed x]]
+    //           [--ping-interval ms] [--ping-timeout ms]
+    //           [--log-level debug|info|warning|error] [--log-file file]
+    //           [--session user[:password]@host[:port]]... [--sessions file]
+    //           [host [port]]
+    // A replay speed of 0 plays the capture as fast as possible and a ping
+    // interval of 0 turns heartbeats off. Each --session adds a session;
+    // without any, host and port give the single one. Debug lines are only
+    // there in builds with -DLIMECHAT_LOG_LEVEL=0.
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--tls") == 0) {
+            transport.useTls = true;
+        }
+        else if (std::strcmp(argv[i], "--ca-file") == 0 && i + 1 < argc) {
+            transport.caFile = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capturePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--replay-speed") == 0 && i + 1 < argc) {
+            replaySpeed = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--ping-interval") == 0 && i + 1 < argc) {
+            transport.heartbeatIntervalMs = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--ping-timeout") == 0 && i + 1 < argc) {
+            transport.heartbeatTimeoutMs = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            LogLevel level;
+            if (!logging::ParseLevel(argv[++i], level)) {
+                std::cerr << "Unknown log level " << argv[i] << std::endl;
+                return 1;
+            }
+            logging::SetLevel(level);
+        }
+        else if (std::strcmp(argv[i], "--log-file") == 0 && i + 1 < argc) {
+            if (!logging::SetOutputFile(argv[++i])) {
+                std::cerr << "Can't open log file " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--session") == 0 && i + 1 < argc) {
+            sessionSpecs.push_back(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) {
+            sessionsPath = argv[++i];
+        }
+        else if (positional == 0) {
+            defaults.host = argv[i];
+            positional++;
+        }
+        else if (positional == 1) {
+            defaults.port = std::atoi(argv[i]);
+            positional++;
+        }
+        else {
+            std::cerr << "Unexpected argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    // Options given anywhere on the line apply to every session
+    std::vector<SessionConfig> sessions;
+    if (!sessionsPath.empty() && !LoadSessionsFile(sessionsPath, defaults, sessions)) {
+        return 1;
+    }
+    for (const std::string& spec : sessionSpecs) {
+        SessionConfig session = defaults;
+        if (!ParseSessionSpec(spec, session)) {
+            return 1;
+        }
+        sessions.push_back(session);
+    }
+    if (sessions.empty()) {
+        defaults.name = defaults.host;
+        sessions.push_back(defaults);
+    }
+    MakeStatePathsUnique(sessions);
+
+    LimeGUI limeGUI(sessions);
+    if (!replayPath.empty()) {
+        if (!limeGUI.replayTraffic(replayPath, replaySpeed)) {
+            return 1;
+        }
+    }
+    else if (!capturePath.empty() && !limeGUI.captureTraffic(capturePath)) {
+        return 1;
+    }
     limeGUI.run();
 
     return 0;
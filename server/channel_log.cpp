@@ -0,0 +1,542 @@
+#include "channel_log.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+    // u32 size, then u64 id, i64 timestamp and u16 user length
+    const size_t kSizeField = sizeof(uint32_t);
+    const size_t kRecordHeader = sizeof(uint64_t) + sizeof(int64_t) + sizeof(uint16_t);
+    const size_t kIndexEntrySize = sizeof(uint64_t) + sizeof(int64_t) + sizeof(uint64_t);
+    // u32 size, then u64 id and u8 deleted before the body
+    const size_t kEditHeader = sizeof(uint64_t) + sizeof(uint8_t);
+    // Appends are written out in batches of about this size
+    const size_t kFlushThreshold = 1024 * 1024;
+
+    // Reads the record at `offset`; false if it is cut off or malformed.
+    bool ReadRecord(const char* data, uint64_t size, uint64_t offset, HistoryRecord& record, uint64_t& next) {
+        if (size - offset < kSizeField + kRecordHeader) {
+            return false;
+        }
+        const char* at = data + offset;
+        uint32_t length;
+        std::memcpy(&length, at, sizeof(length));
+        if (length < kRecordHeader || size - offset - kSizeField < length) {
+            return false;
+        }
+
+        at += kSizeField;
+        uint16_t userLength;
+        std::memcpy(&record.id, at, sizeof(record.id));
+        std::memcpy(&record.timestampMs, at + 8, sizeof(record.timestampMs));
+        std::memcpy(&userLength, at + 16, sizeof(userLength));
+        if (userLength > length - kRecordHeader) {
+            return false;
+        }
+        record.user = std::string_view(at + kRecordHeader, userLength);
+        record.body = std::string_view(at + kRecordHeader + userLength, length - kRecordHeader - userLength);
+        next = offset + kSizeField + length;
+        return true;
+    }
+
+    void AppendIndexEntry(std::string& out, uint64_t id, int64_t timestampMs, uint64_t offset) {
+        char entry[kIndexEntrySize];
+        std::memcpy(entry, &id, 8);
+        std::memcpy(entry + 8, &timestampMs, 8);
+        std::memcpy(entry + 16, &offset, 8);
+        out.append(entry, sizeof(entry));
+    }
+
+    std::string SegmentName(uint64_t firstId) {
+        // Zero-padded, so a directory listing sorts in ID order
+        std::string digits = std::to_string(firstId);
+        return std::string(20 - std::min<size_t>(20, digits.size()), '0') + digits;
+    }
+}
+
+ChannelLog::ChannelLog(uint64_t segmentBytes)
+    : segmentBytes(segmentBytes), nextId(1), lastTimestampMs(std::numeric_limits<int64_t>::min()),
+    recordsSinceIndex(kIndexInterval), bytesWritten(0), editsBytes(0) {}
+
+bool ChannelLog::Open(const std::string& path) {
+    directory = path;
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Can't create " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    std::vector<std::pair<uint64_t, std::string>> logs;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        std::string stem = entry.path().stem().string();
+        uint64_t firstId = 0;
+        auto parsed = std::from_chars(stem.data(), stem.data() + stem.size(), firstId);
+        if (entry.path().extension() == ".log" && parsed.ec == std::errc() && parsed.ptr == stem.data() + stem.size()) {
+            logs.emplace_back(firstId, entry.path().string());
+        }
+    }
+    std::sort(logs.begin(), logs.end());
+
+    for (const auto& [firstId, logPath] : logs) {
+        if (!segments.empty() && firstId != segments.back()->lastId + 1) {
+            std::cerr << "Gap in " << directory << " before " << logPath << ", stopping there" << std::endl;
+            break;
+        }
+        if (!LoadSegment(logPath, firstId)) {
+            return false;
+        }
+    }
+
+    if (segments.empty()) {
+        return StartSegment(1) && LoadEdits();
+    }
+    nextId = segments.back()->lastId + 1;
+    return OpenWriters() && LoadEdits();
+}
+
+bool ChannelLog::LoadEdits() {
+    std::string path = directory + "/edits.dat";
+    std::ifstream file(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // Applied in order, so a later edit wins; a cut-off last entry is
+    // written over by the next one
+    size_t offset = 0;
+    while (bytes.size() - offset >= kSizeField + kEditHeader) {
+        uint32_t length;
+        std::memcpy(&length, bytes.data() + offset, sizeof(length));
+        if (length < kEditHeader || bytes.size() - offset - kSizeField < length) {
+            break;
+        }
+        const char* at = bytes.data() + offset + kSizeField;
+        uint64_t id;
+        std::memcpy(&id, at, sizeof(id));
+        if (at[8]) {
+            editedBodies.erase(id);
+            deletedIds.insert(id);
+        }
+        else {
+            editedBodies[id].assign(at + kEditHeader, length - kEditHeader);
+        }
+        offset += kSizeField + length;
+    }
+    editsBytes = offset;
+    return editsWriter.OpenForWriting(path);
+}
+
+bool ChannelLog::WriteEdit(uint64_t id, bool deleted, std::string_view body) {
+    uint32_t length = static_cast<uint32_t>(kEditHeader + body.size());
+    std::string entry(kSizeField + kEditHeader, '\0');
+    std::memcpy(&entry[0], &length, sizeof(length));
+    std::memcpy(&entry[4], &id, sizeof(id));
+    entry[12] = deleted ? 1 : 0;
+    entry.append(body.data(), body.size());
+    if (!editsWriter.WriteAt(editsBytes, entry.data(), entry.size())) {
+        return false;
+    }
+    editsBytes += entry.size();
+    bytesWritten += entry.size();
+    return true;
+}
+
+bool ChannelLog::Edit(uint64_t id, std::string_view body) {
+    if (id == 0 || id >= nextId || deletedIds.count(id) || !WriteEdit(id, false, body)) {
+        return false;
+    }
+    editedBodies[id].assign(body.data(), body.size());
+    return true;
+}
+
+bool ChannelLog::Delete(uint64_t id) {
+    if (id == 0 || id >= nextId || deletedIds.count(id) || !WriteEdit(id, true, std::string_view())) {
+        return false;
+    }
+    editedBodies.erase(id);
+    deletedIds.insert(id);
+    return true;
+}
+
+HistoryRecord ChannelLog::Edited(const HistoryRecord& record) const {
+    if (editedBodies.empty()) {
+        return record;
+    }
+    auto it = editedBodies.find(record.id);
+    if (it == editedBodies.end()) {
+        return record;
+    }
+    HistoryRecord edited = record;
+    edited.body = it->second;
+    return edited;
+}
+
+bool ChannelLog::LoadSegment(const std::string& logPath, uint64_t firstId) {
+    auto segment = std::make_unique<Segment>();
+    segment->logPath = logPath;
+    segment->indexPath = logPath.substr(0, logPath.size() - 4) + ".idx";
+    segment->firstId = firstId;
+    segment->lastId = firstId - 1;
+
+    std::ifstream indexFile(segment->indexPath, std::ios::binary);
+    char entry[kIndexEntrySize];
+    while (indexFile.read(entry, sizeof(entry))) {
+        IndexEntry loaded;
+        std::memcpy(&loaded.id, entry, 8);
+        std::memcpy(&loaded.timestampMs, entry + 8, 8);
+        std::memcpy(&loaded.offset, entry + 16, 8);
+        segment->index.push_back(loaded);
+    }
+
+    if (!segment->reader.OpenForReading(logPath)) {
+        return false;
+    }
+    uint64_t fileSize = segment->reader.size();
+    if (fileSize > 0 && !segment->mapping.Map(segment->reader, 0, static_cast<size_t>(fileSize))) {
+        return false;
+    }
+
+    // Index entries are written after their records, so any that point past
+    // the data belong to a write that never finished
+    while (!segment->index.empty() && segment->index.back().offset >= fileSize) {
+        segment->index.pop_back();
+    }
+
+    // Everything before the last index entry is known good; the records
+    // after it are checked one by one and the index is completed
+    HistoryRecord record;
+    uint64_t next = 0;
+    while (!segment->index.empty()) {
+        const IndexEntry& last = segment->index.back();
+        if (ReadRecord(segment->mapping.data(), fileSize, last.offset, record, next) && record.id == last.id) {
+            break;
+        }
+        segment->index.pop_back();
+    }
+
+    uint64_t offset = 0;
+    uint64_t expectedId = firstId;
+    size_t sinceIndex = kIndexInterval;
+    size_t keptEntries = segment->index.size();
+    std::string repairs;
+    if (!segment->index.empty()) {
+        offset = segment->index.back().offset;
+        expectedId = segment->index.back().id;
+    }
+
+    while (offset < fileSize && ReadRecord(segment->mapping.data(), fileSize, offset, record, next) && record.id == expectedId) {
+        bool indexed = !segment->index.empty() && segment->index.back().offset == offset;
+        if (indexed) {
+            sinceIndex = 0;
+        }
+        else if (sinceIndex >= kIndexInterval) {
+            segment->index.push_back({ record.id, record.timestampMs, offset });
+            AppendIndexEntry(repairs, record.id, record.timestampMs, offset);
+            sinceIndex = 0;
+        }
+        sinceIndex++;
+        segment->lastId = record.id;
+        segment->lastTimestampMs = record.timestampMs;
+        expectedId++;
+        offset = next;
+    }
+    if (!segment->index.empty()) {
+        segment->firstTimestampMs = segment->index.front().timestampMs;
+    }
+
+    segment->bytes = offset;
+    segment->indexBytes = segment->index.size() * kIndexEntrySize;
+    segment->mappedBytes = fileSize;
+
+    if (offset < fileSize) {
+        std::cerr << "Dropping " << (fileSize - offset) << " bytes of incomplete records from " << logPath << std::endl;
+        segment->mapping.Unmap();
+        segment->mappedBytes = 0;
+        std::error_code error;
+        std::filesystem::resize_file(logPath, offset, error);
+        if (error) {
+            std::cerr << "Can't truncate " << logPath << ": " << error.message() << std::endl;
+            return false;
+        }
+    }
+
+    // Entries past the kept ones are dropped and the repaired ones
+    // written in their place
+    uint64_t keptBytes = keptEntries * kIndexEntrySize;
+    std::error_code error;
+    std::filesystem::resize_file(segment->indexPath, keptBytes, error);
+    if (!repairs.empty()) {
+        AttachmentFile indexFix;
+        if (indexFix.OpenForWriting(segment->indexPath)) {
+            indexFix.WriteAt(keptBytes, repairs.data(), repairs.size());
+        }
+    }
+
+    lastTimestampMs = std::max(lastTimestampMs, segment->lastTimestampMs);
+    recordsSinceIndex = sinceIndex;
+    segments.push_back(std::move(segment));
+    return true;
+}
+
+bool ChannelLog::StartSegment(uint64_t firstId) {
+    auto segment = std::make_unique<Segment>();
+    std::string base = directory + "/" + SegmentName(firstId);
+    segment->logPath = base + ".log";
+    segment->indexPath = base + ".idx";
+    segment->firstId = firstId;
+    segment->lastId = firstId - 1;
+    segments.push_back(std::move(segment));
+
+    nextId = firstId;
+    recordsSinceIndex = kIndexInterval;
+    return OpenWriters();
+}
+
+bool ChannelLog::OpenWriters() {
+    Segment& active = *segments.back();
+    return writer.OpenForWriting(active.logPath) && indexWriter.OpenForWriting(active.indexPath);
+}
+
+uint64_t ChannelLog::Append(int64_t timestampMs, std::string_view user, std::string_view body) {
+    Segment* active = segments.back().get();
+    if (active->bytes >= segmentBytes && active->lastId >= active->firstId) {
+        Flush();
+        StartSegment(nextId);
+        active = segments.back().get();
+    }
+
+    user = user.substr(0, std::numeric_limits<uint16_t>::max());
+    timestampMs = std::max(timestampMs, lastTimestampMs);
+    uint64_t id = nextId++;
+    uint64_t offset = active->bytes;
+
+    if (recordsSinceIndex >= kIndexInterval) {
+        active->index.push_back({ id, timestampMs, offset });
+        AppendIndexEntry(pendingIndex, id, timestampMs, offset);
+        recordsSinceIndex = 0;
+    }
+    recordsSinceIndex++;
+
+    uint32_t length = static_cast<uint32_t>(kRecordHeader + user.size() + body.size());
+    uint16_t userLength = static_cast<uint16_t>(user.size());
+    size_t start = pendingRecords.size();
+    pendingRecords.resize(start + kSizeField + kRecordHeader);
+    char* at = &pendingRecords[start];
+    std::memcpy(at, &length, sizeof(length));
+    std::memcpy(at + 4, &id, sizeof(id));
+    std::memcpy(at + 12, &timestampMs, sizeof(timestampMs));
+    std::memcpy(at + 20, &userLength, sizeof(userLength));
+    pendingRecords.append(user.data(), user.size());
+    pendingRecords.append(body.data(), body.size());
+
+    if (active->lastId < active->firstId) {
+        active->firstTimestampMs = timestampMs;
+    }
+    active->lastId = id;
+    active->lastTimestampMs = timestampMs;
+    active->bytes += kSizeField + length;
+    lastTimestampMs = timestampMs;
+
+    if (pendingRecords.size() >= kFlushThreshold) {
+        Flush();
+    }
+    return id;
+}
+
+bool ChannelLog::Flush() {
+    Segment& active = *segments.back();
+    bool ok = true;
+
+    // Records go first, so an index entry never points at missing data
+    if (!pendingRecords.empty()) {
+        ok = writer.WriteAt(active.bytes - pendingRecords.size(), pendingRecords.data(), pendingRecords.size());
+        bytesWritten += pendingRecords.size();
+        pendingRecords.clear();
+    }
+    if (!pendingIndex.empty()) {
+        ok = indexWriter.WriteAt(active.indexBytes, pendingIndex.data(), pendingIndex.size()) && ok;
+        active.indexBytes += pendingIndex.size();
+        bytesWritten += pendingIndex.size();
+        pendingIndex.clear();
+    }
+    return ok;
+}
+
+bool ChannelLog::MapSegment(Segment& segment) {
+    if (segment.bytes == 0) {
+        return false;
+    }
+    if (segment.mappedBytes == segment.bytes) {
+        return true;
+    }
+
+    // Only the active segment grows; it is mapped again to take in new records
+    if (!segment.reader.isOpen() && !segment.reader.OpenForReading(segment.logPath)) {
+        return false;
+    }
+    if (!segment.mapping.Map(segment.reader, 0, static_cast<size_t>(segment.bytes))) {
+        segment.mappedBytes = 0;
+        return false;
+    }
+    segment.mappedBytes = segment.bytes;
+    return true;
+}
+
+uint64_t ChannelLog::BlockEnd(const Block& block) const {
+    const Segment& segment = *segments[block.segment];
+    return block.entry + 1 < segment.index.size() ? segment.index[block.entry + 1].offset : segment.bytes;
+}
+
+bool ChannelLog::NextBlock(Block& block) const {
+    if (block.entry + 1 < segments[block.segment]->index.size()) {
+        block.entry++;
+        return true;
+    }
+    for (size_t next = block.segment + 1; next < segments.size(); ++next) {
+        if (!segments[next]->index.empty()) {
+            block = { next, 0 };
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ChannelLog::PreviousBlock(Block& block) const {
+    if (block.entry > 0) {
+        block.entry--;
+        return true;
+    }
+    for (size_t previous = block.segment; previous-- > 0;) {
+        if (!segments[previous]->index.empty()) {
+            block = { previous, segments[previous]->index.size() - 1 };
+            return true;
+        }
+    }
+    return false;
+}
+
+void ChannelLog::ScanBlock(const Block& block, const std::function<bool(const HistoryRecord&)>& visit) {
+    Segment& segment = *segments[block.segment];
+    if (!MapSegment(segment)) {
+        return;
+    }
+
+    uint64_t offset = segment.index[block.entry].offset;
+    uint64_t end = BlockEnd(block);
+    HistoryRecord record;
+    uint64_t next = 0;
+    while (offset < end && ReadRecord(segment.mapping.data(), segment.bytes, offset, record, next)) {
+        if (!visit(record)) {
+            return;
+        }
+        offset = next;
+    }
+}
+
+size_t ChannelLog::Query(const HistoryQuery& query, const Visitor& visit) {
+    Flush();
+    if (query.limit == 0 || query.afterId + 1 >= query.beforeId || query.sinceMs > query.untilMs || nextId == 1) {
+        return 0;
+    }
+
+    auto matches = [this, &query](const HistoryRecord& record) {
+        return record.id > query.afterId && record.id < query.beforeId
+            && record.timestampMs >= query.sinceMs && record.timestampMs <= query.untilMs
+            && (deletedIds.empty() || deletedIds.count(record.id) == 0);
+    };
+
+    // The segment is found first and then the block inside it, both by
+    // binary search, since IDs and timestamps only grow
+    auto firstSegmentAfter = [this](auto beyond) {
+        return static_cast<size_t>(std::partition_point(segments.begin(), segments.end(), beyond) - segments.begin());
+    };
+
+    if (query.forward()) {
+        // First segment that can hold something newer than the lower bounds
+        size_t first = firstSegmentAfter([&query](const std::unique_ptr<Segment>& segment) {
+            return segment->lastId <= query.afterId || segment->lastTimestampMs < query.sinceMs;
+            });
+        while (first < segments.size() && segments[first]->index.empty()) {
+            first++;
+        }
+        if (first == segments.size()) {
+            return 0;
+        }
+
+        // The first indexed record that passes the lower bounds; matches
+        // may start in the block before it
+        const std::vector<IndexEntry>& index = segments[first]->index;
+        size_t entry = static_cast<size_t>(std::partition_point(index.begin(), index.end(), [&query](const IndexEntry& candidate) {
+            return candidate.id <= query.afterId || candidate.timestampMs < query.sinceMs;
+            }) - index.begin());
+        Block block{ first, entry > 0 ? entry - 1 : 0 };
+
+        size_t count = 0;
+        bool done = false;
+        do {
+            ScanBlock(block, [&](const HistoryRecord& record) {
+                if (record.id >= query.beforeId || record.timestampMs > query.untilMs) {
+                    done = true;
+                    return false;
+                }
+                if (matches(record)) {
+                    visit(Edited(record));
+                    done = ++count >= query.limit;
+                }
+                return !done;
+                });
+        } while (!done && NextBlock(block));
+        return count;
+    }
+
+    // Backward paging: from the last block that can hold a match, collect
+    // whole blocks until enough matches are in hand
+    size_t last = firstSegmentAfter([&query](const std::unique_ptr<Segment>& segment) {
+        return segment->firstId < query.beforeId && segment->firstTimestampMs <= query.untilMs;
+        });
+    while (last > 0 && segments[last - 1]->index.empty()) {
+        last--;
+    }
+    if (last == 0) {
+        return 0;
+    }
+    const std::vector<IndexEntry>& index = segments[last - 1]->index;
+    size_t entry = static_cast<size_t>(std::partition_point(index.begin(), index.end(), [&query](const IndexEntry& candidate) {
+        return candidate.id < query.beforeId && candidate.timestampMs <= query.untilMs;
+        }) - index.begin());
+    if (entry == 0) {
+        return 0;
+    }
+    Block block{ last - 1, entry - 1 };
+
+    std::vector<HistoryRecord> found;
+    std::vector<HistoryRecord> blockMatches;
+    bool reachedStart = false;
+    do {
+        IndexEntry start = BlockStart(block);
+        blockMatches.clear();
+        ScanBlock(block, [&](const HistoryRecord& record) {
+            if (record.id >= query.beforeId || record.timestampMs > query.untilMs) {
+                return false;
+            }
+            if (matches(record)) {
+                blockMatches.push_back(record);
+            }
+            return true;
+            });
+
+        // Newest first, so the limit keeps the most recent matches
+        for (auto it = blockMatches.rbegin(); it != blockMatches.rend() && found.size() < query.limit; ++it) {
+            found.push_back(*it);
+        }
+        reachedStart = start.id <= query.afterId + 1 || start.timestampMs < query.sinceMs;
+    } while (found.size() < query.limit && !reachedStart && PreviousBlock(block));
+
+    for (auto it = found.rbegin(); it != found.rend(); ++it) {
+        visit(Edited(*it));
+    }
+    return found.size();
+}
@@ -0,0 +1,151 @@
+#ifndef CHANNEL_LOG_HPP
+#define CHANNEL_LOG_HPP
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "../client/attachment_file.hpp"
+
+// A stored message as read back from a segment. The views point into the
+// segment's mapping and are only valid inside the visitor.
+struct HistoryRecord {
+    uint64_t id = 0;
+    int64_t timestampMs = 0;
+    std::string_view user;
+    std::string_view body;
+};
+
+// Messages with afterId < id < beforeId and sinceMs <= timestamp <= untilMs.
+// A query with only a lower ID bound pages forward and returns the oldest
+// `limit` matches; anything else returns the newest `limit`. Results are
+// always in ascending ID order.
+struct HistoryQuery {
+    uint64_t afterId = 0;
+    uint64_t beforeId = std::numeric_limits<uint64_t>::max();
+    int64_t sinceMs = std::numeric_limits<int64_t>::min();
+    int64_t untilMs = std::numeric_limits<int64_t>::max();
+    size_t limit = 500;
+
+    bool forward() const { return afterId > 0 && beforeId == std::numeric_limits<uint64_t>::max(); }
+};
+
+// One channel's history as append-only segment files in a directory:
+//   <first id>.log   records: u32 size, u64 id, i64 ms, u16 user length,
+//                    user, body
+//   <first id>.idx   a sparse index, one {id, ms, offset} entry for every
+//                    kIndexInterval records
+//   edits.dat        later edits and deletes: u32 size, u64 id, u8 deleted,
+//                    body; kept in memory and laid over query results
+// IDs are assigned here and strictly increase; timestamps never go back, so
+// both can be binary searched through the index. Sealed segments are never
+// written again; every byte goes to disk once plus an index entry per
+// block. Queries find the segment and block straight from the in-memory
+// index and read the records through a read-only mapping.
+class ChannelLog {
+public:
+    static const size_t kIndexInterval = 32;
+
+    using Visitor = std::function<void(const HistoryRecord&)>;
+
+private:
+    struct IndexEntry {
+        uint64_t id;
+        int64_t timestampMs;
+        uint64_t offset;
+    };
+
+    struct Segment {
+        std::string logPath;
+        std::string indexPath;
+        uint64_t firstId = 0;
+        uint64_t lastId = 0;
+        int64_t firstTimestampMs = 0;
+        int64_t lastTimestampMs = 0;
+        uint64_t bytes = 0;
+        uint64_t indexBytes = 0;
+        std::vector<IndexEntry> index;
+        AttachmentFile reader;
+        MappedRegion mapping;
+        uint64_t mappedBytes = 0;
+    };
+
+    // A run of records between two index entries
+    struct Block {
+        size_t segment;
+        size_t entry;
+    };
+
+    std::string directory;
+    uint64_t segmentBytes;
+    std::vector<std::unique_ptr<Segment>> segments;
+    AttachmentFile writer;
+    AttachmentFile indexWriter;
+    std::string pendingRecords;
+    std::string pendingIndex;
+    uint64_t nextId;
+    int64_t lastTimestampMs;
+    size_t recordsSinceIndex;
+    uint64_t bytesWritten;
+    std::unordered_map<uint64_t, std::string> editedBodies;
+    std::unordered_set<uint64_t> deletedIds;
+    AttachmentFile editsWriter;
+    uint64_t editsBytes;
+
+    bool LoadSegment(const std::string& logPath, uint64_t firstId);
+    bool StartSegment(uint64_t firstId);
+    bool OpenWriters();
+    bool MapSegment(Segment& segment);
+    bool LoadEdits();
+    bool WriteEdit(uint64_t id, bool deleted, std::string_view body);
+    // The record as it reads after any edit
+    HistoryRecord Edited(const HistoryRecord& record) const;
+    uint64_t BlockEnd(const Block& block) const;
+    IndexEntry BlockStart(const Block& block) const { return segments[block.segment]->index[block.entry]; }
+    bool NextBlock(Block& block) const;
+    bool PreviousBlock(Block& block) const;
+    // Visits the block's records in order; stops early when `visit` returns false
+    void ScanBlock(const Block& block, const std::function<bool(const HistoryRecord&)>& visit);
+
+public:
+    // Segments roll over once they reach `segmentBytes`.
+    explicit ChannelLog(uint64_t segmentBytes = 64 * 1024 * 1024);
+
+    ChannelLog(const ChannelLog&) = delete;
+    ChannelLog& operator=(const ChannelLog&) = delete;
+
+    // Loads the segments in `directory`, creating it if needed. A record cut
+    // off by a crash at the end of the last segment is dropped.
+    bool Open(const std::string& directory);
+
+    // Buffers the message and returns its ID. The timestamp is raised to the
+    // previous one if the clock went back.
+    uint64_t Append(int64_t timestampMs, std::string_view user, std::string_view body);
+
+    // Writes buffered records and index entries to their files.
+    bool Flush();
+
+    // Flushes, then calls `visit` for each match in ascending ID order.
+    // Deleted messages never match and edited ones carry their new body.
+    size_t Query(const HistoryQuery& query, const Visitor& visit);
+
+    // Replace the body of message `id`, or hide it from queries. Written
+    // through at once; false if there is no such message (any more).
+    bool Edit(uint64_t id, std::string_view body);
+    bool Delete(uint64_t id);
+
+    uint64_t lastId() const { return nextId - 1; }
+    // The stored timestamp of the last message, after any raising
+    int64_t lastTimestamp() const { return lastTimestampMs; }
+    size_t segmentCount() const { return segments.size(); }
+    // Bytes written to log and index files since Open(), for measuring
+    // write amplification
+    uint64_t totalBytesWritten() const { return bytesWritten; }
+};
+
+#endif // CHANNEL_LOG_HPP
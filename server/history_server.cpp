@@ -0,0 +1,733 @@
+// Local chat and history server.
+//
+// Speaks the client's line protocol from one poll loop and stores every
+// channel through HistoryStore, so history-heavy logins can be tried
+// against realistic amounts of data without the production server. Build
+// from the repository root:
+//
+//   g++ -std=c++17 -O2 -I. server/*.cpp client/attachment_file.cpp client/fragment.cpp
+//       client/link_health.cpp client/log.cpp client/message.cpp client/transport.cpp
+//       -lpthread -o history_server
+//
+//   history_server [--port n] [--data dir] [--segment-mb n] [--moderator user]...
+//                  [--generate channels messages [--generate-only]]
+//                  [--members count changes-per-second]
+//
+// --generate first appends `messages` synthetic messages spread over the
+// channels and reports write throughput, write amplification and the time
+// taken by the queries a login makes. Every login is accepted. Messages may
+// be edited or deleted by their author or by a moderator. --members adds
+// that many simulated members whose presence keeps changing at the given
+// rate, to load the clients' member lists.
+//
+// Requests:
+//   |user|password                        -> Authentication successful
+//   GET_PAST_MESSAGES|channel[|after=id][|before=id][|since=ms][|until=ms][|limit=n]
+//                                         -> MSG|id|channel|ms|user|body per match
+//   content|user|password[|client id]     -> stored in channel 1,
+//                                            ACK|client id|channel|message id,
+//                                            MSG line to every other client;
+//                                            a repeated client ID is only
+//                                            acknowledged again
+//   EDIT|channel|id|body                  -> the same line to every client,
+//   DELETE|channel|id                        or EDIT_DENIED|channel|id
+//   STATUS|online or away                 -> PRESENCE|user|status to every client
+//
+// After a login the client gets PRESENCE|user|online or away for everyone
+// present, and from then on only changes, offline when someone leaves.
+//   PING|...                              -> PONG|...
+//   FRAG|id|index|count|part              -> the line, once every part is in
+//
+// Lines sent back longer than kMaxFrameBytes are fragmented the same way.
+
+#include <algorithm>
+#include <chrono>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../client/fragment.hpp"
+#include "../client/link_health.hpp"
+#include "../client/message.hpp"
+#include "../client/net_socket.hpp"
+#include "../client/transport.hpp"
+#include "history_store.hpp"
+
+namespace {
+    const size_t kMaxHistoryLimit = 5000;
+    const size_t kMaxLineLength = 64 * 1024;
+    // A client further behind than this is dropped rather than buffered for
+    const size_t kMaxPendingOutput = 16 * 1024 * 1024;
+    const size_t kReadSize = 64 * 1024;
+    // Client IDs remembered per user for dropping replayed messages; well
+    // past what an outbox holds between two reconnects
+    const size_t kRecentClientIds = 4096;
+
+    struct Client {
+        SOCKET socketHandle;
+        std::string input;
+        std::string output;
+        std::string user;
+        FragmentAssembler fragments;
+        std::string assembled;
+        bool authenticated = false;
+        bool closing = false;
+    };
+
+    template <typename T>
+    bool ParseValue(std::string_view text, T& value) {
+        const char* end = text.data() + text.size();
+        auto result = std::from_chars(text.data(), end, value);
+        return result.ec == std::errc() && result.ptr == end;
+    }
+
+    // "GET_PAST_MESSAGES|channel|key=value|..." with unknown keys ignored
+    bool ParseHistoryRequest(std::string_view line, int& channelId, HistoryQuery& query) {
+        line.remove_prefix(18);
+        size_t bar = line.find('|');
+        if (!ParseValue(line.substr(0, bar), channelId) || channelId <= 0) {
+            return false;
+        }
+
+        while (bar != std::string_view::npos) {
+            line.remove_prefix(bar + 1);
+            bar = line.find('|');
+            std::string_view field = line.substr(0, bar);
+            size_t equals = field.find('=');
+            if (equals == std::string_view::npos) {
+                continue;
+            }
+
+            std::string_view key = field.substr(0, equals);
+            std::string_view value = field.substr(equals + 1);
+            bool ok = true;
+            if (key == "after") {
+                ok = ParseValue(value, query.afterId);
+            }
+            else if (key == "before") {
+                ok = ParseValue(value, query.beforeId);
+            }
+            else if (key == "since") {
+                ok = ParseValue(value, query.sinceMs);
+            }
+            else if (key == "until") {
+                ok = ParseValue(value, query.untilMs);
+            }
+            else if (key == "limit") {
+                ok = ParseValue(value, query.limit);
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+        query.limit = std::min(query.limit, kMaxHistoryLimit);
+        return true;
+    }
+
+    // Fragments the line appended since `start` if it is too long for a frame.
+    void FrameFrom(std::string& out, size_t start, uint64_t& nextFrameId) {
+        if (out.size() - start > kMaxFrameBytes) {
+            std::string line = out.substr(start, out.size() - start - 1);
+            out.resize(start);
+            for (const std::string& frame : FrameLine(line, nextFrameId++)) {
+                out += frame;
+            }
+        }
+    }
+
+    void AppendMessageLine(std::string& out, int channelId, const HistoryRecord& record, uint64_t& nextFrameId) {
+        size_t start = out.size();
+        out += "MSG|";
+        out += std::to_string(record.id);
+        out += '|';
+        out += std::to_string(channelId);
+        out += '|';
+        out += std::to_string(record.timestampMs);
+        out += '|';
+        out.append(record.user.data(), record.user.size());
+        out += '|';
+        out.append(record.body.data(), record.body.size());
+        out += '\n';
+        FrameFrom(out, start, nextFrameId);
+    }
+
+    // The messages a user sent lately, so one replayed after a lost ACK is
+    // acknowledged again instead of stored twice
+    struct RecentSends {
+        std::unordered_map<uint64_t, uint64_t> recordByClientId;
+        std::deque<uint64_t> order;
+    };
+
+    struct Presence {
+        int connections = 0;
+        std::string status = "online";
+    };
+
+    class HistoryServer {
+    private:
+        HistoryStore& store;
+        SOCKET listener;
+        std::vector<Client> clients;
+        uint64_t nextFrameId;
+        std::vector<std::string> moderators;
+        std::unordered_map<std::string, Presence> presence;
+        std::unordered_map<std::string, RecentSends> recentSends;
+        std::vector<std::string> simulatedMembers;
+        uint64_t churnPerSecond = 0;
+        double churnDue = 0;
+        std::chrono::steady_clock::time_point lastChurn;
+        std::mt19937 churnRandom;
+
+        bool Listen(int port);
+        void Accept();
+        void Read(Client& client);
+        void Write(Client& client);
+        void HandleLine(Client& client, std::string_view line);
+        void HandleChatLine(Client& client, std::string_view line);
+        void HandleEdit(Client& client, std::string_view line);
+        void Broadcast(const Client* sender, const std::string& line);
+        void Join(const std::string& user, Client* client);
+        void Leave(const std::string& user);
+        void SetStatus(const std::string& user, std::string_view status);
+        void SimulateChurn();
+
+    public:
+        HistoryServer(HistoryStore& store, std::vector<std::string> moderators)
+            : store(store), listener(INVALID_SOCKET), nextFrameId(1), moderators(std::move(moderators)) {}
+
+        void SimulateMembers(size_t count, uint64_t changesPerSecond);
+
+        int Run(int port);
+    };
+
+    bool HistoryServer::Listen(int port) {
+        listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener == INVALID_SOCKET) {
+            std::cerr << "Can't create socket, Err #" << LastSocketError() << std::endl;
+            return false;
+        }
+
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(static_cast<unsigned short>(port));
+        if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR
+            || listen(listener, SOMAXCONN) == SOCKET_ERROR || !SetNonBlocking(listener, true)) {
+            std::cerr << "Can't listen on port " << port << ", Err #" << LastSocketError() << std::endl;
+            closesocket(listener);
+            listener = INVALID_SOCKET;
+            return false;
+        }
+        return true;
+    }
+
+    void HistoryServer::Accept() {
+        for (;;) {
+            SOCKET accepted = accept(listener, nullptr, nullptr);
+            if (accepted == INVALID_SOCKET) {
+                return;
+            }
+            int noDelay = 1;
+            setsockopt(accepted, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+            SetNonBlocking(accepted, true);
+
+            Client client;
+            client.socketHandle = accepted;
+            client.output = "Welcome to the chat server!\n";
+            clients.push_back(std::move(client));
+        }
+    }
+
+    void HistoryServer::Read(Client& client) {
+        char buffer[kReadSize];
+        int received = recv(client.socketHandle, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            client.closing = received == 0 || !SocketWouldBlock();
+            return;
+        }
+        client.input.append(buffer, static_cast<size_t>(received));
+
+        size_t start = 0;
+        for (size_t newline = client.input.find('\n'); newline != std::string::npos && !client.closing;
+            newline = client.input.find('\n', start)) {
+            std::string_view line(client.input.data() + start, newline - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (!IsFragment(line)) {
+                HandleLine(client, line);
+            }
+            else if (client.fragments.Add(line, client.assembled)) {
+                HandleLine(client, client.assembled);
+            }
+            start = newline + 1;
+        }
+        client.input.erase(0, start);
+
+        if (client.input.size() > kMaxLineLength) {
+            std::cerr << "Line too long from " << client.user << ", dropping the client" << std::endl;
+            client.closing = true;
+        }
+    }
+
+    void HistoryServer::Write(Client& client) {
+        while (!client.output.empty()) {
+            int sent = send(client.socketHandle, client.output.data(), static_cast<int>(std::min<size_t>(client.output.size(), 1 << 20)), SEND_NO_SIGNAL);
+            if (sent <= 0) {
+                client.closing = !SocketWouldBlock();
+                return;
+            }
+            client.output.erase(0, static_cast<size_t>(sent));
+        }
+    }
+
+    void HistoryServer::HandleLine(Client& client, std::string_view line) {
+        if (line.compare(0, 5, "PING|") == 0) {
+            client.output += LinkHealth::MakePong(line);
+        }
+        else if (line.compare(0, 18, "GET_PAST_MESSAGES|") == 0) {
+            int channelId = 0;
+            HistoryQuery query;
+            if (!client.authenticated || !ParseHistoryRequest(line, channelId, query)) {
+                return;
+            }
+            store.Query(channelId, query, [this, &client, channelId](const HistoryRecord& record) {
+                AppendMessageLine(client.output, channelId, record, nextFrameId);
+                });
+        }
+        else if (line.compare(0, 5, "EDIT|") == 0 || line.compare(0, 7, "DELETE|") == 0) {
+            HandleEdit(client, line);
+        }
+        else if (line.compare(0, 7, "STATUS|") == 0) {
+            std::string_view status = line.substr(7);
+            if (client.authenticated && (status == "online" || status == "away")) {
+                SetStatus(client.user, status);
+            }
+        }
+        else if (line.compare(0, 5, "FILE_") == 0 || line.compare(0, 5, "PONG|") == 0) {
+            // Attachments aren't stored here
+        }
+        else {
+            HandleChatLine(client, line);
+        }
+
+        if (client.output.size() > kMaxPendingOutput) {
+            std::cerr << client.user << " is too far behind, dropping the client" << std::endl;
+            client.closing = true;
+        }
+    }
+
+    void HistoryServer::HandleChatLine(Client& client, std::string_view line) {
+        // "content|user|password[|client id]"; the content may hold '|', so
+        // the fields are taken from the right
+        std::string_view fields[3];
+        std::string_view rest = line;
+        size_t found = 0;
+        for (; found < 3; ++found) {
+            size_t bar = rest.rfind('|');
+            if (bar == std::string_view::npos) {
+                break;
+            }
+            fields[found] = rest.substr(bar + 1);
+            rest = rest.substr(0, bar);
+        }
+
+        uint64_t clientId = 0;
+        bool hasClientId = found == 3 && ParseValue(fields[0], clientId);
+        if (!hasClientId) {
+            if (found < 2) {
+                return;
+            }
+            // Only the password and user were split off
+            rest = line.substr(0, line.size() - fields[0].size() - fields[1].size() - 2);
+        }
+        std::string_view user = hasClientId ? fields[2] : fields[1];
+        if (user.empty()) {
+            return;
+        }
+
+        if (rest.empty()) {
+            if (client.authenticated) {
+                Leave(client.user);
+            }
+            client.user.assign(user);
+            client.authenticated = true;
+            client.output += "Authentication successful\n";
+            Join(client.user, &client);
+            return;
+        }
+        if (!client.authenticated) {
+            return;
+        }
+        // Messages are stored under the name the connection logged in
+        // with, so nobody can post (and then edit) as someone else
+        if (user != client.user) {
+            std::cerr << client.user << " sent a message as " << user << ", dropped" << std::endl;
+            return;
+        }
+
+        RecentSends* recent = nullptr;
+        if (hasClientId) {
+            recent = &recentSends[client.user];
+            auto seen = recent->recordByClientId.find(clientId);
+            if (seen != recent->recordByClientId.end()) {
+                client.output += "ACK|" + std::to_string(clientId) + "|1|" + std::to_string(seen->second) + "\n";
+                return;
+            }
+        }
+
+        ChannelLog* log = store.Channel(1);
+        if (!log) {
+            return;
+        }
+        HistoryRecord record;
+        record.id = log->Append(CurrentTimeMs(), client.user, rest);
+        record.timestampMs = log->lastTimestamp();
+        record.user = client.user;
+        record.body = rest;
+        if (recent) {
+            recent->recordByClientId.emplace(clientId, record.id);
+            recent->order.push_back(clientId);
+            if (recent->order.size() > kRecentClientIds) {
+                recent->recordByClientId.erase(recent->order.front());
+                recent->order.pop_front();
+            }
+            // The ID lets the sender edit or delete its own copy later
+            client.output += "ACK|" + std::to_string(clientId) + "|1|" + std::to_string(record.id) + "\n";
+        }
+
+        std::string broadcast;
+        AppendMessageLine(broadcast, 1, record, nextFrameId);
+        Broadcast(&client, broadcast);
+    }
+
+    // "EDIT|channel|id|body" or "DELETE|channel|id". Once stored, the line
+    // goes to every client, the sender too, which only changes its own copy
+    // then.
+    void HistoryServer::HandleEdit(Client& client, std::string_view line) {
+        if (!client.authenticated) {
+            return;
+        }
+        bool deleting = line[0] == 'D';
+        std::string_view rest = line.substr(deleting ? 7 : 5);
+        size_t bar = rest.find('|');
+        int channelId = 0;
+        uint64_t id = 0;
+        if (bar == std::string_view::npos || !ParseValue(rest.substr(0, bar), channelId) || channelId <= 0) {
+            return;
+        }
+        rest.remove_prefix(bar + 1);
+        bar = rest.find('|');
+        if (!ParseValue(rest.substr(0, bar), id) || deleting != (bar == std::string_view::npos)) {
+            return;
+        }
+        std::string_view body = deleting ? std::string_view() : rest.substr(bar + 1);
+
+        // The newest message before id + 1 is the one, unless it is gone
+        ChannelLog* log = store.Channel(channelId);
+        std::string author;
+        if (log && id > 0) {
+            HistoryQuery query;
+            query.beforeId = id + 1;
+            query.limit = 1;
+            log->Query(query, [&author, id](const HistoryRecord& record) {
+                if (record.id == id) {
+                    author.assign(record.user);
+                }
+                });
+        }
+
+        bool allowed = !author.empty()
+            && (author == client.user || std::find(moderators.begin(), moderators.end(), client.user) != moderators.end());
+        bool stored = allowed && (deleting ? log->Delete(id) : log->Edit(id, body));
+        if (!stored) {
+            client.output += "EDIT_DENIED|" + std::to_string(channelId) + "|" + std::to_string(id) + "\n";
+            return;
+        }
+
+        std::string broadcast(line);
+        broadcast += '\n';
+        FrameFrom(broadcast, 0, nextFrameId);
+        Broadcast(nullptr, broadcast);
+    }
+
+    // To every logged in client but `sender`, if given.
+    void HistoryServer::Broadcast(const Client* sender, const std::string& line) {
+        for (Client& other : clients) {
+            if (&other != sender && other.authenticated && !other.closing) {
+                other.output += line;
+            }
+        }
+    }
+
+    // The first connection of a user announces them to the others; the
+    // joining client is sent everyone present, itself included.
+    void HistoryServer::Join(const std::string& user, Client* client) {
+        Presence& entry = presence[user];
+        if (entry.connections++ == 0) {
+            Broadcast(client, "PRESENCE|" + user + "|" + entry.status + "\n");
+        }
+        if (!client) {
+            return;
+        }
+        std::string& out = client->output;
+        for (const auto& [name, present] : presence) {
+            out += "PRESENCE|";
+            out += name;
+            out += '|';
+            out += present.status;
+            out += '\n';
+        }
+    }
+
+    void HistoryServer::Leave(const std::string& user) {
+        auto it = presence.find(user);
+        if (it == presence.end() || --it->second.connections > 0) {
+            return;
+        }
+        presence.erase(it);
+        Broadcast(nullptr, "PRESENCE|" + user + "|offline\n");
+    }
+
+    void HistoryServer::SetStatus(const std::string& user, std::string_view status) {
+        auto it = presence.find(user);
+        if (it == presence.end() || it->second.status == status) {
+            return;
+        }
+        it->second.status.assign(status);
+        Broadcast(nullptr, "PRESENCE|" + user + "|" + it->second.status + "\n");
+    }
+
+    void HistoryServer::SimulateMembers(size_t count, uint64_t changesPerSecond) {
+        for (size_t i = 0; i < count; ++i) {
+            simulatedMembers.push_back("member" + std::to_string(i + 1));
+            presence[simulatedMembers.back()].connections = 1;
+        }
+        churnPerSecond = changesPerSecond;
+        lastChurn = std::chrono::steady_clock::now();
+    }
+
+    // Each change moves a random simulated member one step round
+    // online -> away -> offline -> online.
+    void HistoryServer::SimulateChurn() {
+        auto now = std::chrono::steady_clock::now();
+        churnDue += std::chrono::duration<double>(now - lastChurn).count() * churnPerSecond;
+        lastChurn = now;
+        std::uniform_int_distribution<size_t> pick(0, simulatedMembers.size() - 1);
+        for (; churnDue >= 1; churnDue -= 1) {
+            const std::string& user = simulatedMembers[pick(churnRandom)];
+            auto it = presence.find(user);
+            if (it == presence.end()) {
+                Join(user, nullptr);
+            }
+            else if (it->second.status == "online") {
+                SetStatus(user, "away");
+            }
+            else {
+                Leave(user);
+            }
+        }
+    }
+
+    int HistoryServer::Run(int port) {
+        if (!Listen(port)) {
+            return 1;
+        }
+        std::cout << "Listening on port " << port << std::endl;
+
+        std::vector<PollFd> fds;
+        for (;;) {
+            fds.clear();
+            PollFd listening{};
+            listening.fd = listener;
+            listening.events = POLLIN;
+            fds.push_back(listening);
+            for (const Client& client : clients) {
+                PollFd fd{};
+                fd.fd = client.socketHandle;
+                fd.events = POLLIN | (client.output.empty() ? 0 : POLLOUT);
+                fds.push_back(fd);
+            }
+
+            // Appends are written out whenever the server goes idle
+            int idleWaitMs = simulatedMembers.empty() || churnPerSecond == 0 ? -1 : 10;
+            if (PollSockets(fds.data(), static_cast<unsigned long>(fds.size()), 0) == 0) {
+                store.Flush();
+                PollSockets(fds.data(), static_cast<unsigned long>(fds.size()), idleWaitMs);
+            }
+
+            size_t known = clients.size();
+            for (size_t i = 0; i < known; ++i) {
+                if (fds[i + 1].revents & (POLLIN | POLLERR | POLLHUP)) {
+                    Read(clients[i]);
+                }
+            }
+            for (Client& client : clients) {
+                if (!client.closing) {
+                    Write(client);
+                }
+            }
+
+            std::vector<std::string> left;
+            clients.erase(std::remove_if(clients.begin(), clients.end(), [&left](const Client& client) {
+                if (client.closing) {
+                    closesocket(client.socketHandle);
+                    if (client.authenticated) {
+                        left.push_back(client.user);
+                    }
+                }
+                return client.closing;
+                }), clients.end());
+            for (const std::string& user : left) {
+                Leave(user);
+            }
+            if (!simulatedMembers.empty() && churnPerSecond > 0) {
+                SimulateChurn();
+            }
+
+            if (fds[0].revents & POLLIN) {
+                Accept();
+            }
+        }
+    }
+
+    // Fills the store with `messages` messages spread round-robin over the
+    // channels, a few seconds apart, then times the queries a login makes
+    void Generate(HistoryStore& store, int channelCount, uint64_t messages) {
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int> userPick(1, 200);
+        std::uniform_int_distribution<int> lengthPick(8, 160);
+        std::uniform_int_distribution<int> gapPick(1, 5000);
+        const std::string filler = "the quick brown fox jumps over the lazy dog while the chat scrolls by ";
+
+        int64_t timestampMs = CurrentTimeMs() - static_cast<int64_t>(messages) * 2500;
+        uint64_t payloadBytes = 0;
+        std::string user;
+        std::string body;
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < messages; ++i) {
+            timestampMs += gapPick(random);
+            user = "user" + std::to_string(userPick(random));
+            size_t length = static_cast<size_t>(lengthPick(random));
+            body.clear();
+            while (body.size() < length) {
+                body += filler;
+            }
+            body.resize(length);
+
+            store.Append(1 + static_cast<int>(i % channelCount), timestampMs, user, body);
+            payloadBytes += user.size() + body.size();
+        }
+        store.Flush();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Wrote " << messages << " messages to " << channelCount << " channels in " << seconds << " s ("
+            << static_cast<uint64_t>(messages / std::max(seconds, 1e-9)) << " msg/s, "
+            << payloadBytes / std::max(seconds, 1e-9) / (1024 * 1024) << " MB/s of payload)" << std::endl;
+        std::cout << "Write amplification: " << static_cast<double>(store.totalBytesWritten()) / std::max<uint64_t>(payloadBytes, 1)
+            << " (" << store.totalBytesWritten() << " bytes written for " << payloadBytes << " bytes of user and body)" << std::endl;
+
+        // A login asks for the newest page; scrolling back pages by ID, and
+        // a jump to a date asks for a time window
+        auto timed = [&store, channelCount](const char* label, int rounds, const std::function<HistoryQuery(int)>& make) {
+            size_t returned = 0;
+            auto begin = std::chrono::steady_clock::now();
+            for (int round = 0; round < rounds; ++round) {
+                returned += store.Query(1 + round % channelCount, make(round), [](const HistoryRecord&) {});
+            }
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+            std::cout << label << ": " << us / rounds << " us per query, " << returned / rounds << " messages each" << std::endl;
+        };
+
+        uint64_t perChannel = std::max<uint64_t>(1, messages / channelCount);
+        timed("Newest page", 1000, [](int) { return HistoryQuery(); });
+        timed("Page before an ID", 1000, [&random, perChannel](int) {
+            HistoryQuery query;
+            query.beforeId = 1 + random() % perChannel;
+            return query;
+            });
+        timed("Page after an ID", 1000, [&random, perChannel](int) {
+            HistoryQuery query;
+            query.afterId = 1 + random() % perChannel;
+            return query;
+            });
+        timed("Hour window", 1000, [&random, timestampMs, messages](int) {
+            HistoryQuery query;
+            query.untilMs = timestampMs - static_cast<int64_t>(random() % std::max<uint64_t>(1, messages * 2500));
+            query.sinceMs = query.untilMs - 3600 * 1000;
+            return query;
+            });
+    }
+}
+
+int main(int argc, char** argv) {
+    IgnoreBrokenPipes();
+
+    int port = 54000;
+    std::string dataDirectory = "history";
+    uint64_t segmentMb = 64;
+    int generateChannels = 0;
+    uint64_t generateMessages = 0;
+    bool generateOnly = false;
+    std::vector<std::string> moderators;
+    size_t simulatedMembers = 0;
+    uint64_t churnPerSecond = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--data") == 0 && i + 1 < argc) {
+            dataDirectory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--segment-mb") == 0 && i + 1 < argc) {
+            segmentMb = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--generate") == 0 && i + 2 < argc) {
+            generateChannels = std::max(1, std::atoi(argv[++i]));
+            generateMessages = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--members") == 0 && i + 2 < argc) {
+            simulatedMembers = std::strtoull(argv[++i], nullptr, 10);
+            churnPerSecond = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--moderator") == 0 && i + 1 < argc) {
+            moderators.emplace_back(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--generate-only") == 0) {
+            generateOnly = true;
+        }
+        else {
+            std::cerr << "Unexpected argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    HistoryStore store(dataDirectory, segmentMb * 1024 * 1024);
+    if (generateChannels > 0) {
+        Generate(store, generateChannels, generateMessages);
+    }
+    if (generateOnly) {
+        return 0;
+    }
+
+    if (!InitializeSockets()) {
+        return 1;
+    }
+    HistoryServer server(store, std::move(moderators));
+    server.SimulateMembers(simulatedMembers, churnPerSecond);
+    int result = server.Run(port);
+    CleanupSockets();
+    return result;
+}
@@ -0,0 +1,41 @@
+#include "history_store.hpp"
+
+HistoryStore::HistoryStore(const std::string& dataDirectory, uint64_t segmentBytes)
+    : dataDirectory(dataDirectory), segmentBytes(segmentBytes) {}
+
+ChannelLog* HistoryStore::Channel(int channelId) {
+    auto it = channels.find(channelId);
+    if (it != channels.end()) {
+        return it->second.get();
+    }
+
+    auto log = std::make_unique<ChannelLog>(segmentBytes);
+    if (!log->Open(dataDirectory + "/channel-" + std::to_string(channelId))) {
+        return nullptr;
+    }
+    return channels.emplace(channelId, std::move(log)).first->second.get();
+}
+
+uint64_t HistoryStore::Append(int channelId, int64_t timestampMs, std::string_view user, std::string_view body) {
+    ChannelLog* log = Channel(channelId);
+    return log ? log->Append(timestampMs, user, body) : 0;
+}
+
+size_t HistoryStore::Query(int channelId, const HistoryQuery& query, const ChannelLog::Visitor& visit) {
+    ChannelLog* log = Channel(channelId);
+    return log ? log->Query(query, visit) : 0;
+}
+
+void HistoryStore::Flush() {
+    for (auto& channel : channels) {
+        channel.second->Flush();
+    }
+}
+
+uint64_t HistoryStore::totalBytesWritten() const {
+    uint64_t total = 0;
+    for (const auto& channel : channels) {
+        total += channel.second->totalBytesWritten();
+    }
+    return total;
+}
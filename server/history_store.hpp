@@ -0,0 +1,34 @@
+#ifndef HISTORY_STORE_HPP
+#define HISTORY_STORE_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include "channel_log.hpp"
+
+// Every channel's log under one data directory, as <data>/channel-<id>/.
+// Channels are opened the first time they are written or read.
+class HistoryStore {
+private:
+    std::string dataDirectory;
+    uint64_t segmentBytes;
+    std::map<int, std::unique_ptr<ChannelLog>> channels;
+
+public:
+    HistoryStore(const std::string& dataDirectory, uint64_t segmentBytes);
+
+    // Opens the channel's log; nullptr if its directory can't be used.
+    ChannelLog* Channel(int channelId);
+
+    // Appends to the channel and returns the message ID, 0 on failure.
+    uint64_t Append(int channelId, int64_t timestampMs, std::string_view user, std::string_view body);
+
+    // Calls `visit` for each match, oldest first; returns how many matched.
+    size_t Query(int channelId, const HistoryQuery& query, const ChannelLog::Visitor& visit);
+
+    void Flush();
+    uint64_t totalBytesWritten() const;
+};
+
+#endif // HISTORY_STORE_HPP
@@ -0,0 +1,414 @@
+// Headless render benchmark for the chat view.
+//
+// Draws the same widgets as LimeGUI's chat view into an offscreen
+// sf::RenderTexture and times scripted scenarios frame by frame. Each frame
+// ends with glFinish, so the time includes the GPU (or llvmpipe) work and
+// not just command submission. Build from the repository root:
+//
+//   g++ -std=c++17 -O2 -I. tools/render_bench.cpp client/utf8.cpp client/gui/*/*.cpp
+//       -lsfml-graphics -lsfml-window -lsfml-system -lGL -lpthread -o render_bench
+//
+// and run it with tools/run_render_bench.sh on machines without a display.
+//
+//   render_bench [--scenario append|flood|scroll|typing|menus] [--messages n]
+//                [--baseline file [--tolerance pct]]
+//
+// One line is printed per scenario; the same lines saved to a file make a
+// baseline. With --baseline, the run fails if a scenario's p95 frame time or
+// its draw calls or vertices per frame grew by more than the tolerance.
+
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "client/gui/ui-assets/text_object.hpp"
+#include "client/gui/ui-components/input_field.hpp"
+#include "client/gui/ui-components/menu.hpp"
+#include "client/gui/ui-components/menu_item.hpp"
+#include "client/gui/ui-components/scrollable_text_area.hpp"
+#include "client/gui/ui-util/menu_util.hpp"
+#include "client/gui/ui-util/render_stats.hpp"
+
+namespace {
+
+    struct Result {
+        std::string scenario;
+        std::map<std::string, double> values;
+    };
+
+    // The chat view as LimeGUI lays it out, with a vector standing in for
+    // the chat client's history
+    class ChatScene {
+    public:
+        std::vector<std::string> history;
+        size_t displayed = 0;
+        std::unique_ptr<MenuUtil> menuUtil;
+        std::unique_ptr<ScrollableTextArea> messageDisplayMenu;
+        std::unique_ptr<Menu> inputMenu;
+        std::unique_ptr<InputField> inputField;
+        std::unique_ptr<InputField> searchField;
+        TextObject statusText{ "Connected", 20.0f, 440.0f, 16, 255, 255, 255 };
+
+        ChatScene() {
+            menuUtil = std::make_unique<MenuUtil>();
+
+            messageDisplayMenu = std::make_unique<ScrollableTextArea>(sf::Vector2f(0, 20), 600, 400);
+            messageDisplayMenu->set_history_provider([this](size_t first, size_t count) {
+                size_t end = std::min(history.size(), first + count);
+                return std::vector<std::string>(history.begin() + std::min(first, end), history.begin() + end);
+                });
+
+            inputMenu = std::make_unique<Menu>(sf::Vector2f(20, 0), false, true);
+            inputMenu->set_background_color(sf::Color(200, 200, 200));
+            inputMenu->add_input_field("Enter your message", 450, 40);
+
+            inputField = std::make_unique<InputField>("Enter your message", 450, 40);
+            inputField->set_position(20, 0);
+            inputField->set_text_color(sf::Color::Black);
+            inputField->set_enter_callback([this](const std::string& message) {
+                AddMessage(message);
+                });
+
+            searchField = std::make_unique<InputField>("Search", 150, 40);
+            searchField->set_position(480, 0);
+            searchField->set_text_color(sf::Color::Black);
+
+            menuUtil->add_menu(messageDisplayMenu.get());
+            menuUtil->add_menu(inputMenu.get());
+        }
+
+        void AddMessage(const std::string& line) {
+            history.push_back(line);
+            messageDisplayMenu->add_string(history.back());
+            displayed = history.size();
+        }
+
+        // Shows history lines not yet displayed the way LimeGUI does: a
+        // backlog longer than the view keeps is only counted, the rest is
+        // added until the time budget runs out
+        void Ingest(double budgetMs) {
+            size_t backlog = history.size() - displayed;
+            if (backlog > messageDisplayMenu->get_max_rows()) {
+                size_t skipped = backlog - messageDisplayMenu->get_max_rows();
+                messageDisplayMenu->add_lines(skipped);
+                displayed += skipped;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            while (displayed < history.size()
+                && std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < budgetMs) {
+                for (size_t end = std::min(history.size(), displayed + 64); displayed < end; ++displayed) {
+                    messageDisplayMenu->add_string(history[displayed]);
+                }
+            }
+        }
+
+        void Draw(sf::RenderTarget& target) {
+            target.clear(sf::Color(1, 52, 32));
+            menuUtil->draw_menus(target);
+            inputField->draw(target);
+            searchField->draw(target);
+            RenderStats::draw(target, statusText.get_text());
+        }
+    };
+
+    // Lines of varying length, so some wrap and some do not
+    std::string MakeLine(size_t index) {
+        static const char* words[] = { "lime", "chat", "message", "render", "benchmark", "scroll", "frame",
+            "texture", "glyph", "window", "history", "wrap", "vertex", "batch" };
+        std::string line = "[2024-05-01 12:" + std::to_string(10 + index / 60 % 50) + ":"
+            + std::to_string(10 + index % 50) + "] <user" + std::to_string(index % 37) + ">:";
+        size_t wordCount = 3 + (index * 7919) % 40;
+        for (size_t i = 0; i < wordCount; ++i) {
+            line += ' ';
+            line += words[(index + i * 31) % (sizeof(words) / sizeof(words[0]))];
+        }
+        return line;
+    }
+
+    class FrameRecorder {
+    public:
+        explicit FrameRecorder(sf::RenderTexture& target) : target(target) {}
+
+        // Times one frame: the scenario's update, the draw and glFinish
+        void Frame(ChatScene& scene, const std::function<void()>& update) {
+            RenderStats::reset();
+            auto start = std::chrono::steady_clock::now();
+
+            update();
+            scene.Draw(target);
+            target.display();
+            glFinish();
+
+            auto end = std::chrono::steady_clock::now();
+            frameMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            drawCalls += RenderStats::get().draw_calls;
+            vertices += RenderStats::get().vertices;
+        }
+
+        Result Summarize(const std::string& scenario) const {
+            Result result;
+            result.scenario = scenario;
+            if (frameMs.empty()) {
+                return result;
+            }
+
+            std::vector<double> sorted = frameMs;
+            std::sort(sorted.begin(), sorted.end());
+            auto percentile = [&sorted](double p) {
+                return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+            };
+
+            double frames = static_cast<double>(sorted.size());
+            result.values["frames"] = frames;
+            result.values["p50_ms"] = percentile(0.5);
+            result.values["p95_ms"] = percentile(0.95);
+            result.values["p99_ms"] = percentile(0.99);
+            result.values["max_ms"] = sorted.back();
+            result.values["draw_calls"] = drawCalls / frames;
+            result.values["vertices"] = vertices / frames;
+            return result;
+        }
+
+    private:
+        sf::RenderTexture& target;
+        std::vector<double> frameMs;
+        double drawCalls = 0;
+        double vertices = 0;
+    };
+
+    // Appends the whole history, 100 lines per frame, always following the tail
+    Result RunAppend(sf::RenderTexture& target, size_t messageCount) {
+        ChatScene scene;
+        FrameRecorder recorder(target);
+        size_t next = 0;
+        while (next < messageCount) {
+            recorder.Frame(scene, [&] {
+                for (size_t end = std::min(messageCount, next + 100); next < end; ++next) {
+                    scene.AddMessage(MakeLine(next));
+                }
+                });
+        }
+        return recorder.Summarize("append");
+    }
+
+    // Messages arrive far faster than they can be laid out, 5000 a frame as
+    // when history is fetched, and are shown under LimeGUI's ingest budget
+    Result RunFlood(sf::RenderTexture& target, size_t messageCount) {
+        ChatScene scene;
+        FrameRecorder recorder(target);
+        scene.history.reserve(messageCount);
+        while (scene.displayed < messageCount) {
+            for (size_t end = std::min(messageCount, scene.history.size() + 5000); scene.history.size() < end;) {
+                scene.history.push_back(MakeLine(scene.history.size()));
+            }
+            recorder.Frame(scene, [&] { scene.Ingest(4.0); });
+        }
+        return recorder.Summarize("flood");
+    }
+
+    // Wheel-scrolls up through a long history and back down, paging rows in
+    // from the history provider on the way
+    Result RunScroll(sf::RenderTexture& target, size_t messageCount) {
+        ChatScene scene;
+        for (size_t i = 0; i < messageCount; ++i) {
+            scene.AddMessage(MakeLine(i));
+        }
+
+        sf::Event wheel;
+        wheel.type = sf::Event::MouseWheelScrolled;
+        wheel.mouseWheelScroll.wheel = sf::Mouse::VerticalWheel;
+        wheel.mouseWheelScroll.x = 300;
+        wheel.mouseWheelScroll.y = 200;
+
+        FrameRecorder recorder(target);
+        const int framesEachWay = 1500;
+        for (int i = 0; i < 2 * framesEachWay; ++i) {
+            wheel.mouseWheelScroll.delta = i < framesEachWay ? 3.f : -3.f;
+            recorder.Frame(scene, [&] { scene.messageDisplayMenu->handle_event(wheel, target); });
+        }
+        return recorder.Summarize("scroll");
+    }
+
+    // Types into the message field, one character per frame, sending a line
+    // every 120 characters so the field scrolls and the view keeps growing
+    Result RunTyping(sf::RenderTexture& target) {
+        ChatScene scene;
+        for (size_t i = 0; i < 1000; ++i) {
+            scene.AddMessage(MakeLine(i));
+        }
+        scene.inputField->set_focused(true);
+
+        const std::string text = "the quick brown fox jumps over the lazy dog while the chat keeps scrolling ";
+        sf::Event typed;
+        typed.type = sf::Event::TextEntered;
+
+        FrameRecorder recorder(target);
+        for (size_t i = 0; i < 3000; ++i) {
+            typed.text.unicode = (i % 121 == 120) ? 13 : static_cast<sf::Uint32>(text[i % text.size()]);
+            recorder.Frame(scene, [&] { scene.inputField->handle_event(typed); });
+        }
+        return recorder.Summarize("typing");
+    }
+
+    // A menu of 40 items, each with a background rect and the same icon, over
+    // the chat view. Backgrounds and icons go out as one batch per atlas
+    // page, so draw calls follow the distinct images, not the items.
+    Result RunMenus(sf::RenderTexture& target) {
+        auto menu = std::make_unique<Menu>(sf::Vector2f(0, 40), true, true);
+        menu->set_menu_width(200);
+        menu->set_menu_height(400);
+        ChatScene scene;
+        for (int i = 0; i < 40; ++i) {
+            menu->add_string("Item " + std::to_string(i));
+            MenuItem& item = menu->get_item(i);
+            item.set_background_color(sf::Color(40, 90, 60));
+            scene.menuUtil->add_bg_to_element(&item);
+            scene.menuUtil->add_image_to_element(&item, "limechat.png");
+        }
+        scene.menuUtil->add_menu(menu.get());
+
+        FrameRecorder recorder(target);
+        for (int i = 0; i < 600; ++i) {
+            recorder.Frame(scene, [] {});
+        }
+        Result result = recorder.Summarize("menus");
+        result.values["atlas_pages"] = static_cast<double>(TextureAtlas::get().get_page_count());
+        return result;
+    }
+
+    std::string Format(const Result& result) {
+        std::ostringstream line;
+        line << result.scenario;
+        for (const auto& [key, value] : result.values) {
+            line << ' ' << key << '=' << value;
+        }
+        return line.str();
+    }
+
+    std::map<std::string, Result> LoadBaseline(const std::string& path) {
+        std::map<std::string, Result> baseline;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            Result result;
+            if (!(fields >> result.scenario)) {
+                continue;
+            }
+            std::string field;
+            while (fields >> field) {
+                size_t equals = field.find('=');
+                if (equals != std::string::npos) {
+                    result.values[field.substr(0, equals)] = std::atof(field.c_str() + equals + 1);
+                }
+            }
+            baseline[result.scenario] = result;
+        }
+        return baseline;
+    }
+
+    // Frame time and the amount of work submitted per frame are both checked;
+    // the counts are deterministic, so they catch batching regressions even
+    // when timing on a shared machine is noisy.
+    bool CheckAgainst(const Result& result, const Result& baseline, double tolerance) {
+        bool ok = true;
+        for (const char* key : { "p95_ms", "draw_calls", "vertices" }) {
+            auto now = result.values.find(key);
+            auto before = baseline.values.find(key);
+            if (now == result.values.end() || before == baseline.values.end()) {
+                continue;
+            }
+            if (now->second > before->second * (1.0 + tolerance)) {
+                std::cerr << "Regression in " << result.scenario << ": " << key << " " << now->second
+                    << " against baseline " << before->second << std::endl;
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    std::string scenario;
+    std::string baselinePath;
+    size_t messageCount = 100000;
+    double tolerance = 0.15;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+            scenario = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--messages") == 0 && i + 1 < argc) {
+            messageCount = static_cast<size_t>(std::atol(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselinePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = std::atof(argv[++i]) / 100.0;
+        }
+        else {
+            std::cerr << "Unexpected argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    sf::RenderTexture target;
+    if (!target.create(640, 480)) {
+        std::cerr << "Failed to create the offscreen render target!" << std::endl;
+        return 1;
+    }
+
+    std::vector<Result> results;
+    if (scenario.empty() || scenario == "append") {
+        results.push_back(RunAppend(target, messageCount));
+    }
+    if (scenario.empty() || scenario == "flood") {
+        results.push_back(RunFlood(target, messageCount));
+    }
+    if (scenario.empty() || scenario == "scroll") {
+        results.push_back(RunScroll(target, messageCount));
+    }
+    if (scenario.empty() || scenario == "typing") {
+        results.push_back(RunTyping(target));
+    }
+    if (scenario.empty() || scenario == "menus") {
+        results.push_back(RunMenus(target));
+    }
+    if (results.empty()) {
+        std::cerr << "Unknown scenario " << scenario << std::endl;
+        return 1;
+    }
+
+    for (const Result& result : results) {
+        std::cout << Format(result) << std::endl;
+    }
+
+    if (baselinePath.empty()) {
+        return 0;
+    }
+
+    std::map<std::string, Result> baseline = LoadBaseline(baselinePath);
+    bool ok = true;
+    for (const Result& result : results) {
+        auto entry = baseline.find(result.scenario);
+        if (entry == baseline.end()) {
+            std::cerr << "No baseline for " << result.scenario << std::endl;
+            continue;
+        }
+        ok = CheckAgainst(result, entry->second, tolerance) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Builds and runs the headless render benchmark on a machine without a GPU
+# or display.
+#
+#   tools/run_render_bench.sh [render_bench arguments]
+#   tools/run_render_bench.sh > tools/render_baseline.txt
+#   tools/run_render_bench.sh --baseline tools/render_baseline.txt
+#
+# Rendering goes through Mesa's llvmpipe software rasterizer inside a
+# virtual X server, so numbers are only comparable between runs on the
+# same machine. Needs SFML, Mesa and xvfb-run (Debian/Ubuntu: libsfml-dev
+# libgl1-mesa-dri xvfb).
+set -e
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+build=$root/_bench_build
+mkdir -p "$build"
+
+g++ -std=c++17 -O2 -I"$root" "$root/tools/render_bench.cpp" "$root/client/utf8.cpp" "$root"/client/gui/*/*.cpp \
+    -lsfml-graphics -lsfml-window -lsfml-system -lGL -o "$build/render_bench"
+
+# The widgets load font.ttf from the working directory
+cd "$root"
+export LIBGL_ALWAYS_SOFTWARE=1
+export GALLIUM_DRIVER=llvmpipe
+exec xvfb-run -a -s "-screen 0 640x480x24" "$build/render_bench" "$@"
@@ -0,0 +1,30 @@
+#!/bin/sh
+# Local TLS endpoint for trying the client's TLS transport.
+#
+#   tools/tls_test_server.sh [port]
+#   lime_chat --tls --ca-file tools/.tls/cert.pem localhost [port]
+#
+# Creates a self-signed certificate for "localhost" on first run, then runs
+# openssl s_server, which echoes every line back reversed. It issues session
+# tickets, so a client reconnect should log "resumed". kTLS is offered with
+# -ktls where OpenSSL supports it; the client logs whether the kernel took
+# over each direction (Linux needs the "tls" module: modprobe tls).
+set -e
+
+port=${1:-54000}
+dir=$(dirname "$0")/.tls
+mkdir -p "$dir"
+
+if [ ! -f "$dir/cert.pem" ]; then
+    openssl req -x509 -newkey rsa:2048 -nodes -days 30 \
+        -subj "/CN=localhost" -addext "subjectAltName=DNS:localhost,IP:127.0.0.1" \
+        -keyout "$dir/key.pem" -out "$dir/cert.pem"
+fi
+
+ktls=""
+if openssl s_server -help 2>&1 | grep -q -- "-ktls"; then
+    ktls="-ktls"
+fi
+
+exec openssl s_server -accept "$port" -cert "$dir/cert.pem" -key "$dir/key.pem" \
+    -num_tickets 2 -rev $ktls